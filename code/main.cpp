@@ -1,5 +1,8 @@
 #include "tinyrender.h"
 
+#include <chrono>
+#include <cstdio>
+
 #define TINYOBJLOADER_IMPLEMENTATION
 #include "../dependency/tinyobj/tiny_obj_loader.h"
 
@@ -41,23 +44,10 @@ static void LoadMesh(const char* path, tinyrender::object& obj) {
 		}
 	}
 
-	// Make sure the loaded object has normals
+	// Make sure the loaded object has normals, split along sharp edges
 	bool hasNormals = attrib.normals.size() > 0;
 	if (!hasNormals)
-	{
-		for (int i = 0; i < obj.triangles.size(); i += 3)
-		{
-			const auto& v0 = obj.vertices[obj.triangles[i + 0]];
-			const auto& v1 = obj.vertices[obj.triangles[i + 1]];
-			const auto& v2 = obj.vertices[obj.triangles[i + 2]];
-			tinyrender::v3f n = tinyrender::internalCross((v1 - v0), (v2 - v0));
-			obj.normals[obj.triangles[i + 0]] += n;
-			obj.normals[obj.triangles[i + 1]] += n;
-			obj.normals[obj.triangles[i + 2]] += n;
-		}
-		for (int i = 0; i < obj.normals.size(); i++)
-			obj.normals[i] = tinyrender::internalNormalize(obj.normals[i]);
-	}
+		tinyrender::computeCreaseNormals(obj, 30.0f);
 }
 
 static void ExampleLoadMesh()
@@ -79,12 +69,56 @@ static void ExamplePrimitives()
 	tinyrender::updateObject(id, { -4.5f, 0.f, 0.f }, { 1.0f, 1.0f, 1.0f });
 }
 
+static void ExampleTopologyBenchmark()
+{
+	// Grid with two million triangles
+	const int n = 1000;
+	tinyrender::object obj;
+	for (int j = 0; j <= n; j++)
+	{
+		for (int i = 0; i <= n; i++)
+			obj.vertices.push_back({ float(i) / n, 0.0f, float(j) / n });
+	}
+	for (int j = 0; j < n; j++)
+	{
+		for (int i = 0; i < n; i++)
+		{
+			const int a = j * (n + 1) + i;
+			obj.triangles.insert(obj.triangles.end(), { a, a + n + 1, a + 1, a + 1, a + n + 1, a + n + 2 });
+		}
+	}
+
+	// Build time: connectivity is built by the first query
+	auto start = std::chrono::high_resolution_clock::now();
+	tinyrender::topology topology(obj);
+	int boundaryVertices = 0;
+	for (int v = 0; v < int(obj.vertices.size()); v++)
+		boundaryVertices += topology.isBoundaryVertex(v);
+	auto end = std::chrono::high_resolution_clock::now();
+	printf("Topology: %d edges, %d boundary vertices, built in %.1f ms\n", topology.edgeCount(), boundaryVertices,
+		std::chrono::duration<double, std::milli>(end - start).count());
+
+	// Traversal throughput: one-ring of every vertex
+	start = std::chrono::high_resolution_clock::now();
+	std::vector<int> neighbors;
+	size_t visited = 0;
+	for (int v = 0; v < int(obj.vertices.size()); v++)
+	{
+		topology.oneRing(v, neighbors);
+		visited += neighbors.size();
+	}
+	end = std::chrono::high_resolution_clock::now();
+	const double ms = std::chrono::duration<double, std::milli>(end - start).count();
+	printf("Topology: %zu one-ring neighbors in %.1f ms (%.0f M/s)\n", visited, ms, double(visited) / (ms * 1000.0));
+}
+
 int main() {
 	tinyrender::init("tinyrender", 800, 600);
 	tinyrender::setCameraAt(0.f, 0.f, 0.f);
 	tinyrender::setCameraEye(-10.f, 1.f, 0.f);
 	
 	//ExampleLoadMesh();
+	//ExampleTopologyBenchmark();
 	ExamplePrimitives();
 
 	while (!tinyrender::shouldQuit())
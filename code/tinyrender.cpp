@@ -2,22 +2,164 @@
 
 #include <assert.h>		// assert
 #include <stdio.h>      // fprintf
+#include <string.h>		// memcpy
 #include <fstream>		// ostream, endl
+#include <algorithm>	// min, max
+#include <thread>		// thread, hardware_concurrency
+#include <mutex>		// mutex, lock_guard
+#include <condition_variable>	// condition_variable
+#include <memory>		// unique_ptr
+#include <chrono>		// high_resolution_clock
+#include <functional>	// function
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TINYRENDER_USE_SSE2
+#include <emmintrin.h>	// SSE2 intrinsics
+#endif
+#include <deque>		// deque
+#include <limits>		// numeric_limits
+#include <atomic>		// atomic
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>	// CreateFileMapping, MapViewOfFile
+#else
+#include <fcntl.h>		// open
+#include <sys/mman.h>	// mmap, munmap
+#include <sys/stat.h>	// fstat
+#include <unistd.h>		// close
+#endif
 
 #include "../dependency/imgui/backends/imgui_impl_glfw.h"
 #include "../dependency/imgui/backends/imgui_impl_opengl3.h"
 
 namespace tinyrender
 {
+	static const int internalMaxActiveMorphTargets = 8;
+
+	struct occluder_internal
+	{
+	public:
+		// Occluder geometry, which must lie inside the object, and its bounds
+		std::vector<v3f> vertices;
+		std::vector<int> triangles;
+		v3f boundsMin, boundsMax;
+	};
+
+	struct tessellation_internal
+	{
+	public:
+		// Target length of the tessellated edges on screen, in pixels
+		float pixelsPerEdge = 8.0f;
+
+		// Optional height map, applied along the normal with triplanar mapping in object space
+		GLuint displacementTexture = 0;
+		float amplitude = 0.0f;
+		float tiling = 1.0f;
+	};
+
+	struct subdivision_internal
+	{
+	public:
+		// Stencil table of each level, in compressed rows: each refined vertex is a weighted sum of vertices of
+		// the previous level
+		struct level
+		{
+			std::vector<int> offsets;
+			std::vector<int> indices;
+			std::vector<float> weights;
+		};
+		std::vector<level> levels;
+		int cageVertexCount = 0;
+
+		// Refined triangles, and their vertex-face adjacency for normals
+		std::vector<int> triangles;
+		std::vector<int> adjacency;
+	};
+
+	struct meshlet_internal
+	{
+	public:
+		// Contiguous range in the element buffer of the object
+		int indexOffset = 0;
+		int indexCount = 0;
+
+		// Bounding box and sphere, and normal cone: the meshlet is back-facing when seen from inside the cone
+		// opposite to its axis, see _internalMeshletVisible
+		v3f boundsMin, boundsMax;
+		v3f center;
+		float radius = 0.0f;
+		v3f coneAxis;
+		float coneCutoff = 1.0f;
+	};
+	static const int internalMaxChunkTriangles = 1 << 20;
+	static const int internalTerrainPatchResolution = 32;
+	static const int internalVoxelChunkSize = 32;
+	static const int internalMaxSdfStack = 16;
+
 	struct object_internal
 	{
 	public:
 		GLuint vao = 0;
 		GLuint buffers = 0;
 		GLuint triangleBuffer = 0;
+		GLuint scalarBuffer = 0;
+		GLuint adjacencyBuffer = 0;
+		GLuint morphBuffer = 0;
+		GLuint morphTexture = 0;
 		float modelMatrix[4][4] = { 0 };
+		float localMatrix[4][4] = { 0 };
+		int parent = -1;
+
+		// Visibility: the object is drawn if it is visible and one of its layers is in the visible layer mask
+		unsigned int layers = 1;
+		bool isVisible = true;
+
+		// Local bounding box, used for frustum and occlusion culling when hasBounds is set. Bounds are not
+		// available for objects deformed in the vertex shader.
+		v3f boundsMin = { 0, 0, 0 };
+		v3f boundsMax = { 0, 0, 0 };
+		bool hasBounds = false;
+
+		// Index of the residency record of out-of-core objects, -1 for regular objects
+		int streamId = -1;
+
+		// Voxel volume owning this chunk or group object, -1 for other objects
+		int voxelVolume = -1;
+
+		// Spatial chunks of objects too large for a single buffer, each with its own buffers and bounds
+		std::vector<object_internal> chunks;
+
+		// Chunks only: index in the whole object of each vertex of the chunk, to route updates to the chunks
+		std::vector<int> chunkVertices;
+
+		// Optional occluder geometry, rasterized in the software depth buffer
+		std::shared_ptr<occluder_internal> occluder;
+
+		// Stencil tables of subdivision surfaces, which refine the control cage given to updateVertices
+		std::shared_ptr<subdivision_internal> subdivision;
+
+		// Hardware tessellation settings: triangles are then drawn as curved PN patches, refined on the GPU
+		std::shared_ptr<tessellation_internal> tessellation;
+
+		// Optional meshlets, culled every frame, and drawn with a single multi-draw
+		std::vector<meshlet_internal> meshlets;
+		bool meshletConeCulling = true;
+
+		float scalarRange[2] = { 0.0f, 1.0f };
+		int vertexCount = 0;
 		int triangleCount = 0;
 
+		// Morph targets: only the targets with a non-zero weight are blended in the vertex shader
+		int morphCount = 0;
+		bool morphNormals = false;
+		int morphActiveCount = 0;
+		int morphIndices[internalMaxActiveMorphTargets] = { 0 };
+		float morphWeights[internalMaxActiveMorphTargets] = { 0 };
+		bool morphDropWarned = false;
+
+		// Vertex-face adjacency and triangles, kept on the CPU only when normals are recomputed without compute shaders
+		std::vector<int> cpuAdjacency;
+		std::vector<int> cpuTriangles;
+
 		bool isDeleted = false;
 	};
 
@@ -48,15 +190,544 @@ namespace tinyrender
 		bool showNormals = false;
 		bool drawWireframe = true;
 		float wireframeThickness = 1.0f;
+
+		// Frame budget controller: the resolution is lowered while the camera moves to hold the budget
+		bool dynamicResolution = false;
+		bool simplifyWhileMoving = false;
+		float frameBudget = 16.0f;
+		float resolutionScale = 1.0f;
+		float minResolutionScale = 0.25f;
+		int idleFramesBeforeFullQuality = 10;
+		int idleFrames = 0;
+		bool cameraMoved = false;
+
+		// Layers that are drawn
+		unsigned int visibleLayers = 0xFFFFFFFF;
+
+		// Anti-aliasing of the final image
+		antialiasing antialiasingMode = antialiasing::none;
+
+		// Incremented whenever objects or lights change, to detect static frames
+		unsigned int sceneVersion = 0;
+
+		// GPU timers, read back with one frame of latency
+		GLuint timerQueries[2] = { 0, 0 };
+		float gpuFrameTime = 0.0f;
+		int frameIndex = 0;
+
+		// Context capabilities
+		bool hasComputeShaders = false;
+		bool hasTessellation = false;
+	};
+
+	struct framebuffer_internal
+	{
+	public:
+		GLuint fbo = 0;
+		GLuint color = 0;
+		GLuint depth = 0;
+		GLenum colorFormat = GL_RGBA8;
+		int width = 0;
+		int height = 0;
+		int samples = 0;
+	};
+
+	struct benchmark_internal
+	{
+	public:
+		// Measurement in progress, one step per resolution and anti-aliasing mode. A step starts with a warm-up
+		// frame, marked by framesLeft == -1, then its frames are rendered in small batches over several updates.
+		bool isRunning = false;
+		int frames = 60;
+		int step = 0;
+		int framesLeft = -1;
+		double elapsedMs = 0.0;
+		GLuint query = 0;
+		bool isQueryPending = false;
+		bool isRendering = false;
+		int maxSamples = 0;
+		framebuffer_internal output;
+
+		// Average GPU time per frame, at 1080p and 4K, for each mode, negative for modes the device does not support
+		float results[2][6] = { { 0 } };
+	};
+
+	struct accumulation_internal
+	{
+	public:
+		bool isEnabled = false;
+		int sampleCount = 0;
+		int maxSamples = 16;
+
+		// High precision running average of the jittered samples
+		framebuffer_internal history;
+
+		// Camera and render state of the last frame, compared to detect static frames
+		std::vector<float> lastState;
+		unsigned int lastVersion = 0;
+	};
+
+	struct light_internal
+	{
+	public:
+		v3f position = { 0, 0, 0 };
+		v3f color = { 1, 1, 1 };
+		float radius = 1.0f;
+
+		bool isDeleted = false;
+	};
+
+	// Froxel grid of the clustered forward shading, and maximum number of lights per froxel
+	static const int internalClusterX = 16, internalClusterY = 9, internalClusterZ = 24;
+	static const int internalMaxLightsPerCluster = 32;
+
+	struct clusters_internal
+	{
+	public:
+		// Texture buffers: lights (2 texels per light), froxel grid (offset, count), light indices
+		GLuint lightBuffer = 0, lightTexture = 0;
+		GLuint gridBuffer = 0, gridTexture = 0;
+		GLuint indexBuffer = 0, indexTexture = 0;
+		int lightCount = 0;
+
+		// Statistics of the last build
+		float buildTimeMs = 0.0f;
+		int maxLightsPerCluster = 0;
+		float averageLightsPerCluster = 0.0f;
+		int truncatedClusters = 0;
+	};
+
+	struct timeseries_slot_internal
+	{
+	public:
+		int frame = -1;
+		bool isReady = false;
+		std::vector<v3f> data;
+	};
+
+	struct timeseries_internal
+	{
+	public:
+		int objectId = -1;
+		int vertexCount = 0;
+		int frameCount = 0;
+		std::streamoff dataOffset = 0;
+
+		// Topology, only used when normals are computed on the CPU by the prefetch thread
+		std::vector<int> triangles;
+		std::vector<int> adjacency;
+		bool cpuNormals = false;
+
+		// Playback, in frames and frames per second
+		float time = 0.0f;
+		float speed = 0.0f;
+		bool loop = true;
+		int displayedFrame = 0;
+		int droppedFrames = 0;
+
+		// Double-buffered positions and normals, the front buffer is the one attached to the object
+		GLuint streamBuffers[2] = { 0, 0 };
+		int frontBuffer = 0;
+
+		// Prefetch thread, reading frames ahead of the playback position into a set of slots
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::vector<timeseries_slot_internal> slots;
+		int requestedFrame = 0;
+		int requestedStride = 1;
+		bool quit = false;
+
+		// First step predicted after the requested frame: 1 once it is displayed, 0 while it is missing
+		int requestedStart = 1;
+
+		// Frame data uploaded last, given back to the prefetch thread so that frames are read without reallocation
+		std::vector<v3f> recycled;
+	};
+
+	enum class residency_state
+	{
+		unloaded, loading, loaded, resident
+	};
+
+	struct streamed_internal
+	{
+	public:
+		int objectId = -1;
+		std::function<object()> source;
+		residency_state state = residency_state::unloaded;
+		size_t bytes = 0;
+		int lastUsedFrame = -1;
+
+		// Data read by the loading thread, waiting to be uploaded
+		object data;
+	};
+
+	struct residency_internal
+	{
+	public:
+		std::vector<std::unique_ptr<streamed_internal>> objects;
+		size_t budget = size_t(1) << 30;
+		size_t uploadBytesPerFrame = size_t(64) << 20;
+		size_t residentBytes = 0;
+		int evictions = 0;
+
+		// Loading thread, serving requests in order
+		std::thread thread;
+		std::mutex mutex;
+		std::condition_variable condition;
+		std::deque<int> requests;
+		bool quit = false;
+
+		// Unit box drawn in place of objects that are not resident
+		object_internal placeholder;
+	};
+
+	struct sdf_internal
+	{
+	public:
+		// Node graph compiled to a postfix program, four texels per instruction in a texture buffer, or distances
+		// sampled in a 3D texture
+		GLuint programBuffer = 0;
+		GLuint programTexture = 0;
+		int instructionCount = 0;
+		GLuint volumeTexture = 0;
+		int resolution = 0;
+		v3f color = { 0.5f, 0.5f, 0.5f };
+
+		// Proxy box, in object space, and transform
+		v3f boundsMin = { 0, 0, 0 };
+		v3f boundsMax = { 0, 0, 0 };
+		float modelMatrix[4][4] = { 0 };
+
+		bool isDeleted = false;
+	};
+
+	struct voxel_volume_internal
+	{
+	public:
+		// Voxel materials, 0 for empty voxels, and the color of each material
+		int size[3] = { 0, 0, 0 };
+		float voxelSize = 1.0f;
+		std::vector<unsigned char> voxels;
+		v3f palette[256];
+
+		// Chunks of internalVoxelChunkSize^3 voxels, each meshed into its own object, -1 until first meshed.
+		// Chunk objects are children of a group carrying the transform of the volume, and are tagged with the
+		// volume index, as the user may remove them.
+		int chunkCount[3] = { 0, 0, 0 };
+		std::vector<int> chunkObjects;
+		std::vector<unsigned char> isDirty;
+		bool hasDirtyChunks = false;
+		int groupId = -1;
+		v3f position = { 0, 0, 0 };
+
+		// Statistics of the last remeshing
+		int remeshedChunks = 0;
+		float remeshTimeMs = 0.0f;
+
+		bool isDeleted = false;
+	};
+
+	struct bvh_node_internal
+	{
+	public:
+		v3f boundsMin, boundsMax;
+
+		// Leaves store a range of triangles, inner nodes the index of their first child, the second one following it
+		int first = 0;
+		int count = 0;
+	};
+
+	struct bvh_internal
+	{
+	public:
+		std::vector<bvh_node_internal> nodes;
+		std::vector<v3f> triangles;
+	};
+
+	struct bake_internal
+	{
+	public:
+		int objectId = -1;
+		int rays = 0;
+		std::vector<v3f> baseColors;
+
+		// Baking thread, publishing the visibility accumulated after each pass
+		std::thread thread;
+		std::mutex mutex;
+		std::atomic<bool> cancel = { false };
+		std::atomic<bool> isDone = { false };
+		std::vector<float> visibility;
+		int rayCount = 0;
+		bool hasNewResult = false;
+	};
+
+	struct occlusion_internal
+	{
+	public:
+		bool isEnabled = false;
+		int maxOccluders = 8;
+
+		// Depth buffer storing the nearest occluder depth, in [0, 1], and the farthest depth of each tile
+		static const int tileSize = 8;
+		int width = 320;
+		int height = 0;
+		std::vector<float> depth;
+		std::vector<float> tileMax;
+
+		// Occluder triangles in screen space: x, y and depth of each vertex
+		std::vector<float> triangles;
+
+		// Statistics of the last frame
+		int occluderCount = 0;
+		int culledCount = 0;
+		float buildTimeMs = 0.0f;
+	};
+
+	struct terrain_internal
+	{
+	public:
+		// Heights, in a float texture and on the CPU for the bounds of the quadtree nodes
+		GLuint heightTexture = 0;
+		std::vector<float> heights;
+		int resolution = 0;
+		float size = 1.0f;
+		float heightScale = 1.0f;
+		v3f position = { 0, 0, 0 };
+
+		// Quadtree: level 0 nodes are single patches, and the root covers the whole terrain. Each node stores the
+		// minimum and maximum height of the area it covers.
+		int levelCount = 0;
+		std::vector<std::vector<float>> minMax;
+
+		// Distance up to which the finest level is used; each coarser level doubles it
+		float lodDistance = 16.0f;
+
+		// Statistics of the last frame
+		int nodesDrawn = 0;
+		int trianglesDrawn = 0;
+
+		bool isDeleted = false;
+	};
+
+	struct terrain_patch_internal
+	{
+	public:
+		// Grid of (n + 1)^2 vertices in [0, 1]^2, with indices sorted by quadrant so that each quadrant is drawn alone
+		GLuint vao = 0;
+		GLuint vertexBuffer = 0;
+		GLuint indexBuffer = 0;
+		int quadrantIndexCount = 0;
+	};
+
+	struct quadric_internal
+	{
+	public:
+		// Symmetric 4x4 matrix: a2, ab, ac, ad, b2, bc, bd, c2, cd, d2
+		double q[10] = { 0 };
+	};
+
+	struct simplify_internal
+	{
+	public:
+		// Mesh being simplified: removed triangles have their first index set to -1
+		std::vector<v3f> vertices;
+		std::vector<int> triangles;
+		std::vector<std::vector<int>> adjacency;
+		std::vector<quadric_internal> quadrics;
+		std::vector<unsigned char> isBoundary;
+		std::vector<unsigned char> isRemoved;
+		std::vector<unsigned int> stamps;
+
+		// Spatial partition of the current pass: vertices of triangles spanning several cells are locked
+		std::vector<int> vertexCell;
+		std::vector<unsigned char> isLocked;
+		float maxError2 = 0.0f;
+	};
+
+	struct transform_internal
+	{
+	public:
+		float m[4][4];
+	};
+
+	struct hierarchy_internal
+	{
+	public:
+		// Object ids in breadth-first order, with the start of each level, and the index of their parent in this order
+		std::vector<int> nodes;
+		std::vector<int> levels;
+		std::vector<int> parents;
+
+		// Local and world transforms, and dirty flags, stored in the same breadth-first order
+		std::vector<transform_internal> local;
+		std::vector<transform_internal> world;
+		std::vector<unsigned char> dirty;
+
+		// Index of each object in the breadth-first order
+		std::vector<int> nodeIndex;
+		bool needsRebuild = true;
+		bool hasDirty = false;
+	};
+
+	// Scene snapshot file layout: a header, then for each object a record followed by its buffers, each aligned
+	// to 16 bytes so that they can be uploaded straight from the mapped file. Objects split in chunks are followed
+	// by one record per chunk, with the same id, its buffers and the index of its vertices in the whole object.
+	struct snapshot_header_internal
+	{
+	public:
+		char magic[4];
+		int version;
+		int objectCount;
+		int lightCount;
+		v3f eye, at, up;
+		float zNear, zFar;
+		v3f lightDir;
+		int doLighting, showNormals, drawWireframe;
+		float wireframeThickness;
+	};
+
+	struct snapshot_object_internal
+	{
+	public:
+		int id;
+		int parent;
+		int vertexCount;
+		int triangleCount;
+		int chunkCount;
+		int hasBounds;
+		unsigned int layers;
+		int isVisible;
+		unsigned long long vertexBytes;
+		unsigned long long triangleBytes;
+		unsigned long long scalarBytes;
+		unsigned long long remapBytes;
+		float scalarRange[2];
+		float localMatrix[4][4];
+		float modelMatrix[4][4];
+		v3f boundsMin, boundsMax;
+	};
+
+	struct mapped_file_internal
+	{
+	public:
+		const char* data = nullptr;
+		size_t size = 0;
+#ifdef _WIN32
+		HANDLE file = INVALID_HANDLE_VALUE;
+		HANDLE mapping = nullptr;
+#else
+		int file = -1;
+#endif
 	};
 
 	static GLFWwindow* windowPtr;
 	static int width_internal, height_internal;
 	static std::vector<object_internal> internalObjects;
+	static hierarchy_internal internalHierarchy;
+	static residency_internal internalResidency;
+	static std::vector<unsigned char> internalMeshletVisibility;
+	static std::vector<GLsizei> internalDrawCounts;
+	static std::vector<const void*> internalDrawOffsets;
+	static int internalMeshletsDrawn, internalMeshletsTotal;
+	static const float internalIdentityMatrix[4][4] = { { 1, 0, 0, 0 }, { 0, 1, 0, 0 }, { 0, 0, 1, 0 }, { 0, 0, 0, 1 } };
+	static occlusion_internal internalOcclusion;
+	static std::vector<terrain_internal> internalTerrains;
+	static std::vector<voxel_volume_internal> internalVoxelVolumes;
+	static std::vector<sdf_internal> internalSdfObjects;
+	static GLuint internalSdfProgram;
+	static GLuint internalSdfBoxVao, internalSdfBoxBuffers[2];
+	static terrain_patch_internal internalTerrainPatch;
+	static GLuint internalTerrainProgram;
+	static GLuint internalTessellationProgram;
+	static std::vector<int> internalDrawList;
+	static bool internalDrawListDirty = true;
+	static std::vector<std::unique_ptr<timeseries_internal>> internalTimeSeries;
+	static std::vector<std::unique_ptr<bake_internal>> internalBakes;
+	static std::vector<light_internal> internalLights;
+	static clusters_internal internalClusters;
+	static framebuffer_internal internalSceneTarget;
+	static framebuffer_internal internalMultisampleTarget;
+	static framebuffer_internal internalEdgesTarget;
+	static GLuint internalFxaaProgram;
+	static GLuint internalSmaaEdgesProgram;
+	static GLuint internalSmaaBlendProgram;
+	static benchmark_internal internalBenchmark;
+	static accumulation_internal internalAccumulation;
+	static GLuint internalBlitProgram;
+	static GLuint internalFullscreenVao;
 	static std::vector<GLuint> internalShaders;
+	static GLuint internalColormapTexture;
+	static GLuint internalNormalProgram;
 	static scene_internal internalScene;
 
 
+	/*!
+	\brief Run a function over [0, count) split into contiguous ranges, one per hardware thread.
+	Small workloads are run on the calling thread.
+	\param count number of elements
+	\param func callable with signature void(int begin, int end)
+	\param grain minimum number of elements per thread
+	*/
+	template<typename Func>
+	static void _internalParallelFor(int count, const Func& func, int grain = 4096)
+	{
+		int threadCount = int(std::thread::hardware_concurrency());
+		threadCount = std::max(1, std::min(threadCount, count / std::max(1, grain)));
+		if (threadCount <= 1)
+		{
+			if (count > 0)
+				func(0, count);
+			return;
+		}
+
+		std::vector<std::thread> threads;
+		threads.reserve(threadCount - 1);
+		const int chunk = (count + threadCount - 1) / threadCount;
+		for (int t = 1; t < threadCount; t++)
+		{
+			const int begin = t * chunk;
+			const int end = std::min(count, begin + chunk);
+			if (begin < end)
+				threads.emplace_back([&func, begin, end]() { func(begin, end); });
+		}
+		func(0, std::min(count, chunk));
+		for (auto& t : threads)
+			t.join();
+	}
+
+	/*!
+	\brief Sort an array with several threads: chunks are sorted in parallel, then merged two by two.
+	\param values array to sort
+	*/
+	template<typename T>
+	static void _internalParallelSort(std::vector<T>& values)
+	{
+		const int count = int(values.size());
+		const int chunkCount = std::max(1, std::min(int(std::thread::hardware_concurrency()), count / 65536));
+		const int chunk = (count + chunkCount - 1) / chunkCount;
+		_internalParallelFor(chunkCount, [&](int begin, int end)
+		{
+			for (int c = begin; c < end; c++)
+				std::sort(values.begin() + std::min(count, c * chunk), values.begin() + std::min(count, (c + 1) * chunk));
+		}, 1);
+		for (int width = chunk; width < count; width *= 2)
+		{
+			const int mergeCount = (count + 2 * width - 1) / (2 * width);
+			_internalParallelFor(mergeCount, [&](int begin, int end)
+			{
+				for (int m = begin; m < end; m++)
+				{
+					const int first = m * 2 * width;
+					const int middle = std::min(count, first + width);
+					const int last = std::min(count, first + 2 * width);
+					std::inplace_merge(values.begin() + first, values.begin() + middle, values.begin() + last);
+				}
+			}, 1);
+		}
+	}
+
 	/*!
 	\brief Initialize a 4x4 matrix to identity.
 	\param Result matrix to initialize
@@ -102,18 +773,190 @@ namespace tinyrender
 	/*!
 	\brief Compute the perspective matrix for the current internal camera.
 	\param Result perspective matrix.
+	\param width, height dimensions of the render target, for the aspect ratio
+	\param jitterX, jitterY optional sub-pixel offset of the projection, in pixels.
 	*/
-	static void _internalCameraPerspective(float Result[4][4])
+	static void _internalCameraPerspective(float Result[4][4], int width, int height, float jitterX = 0.0f, float jitterY = 0.0f)
 	{
 		float const tanHalfFovy = tan(toRadian(45.0f) / 2.0f);
 		float const zNear = internalScene.zNear;
 		float const zFar = internalScene.zFar;
 
-		Result[0][0] = 1.0f / (((float)width_internal) / ((float)height_internal) * tanHalfFovy);
+		Result[0][0] = 1.0f / (((float)width) / ((float)height) * tanHalfFovy);
 		Result[1][1] = 1.0f / (tanHalfFovy);
 		Result[2][2] = -(zFar + zNear) / (zFar - zNear);
 		Result[2][3] = -1.0f;
 		Result[3][2] = -(2.0f * zFar * zNear) / (zFar - zNear);
+
+		// Sub-pixel offset in normalized device coordinates, applied after the perspective divide
+		Result[2][0] = -2.0f * jitterX / float(width);
+		Result[2][1] = -2.0f * jitterY / float(height);
+	}
+
+	/*!
+	\brief Returns an element of the Halton low discrepancy sequence.
+	\param index element index, starting at 1
+	\param base prime base
+	*/
+	static float _internalHalton(int index, int base)
+	{
+		float f = 1.0f, result = 0.0f;
+		while (index > 0)
+		{
+			f /= float(base);
+			result += f * float(index % base);
+			index /= base;
+		}
+		return result;
+	}
+
+	/*!
+	\brief Draw a fullscreen triangle sampling a texture into the currently bound framebuffer.
+	\param texture source texture
+	*/
+	static void _internalDrawFullscreen(GLuint texture)
+	{
+		glUseProgram(internalBlitProgram);
+		glUniform1i(glGetUniformLocation(internalBlitProgram, "uTexture"), 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glBindVertexArray(internalFullscreenVao);
+		glDisable(GL_DEPTH_TEST);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glEnable(GL_DEPTH_TEST);
+	}
+
+	/*!
+	\brief Draw a fullscreen triangle with a given post-process program, sampling a texture.
+	\param program post-process program, with a uTexture sampler and a uTexelSize uniform
+	\param texture source texture
+	\param width, height dimensions of the source texture
+	*/
+	static void _internalDrawPostProcess(GLuint program, GLuint texture, int width, int height)
+	{
+		glUseProgram(program);
+		glUniform1i(glGetUniformLocation(program, "uTexture"), 0);
+		glUniform1i(glGetUniformLocation(program, "uEdges"), 1);
+		glUniform2f(glGetUniformLocation(program, "uTexelSize"), 1.0f / float(width), 1.0f / float(height));
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, texture);
+		glBindVertexArray(internalFullscreenVao);
+		glDisable(GL_DEPTH_TEST);
+		glDrawArrays(GL_TRIANGLES, 0, 3);
+		glEnable(GL_DEPTH_TEST);
+	}
+
+	/*!
+	\brief Returns true if the camera, render flags and scene are unchanged since the last call.
+	*/
+	static bool _internalIsStaticFrame()
+	{
+		const v3f& e = internalScene.eye;
+		const v3f& a = internalScene.at;
+		const v3f& u = internalScene.up;
+		const v3f& l = internalScene.lightDir;
+		std::vector<float> state = {
+			e.x, e.y, e.z, a.x, a.y, a.z, u.x, u.y, u.z, l.x, l.y, l.z,
+			float(width_internal), float(height_internal), internalScene.zNear, internalScene.zFar,
+			float(internalScene.doLighting), float(internalScene.drawWireframe), float(internalScene.showNormals), internalScene.wireframeThickness
+		};
+		const bool isStatic = state == internalAccumulation.lastState && internalScene.sceneVersion == internalAccumulation.lastVersion;
+		internalAccumulation.lastState.swap(state);
+		internalAccumulation.lastVersion = internalScene.sceneVersion;
+		return isStatic;
+	}
+
+	/*!
+	\brief Delete the OpenGL resources of a framebuffer.
+	\param fb framebuffer
+	*/
+	static void _internalDeleteFramebuffer(framebuffer_internal& fb)
+	{
+		if (fb.fbo == 0)
+			return;
+		glDeleteFramebuffers(1, &fb.fbo);
+		if (fb.samples > 0)
+			glDeleteRenderbuffers(1, &fb.color);
+		else
+			glDeleteTextures(1, &fb.color);
+		glDeleteRenderbuffers(1, &fb.depth);
+		fb = framebuffer_internal();
+	}
+
+	/*!
+	\brief Resize a framebuffer with a color texture and a depth renderbuffer, creating it if needed.
+	Nothing is done if the size is unchanged.
+	\param fb framebuffer
+	\param width, height new dimensions
+	\param colorFormat internal format of the color texture
+	\param samples number of samples per pixel. Multisampled framebuffers use a color renderbuffer instead of a
+	texture, and must be resolved before sampling.
+	*/
+	static void _internalResizeFramebuffer(framebuffer_internal& fb, int width, int height, GLenum colorFormat = GL_RGBA8, int samples = 0)
+	{
+		if (fb.fbo != 0 && fb.width == width && fb.height == height && fb.colorFormat == colorFormat && fb.samples == samples)
+			return;
+		if (fb.fbo != 0 && fb.samples != samples)
+			_internalDeleteFramebuffer(fb);
+		if (fb.fbo == 0)
+		{
+			glGenFramebuffers(1, &fb.fbo);
+			if (samples > 0)
+				glGenRenderbuffers(1, &fb.color);
+			else
+				glGenTextures(1, &fb.color);
+			glGenRenderbuffers(1, &fb.depth);
+		}
+		fb.width = width;
+		fb.height = height;
+		fb.colorFormat = colorFormat;
+		fb.samples = samples;
+
+		glBindFramebuffer(GL_FRAMEBUFFER, fb.fbo);
+		if (samples > 0)
+		{
+			glBindRenderbuffer(GL_RENDERBUFFER, fb.color);
+			glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, colorFormat, width, height);
+			glBindRenderbuffer(GL_RENDERBUFFER, fb.depth);
+			glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_DEPTH_COMPONENT24, width, height);
+			glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, fb.color);
+		}
+		else
+		{
+			glBindTexture(GL_TEXTURE_2D, fb.color);
+			glTexImage2D(GL_TEXTURE_2D, 0, colorFormat, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glBindRenderbuffer(GL_RENDERBUFFER, fb.depth);
+			glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+			glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, fb.color, 0);
+		}
+		glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, fb.depth);
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	}
+
+	/*!
+	\brief Frame budget controller. While the camera moves, the resolution scale is adapted so that the GPU time of
+	the scene holds the frame budget, assuming a cost proportional to the pixel count. Full resolution is restored once
+	the camera has been idle for a given number of frames.
+	*/
+	static void _internalUpdateResolutionScale()
+	{
+		if (!internalScene.dynamicResolution || internalScene.idleFrames >= internalScene.idleFramesBeforeFullQuality)
+		{
+			internalScene.resolutionScale = 1.0f;
+			return;
+		}
+		if (internalScene.gpuFrameTime <= 0.0f)
+			return;
+
+		// Damped multiplicative update on the linear scale, the pixel count being its square
+		const float ratio = std::sqrt(internalScene.frameBudget / internalScene.gpuFrameTime);
+		const float target = internalScene.resolutionScale * std::max(0.5f, std::min(ratio, 1.5f));
+		float scale = internalScene.resolutionScale + 0.5f * (target - internalScene.resolutionScale);
+		internalScene.resolutionScale = std::max(internalScene.minResolutionScale, std::min(scale, 1.0f));
 	}
 
 	/*
@@ -125,6 +968,8 @@ namespace tinyrender
 	*/
 	static void _internalCameraMove(float x, float y, float z, float xPlane, float yPlane)
 	{
+		if (x != 0.0f || y != 0.0f || z != 0.0f || xPlane != 0.0f || yPlane != 0.0f)
+			internalScene.cameraMoved = true;
 		if (x != 0.0f)
 		{
 			v3f f = internalScene.at - internalScene.eye;
@@ -197,8 +1042,207 @@ namespace tinyrender
 	}
 
 	/*!
-	\brief Check the shader compile status and print opengl logs if needed.
-	\param handle shader id
+	\brief Multiply two 4x4 column-major matrices.
+	\param Result product a * b
+	\param a, b matrices
+	*/
+	static void _internalMultiplyMatrix(float Result[4][4], const float a[4][4], const float b[4][4])
+	{
+		for (int c = 0; c < 4; c++)
+		{
+			for (int r = 0; r < 4; r++)
+				Result[c][r] = a[0][r] * b[c][0] + a[1][r] * b[c][1] + a[2][r] * b[c][2] + a[3][r] * b[c][3];
+		}
+	}
+
+	/*!
+	\brief Extract the six frustum planes of a view projection matrix, as (a, b, c, d) with ax + by + cz + d >= 0
+	inside the frustum.
+	\param viewProjection column-major view projection matrix
+	\param planes frustum planes
+	*/
+	static void _internalExtractFrustum(const float viewProjection[4][4], float planes[6][4])
+	{
+		for (int i = 0; i < 3; i++)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				planes[2 * i][j] = viewProjection[j][3] + viewProjection[j][i];
+				planes[2 * i + 1][j] = viewProjection[j][3] - viewProjection[j][i];
+			}
+		}
+	}
+
+	/*!
+	\brief Returns true if a box, transformed by a model matrix, intersects the frustum.
+	\param planes frustum planes
+	\param model model matrix
+	\param boundsMin, boundsMax local box
+	*/
+	static bool _internalBoxInFrustum(const float planes[6][4], const float model[4][4], const v3f& boundsMin, const v3f& boundsMax)
+	{
+		// World space center and half extents of the transformed box
+		const v3f c = (boundsMin + boundsMax) * 0.5f;
+		const v3f e = (boundsMax - boundsMin) * 0.5f;
+		float center[3], extent[3];
+		for (int i = 0; i < 3; i++)
+		{
+			center[i] = model[0][i] * c.x + model[1][i] * c.y + model[2][i] * c.z + model[3][i];
+			extent[i] = std::abs(model[0][i]) * e.x + std::abs(model[1][i]) * e.y + std::abs(model[2][i]) * e.z;
+		}
+		for (int p = 0; p < 6; p++)
+		{
+			const float d = planes[p][0] * center[0] + planes[p][1] * center[1] + planes[p][2] * center[2] + planes[p][3];
+			const float r = std::abs(planes[p][0]) * extent[0] + std::abs(planes[p][1]) * extent[1] + std::abs(planes[p][2]) * extent[2];
+			if (d + r < 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	/*!
+	\brief Invert an affine 4x4 column-major matrix.
+	\param Result inverse matrix
+	\param m affine matrix, with an invertible upper 3x3 part
+	*/
+	static void _internalInverseAffine(float Result[4][4], const float m[4][4])
+	{
+		// Inverse of the upper 3x3 part from its cofactors
+		const float det = m[0][0] * (m[1][1] * m[2][2] - m[2][1] * m[1][2]) - m[1][0] * (m[0][1] * m[2][2] - m[2][1] * m[0][2]) + m[2][0] * (m[0][1] * m[1][2] - m[1][1] * m[0][2]);
+		const float invDet = 1.0f / det;
+		_internalIdentity(Result);
+		Result[0][0] = (m[1][1] * m[2][2] - m[2][1] * m[1][2]) * invDet;
+		Result[1][0] = (m[2][0] * m[1][2] - m[1][0] * m[2][2]) * invDet;
+		Result[2][0] = (m[1][0] * m[2][1] - m[2][0] * m[1][1]) * invDet;
+		Result[0][1] = (m[2][1] * m[0][2] - m[0][1] * m[2][2]) * invDet;
+		Result[1][1] = (m[0][0] * m[2][2] - m[2][0] * m[0][2]) * invDet;
+		Result[2][1] = (m[2][0] * m[0][1] - m[0][0] * m[2][1]) * invDet;
+		Result[0][2] = (m[0][1] * m[1][2] - m[1][1] * m[0][2]) * invDet;
+		Result[1][2] = (m[1][0] * m[0][2] - m[0][0] * m[1][2]) * invDet;
+		Result[2][2] = (m[0][0] * m[1][1] - m[1][0] * m[0][1]) * invDet;
+
+		// Inverse translation
+		for (int i = 0; i < 3; i++)
+			Result[3][i] = -(Result[0][i] * m[3][0] + Result[1][i] * m[3][1] + Result[2][i] * m[3][2]);
+	}
+
+	/*!
+	\brief Returns true if a meshlet may be visible: inside the frustum, and not entirely back-facing. The back-face
+	test is done in object space, where it is equivalent to the world space test for any affine transform.
+	\param meshlet meshlet
+	\param frustum frustum planes
+	\param model model matrix of the object
+	\param localEye camera position in object space
+	\param coneCulling enable the back-face test
+	*/
+	static bool _internalMeshletVisible(const meshlet_internal& meshlet, const float frustum[6][4], const float model[4][4], const v3f& localEye, bool coneCulling)
+	{
+		if (coneCulling)
+		{
+			const v3f d = meshlet.center - localEye;
+			if (internalDot(d, meshlet.coneAxis) >= meshlet.coneCutoff * internalLength(d) + meshlet.radius)
+				return false;
+		}
+		return _internalBoxInFrustum(frustum, model, meshlet.boundsMin, meshlet.boundsMax);
+	}
+
+	/*!
+	\brief Compute the bounding box of a set of points.
+	\param points points, not empty
+	\param boundsMin, boundsMax bounding box
+	*/
+	static void _internalComputeBounds(const std::vector<v3f>& points, v3f& boundsMin, v3f& boundsMax)
+	{
+		boundsMin = boundsMax = points.front();
+		for (const v3f& p : points)
+		{
+			boundsMin = { std::min(boundsMin.x, p.x), std::min(boundsMin.y, p.y), std::min(boundsMin.z, p.z) };
+			boundsMax = { std::max(boundsMax.x, p.x), std::max(boundsMax.y, p.y), std::max(boundsMax.z, p.z) };
+		}
+	}
+
+	/*!
+	\brief Compute the [min, max] range of a scalar array with a parallel reduction.
+	A degenerate range is slightly enlarged so that it can be safely used as a divisor in the shader.
+	\param values scalar array
+	\param Result resulting range
+	*/
+	static void _internalScalarRange(const std::vector<float>& values, float Result[2])
+	{
+		const int threadCount = std::max(1, std::min(int(std::thread::hardware_concurrency()), int(values.size()) / 4096));
+		std::vector<float> mins(threadCount, values.empty() ? 0.0f : values[0]);
+		std::vector<float> maxs(threadCount, values.empty() ? 1.0f : values[0]);
+		const int chunk = (int(values.size()) + threadCount - 1) / threadCount;
+		_internalParallelFor(threadCount, [&](int begin, int end)
+			{
+				for (int t = begin; t < end; t++)
+				{
+					const int first = t * chunk;
+					const int last = std::min(int(values.size()), first + chunk);
+					for (int i = first; i < last; i++)
+					{
+						mins[t] = std::min(mins[t], values[i]);
+						maxs[t] = std::max(maxs[t], values[i]);
+					}
+				}
+			}, 1);
+		Result[0] = *std::min_element(mins.begin(), mins.end());
+		Result[1] = *std::max_element(maxs.begin(), maxs.end());
+		if (Result[1] - Result[0] < 1e-6f)
+			Result[1] = Result[0] + 1e-6f;
+	}
+
+	/*!
+	\brief Upload per-vertex scalar values, creating the scalar buffer and its vertex attribute if needed.
+	The vertex array object of the object must be bound. The scalar range is recomputed.
+	\param obj internal object
+	\param values scalar array, one value per vertex
+	*/
+	static void _internalUploadScalars(object_internal& obj, const std::vector<float>& values)
+	{
+		if (obj.scalarBuffer == 0)
+		{
+			glGenBuffers(1, &obj.scalarBuffer);
+			glBindBuffer(GL_ARRAY_BUFFER, obj.scalarBuffer);
+			glBufferData(GL_ARRAY_BUFFER, sizeof(float) * values.size(), &values.front(), GL_DYNAMIC_DRAW);
+			glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 0, (const void*)0);
+			glEnableVertexAttribArray(3);
+		}
+		else
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, obj.scalarBuffer);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(float) * values.size(), &values.front());
+		}
+		_internalScalarRange(values, obj.scalarRange);
+	}
+
+	/*!
+	\brief Fill the 1D colormap texture by linearly interpolating a set of colors.
+	\param colors control colors, evenly spaced from the minimum to the maximum of the scalar range.
+	*/
+	static void _internalUploadColormap(const std::vector<v3f>& colors)
+	{
+		const int size = 256;
+		std::vector<v3f> texels(size);
+		for (int i = 0; i < size; i++)
+		{
+			const float t = float(i) / float(size - 1) * float(colors.size() - 1);
+			const int k = std::min(int(t), int(colors.size()) - 2);
+			const float a = colors.size() == 1 ? 0.0f : t - float(k);
+			texels[i] = colors.size() == 1 ? colors[0] : colors[k] * (1.0f - a) + colors[k + 1] * a;
+		}
+		if (internalColormapTexture == 0)
+			glGenTextures(1, &internalColormapTexture);
+		glBindTexture(GL_TEXTURE_1D, internalColormapTexture);
+		glTexImage1D(GL_TEXTURE_1D, 0, GL_RGB32F, size, 0, GL_RGB, GL_FLOAT, &texels.front());
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_1D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	}
+
+	/*!
+	\brief Check the shader compile status and print opengl logs if needed.
+	\param handle shader id
 	\param desc shader descriptor string, such as "Vertex Lit", "Fragment Lit" etc...
 	*/
 	static bool _internalCheckShader(GLuint handle, const char* desc)
@@ -218,6 +1262,381 @@ namespace tinyrender
 		return (GLboolean)status == GL_TRUE;
 	}
 
+	/*!
+	\brief Compile a shader of a given type and check its status.
+	\param type shader type, such as GL_VERTEX_SHADER
+	\param source shader source
+	\param desc shader descriptor string used in error logs
+	\returns the shader handle, or 0 if compilation failed.
+	*/
+	static GLuint _internalCompileShader(GLenum type, const GLchar* source, const char* desc)
+	{
+		GLuint handle = glCreateShader(type);
+		glShaderSource(handle, 1, &source, NULL);
+		glCompileShader(handle);
+		if (!_internalCheckShader(handle, desc))
+		{
+			glDeleteShader(handle);
+			return 0;
+		}
+		return handle;
+	}
+
+	/*!
+	\brief Read back the triangle array of an object from its element buffer.
+	\param obj internal object
+	\param Result triangle indices
+	*/
+	static void _internalReadTriangles(const object_internal& obj, std::vector<int>& Result)
+	{
+		Result.resize(obj.triangleCount);
+		glBindBuffer(GL_COPY_READ_BUFFER, obj.triangleBuffer);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(int) * Result.size(), &Result.front());
+	}
+
+	/*!
+	\brief Build the vertex to face adjacency of a triangle mesh as a flat array. The first vertexCount + 1 entries
+	are offsets into the rest of the array, which lists the faces adjacent to each vertex.
+	\param triangles triangle indices
+	\param vertexCount number of vertices
+	\param Result adjacency array
+	*/
+	static void _internalBuildVertexFaceAdjacency(const std::vector<int>& triangles, int vertexCount, std::vector<int>& Result)
+	{
+		const int offsetCount = vertexCount + 1;
+		Result.assign(offsetCount + triangles.size(), 0);
+		for (int i = 0; i < int(triangles.size()); i++)
+			Result[triangles[i] + 1]++;
+		for (int i = 0; i < vertexCount; i++)
+			Result[i + 1] += Result[i];
+		std::vector<int> fill(Result.begin(), Result.begin() + vertexCount);
+		for (int i = 0; i < int(triangles.size()); i++)
+			Result[offsetCount + fill[triangles[i]]++] = i / 3;
+	}
+
+	/*!
+	\brief Compute area-weighted vertex normals in parallel, one vertex at a time, using the vertex-face adjacency.
+	\param vertices vertex positions
+	\param triangles triangle indices
+	\param adjacency vertex-face adjacency, see _internalBuildVertexFaceAdjacency
+	\param Result normals, resized to the vertex count
+	*/
+	static void _internalComputeNormals(const std::vector<v3f>& vertices, const std::vector<int>& triangles,
+		const std::vector<int>& adjacency, std::vector<v3f>& Result)
+	{
+		const int vertexCount = int(vertices.size());
+		Result.resize(vertexCount);
+		_internalParallelFor(vertexCount, [&](int begin, int end)
+			{
+				for (int v = begin; v < end; v++)
+				{
+					v3f n = { 0, 0, 0 };
+					for (int k = adjacency[v]; k < adjacency[v + 1]; k++)
+					{
+						const int f = adjacency[vertexCount + 1 + k];
+						const v3f& a = vertices[triangles[3 * f + 0]];
+						const v3f& b = vertices[triangles[3 * f + 1]];
+						const v3f& c = vertices[triangles[3 * f + 2]];
+						n += internalCross(b - a, c - a);
+					}
+					Result[v] = internalLength2(n) > 0.0f ? internalNormalize(n) : v3f({ 0, 1, 0 });
+				}
+			});
+	}
+
+	/*!
+	\brief Build the stencil tables of a subdivision surface. Each level splits polygons: Loop subdivision splits
+	triangles in four, and Catmull-Clark splits n-gons in n quads, triangulated after the last level. Boundaries and
+	non-manifold edges follow the cubic B-spline curve rule.
+	\param triangles triangles of the control cage
+	\param vertexCount number of vertices of the control cage
+	\param levelCount number of subdivision levels
+	\param scheme subdivision scheme
+	\param Result stencil tables and refined triangles
+	*/
+	static void _internalBuildSubdivision(const std::vector<int>& triangles, int vertexCount, int levelCount, subdivision scheme, subdivision_internal& Result)
+	{
+		Result.levels.assign(levelCount, subdivision_internal::level());
+		Result.cageVertexCount = vertexCount;
+
+		// Polygons of the current level
+		std::vector<int> faceOffsets, faceVertices = triangles;
+		for (int f = 0; f <= int(triangles.size() / 3); f++)
+			faceOffsets.push_back(3 * f);
+
+		std::vector<std::pair<int, float>> row;
+		auto add = [&row](int v, float w)
+		{
+			for (auto& entry : row)
+			{
+				if (entry.first == v)
+				{
+					entry.second += w;
+					return;
+				}
+			}
+			row.push_back({ v, w });
+		};
+		for (int l = 0; l < levelCount; l++)
+		{
+			const int faceCount = int(faceOffsets.size()) - 1;
+			const int cornerCount = int(faceVertices.size());
+			std::vector<int> cornerFace(cornerCount), cornerNext(cornerCount);
+			for (int f = 0; f < faceCount; f++)
+			{
+				for (int c = faceOffsets[f]; c < faceOffsets[f + 1]; c++)
+				{
+					cornerFace[c] = f;
+					cornerNext[c] = c + 1 < faceOffsets[f + 1] ? c + 1 : faceOffsets[f];
+				}
+			}
+
+			// Edges, by sorting the undirected key of every corner
+			std::vector<std::pair<unsigned long long, int>> keys(cornerCount);
+			for (int c = 0; c < cornerCount; c++)
+			{
+				const unsigned int a = (unsigned int)faceVertices[c], b = (unsigned int)faceVertices[cornerNext[c]];
+				keys[c] = { (((unsigned long long)std::min(a, b)) << 32) | (unsigned long long)std::max(a, b), c };
+			}
+			_internalParallelSort(keys);
+			std::vector<int> cornerEdge(cornerCount), edgeCorners, edgeOffsets;
+			for (int i = 0; i < cornerCount; i++)
+			{
+				if (i == 0 || keys[i].first != keys[i - 1].first)
+					edgeOffsets.push_back(i);
+				cornerEdge[keys[i].second] = int(edgeOffsets.size()) - 1;
+				edgeCorners.push_back(keys[i].second);
+			}
+			const int edgeCount = int(edgeOffsets.size());
+			edgeOffsets.push_back(cornerCount);
+			auto isBoundaryEdge = [&](int e) { return edgeOffsets[e + 1] - edgeOffsets[e] != 2; };
+			auto edgeStart = [&](int e) { return faceVertices[edgeCorners[edgeOffsets[e]]]; };
+			auto edgeEnd = [&](int e) { return faceVertices[cornerNext[edgeCorners[edgeOffsets[e]]]]; };
+
+			// Edges and faces around each vertex
+			std::vector<int> vertexEdges(vertexCount + 1, 0), vertexFaces(vertexCount + 1, 0);
+			for (int e = 0; e < edgeCount; e++)
+			{
+				vertexEdges[edgeStart(e) + 1]++;
+				vertexEdges[edgeEnd(e) + 1]++;
+			}
+			for (int c = 0; c < cornerCount; c++)
+				vertexFaces[faceVertices[c] + 1]++;
+			for (int v = 0; v < vertexCount; v++)
+			{
+				vertexEdges[v + 1] += vertexEdges[v];
+				vertexFaces[v + 1] += vertexFaces[v];
+			}
+			std::vector<int> edgeList(vertexEdges[vertexCount]), faceList(vertexFaces[vertexCount]);
+			{
+				std::vector<int> fillEdges(vertexEdges.begin(), vertexEdges.end() - 1), fillFaces(vertexFaces.begin(), vertexFaces.end() - 1);
+				for (int e = 0; e < edgeCount; e++)
+				{
+					edgeList[fillEdges[edgeStart(e)]++] = e;
+					edgeList[fillEdges[edgeEnd(e)]++] = e;
+				}
+				for (int c = 0; c < cornerCount; c++)
+					faceList[fillFaces[faceVertices[c]]++] = cornerFace[c];
+			}
+
+			subdivision_internal::level& table = Result.levels[l];
+			table.offsets.assign(1, 0);
+			auto flush = [&]()
+			{
+				for (const auto& entry : row)
+				{
+					table.indices.push_back(entry.first);
+					table.weights.push_back(entry.second);
+				}
+				table.offsets.push_back(int(table.indices.size()));
+				row.clear();
+			};
+
+			// Vertex points
+			for (int v = 0; v < vertexCount; v++)
+			{
+				const int valence = vertexEdges[v + 1] - vertexEdges[v];
+				int boundaryCount = 0;
+				for (int k = vertexEdges[v]; k < vertexEdges[v + 1]; k++)
+					boundaryCount += isBoundaryEdge(edgeList[k]);
+				if (valence > 0 && boundaryCount == 0)
+				{
+					const float n = float(valence);
+					if (scheme == subdivision::loop)
+					{
+						const float beta = valence == 3 ? 3.0f / 16.0f : 3.0f / (8.0f * n);
+						add(v, 1.0f - n * beta);
+						for (int k = vertexEdges[v]; k < vertexEdges[v + 1]; k++)
+						{
+							const int e = edgeList[k];
+							add(edgeStart(e) == v ? edgeEnd(e) : edgeStart(e), beta);
+						}
+					}
+					else
+					{
+						// (F + 2R + (n - 3)v) / n, with F the average of the face points and R of the edge midpoints
+						add(v, (n - 3.0f) / n);
+						for (int k = vertexFaces[v]; k < vertexFaces[v + 1]; k++)
+						{
+							const int f = faceList[k];
+							const float w = 1.0f / (n * n * float(faceOffsets[f + 1] - faceOffsets[f]));
+							for (int c = faceOffsets[f]; c < faceOffsets[f + 1]; c++)
+								add(faceVertices[c], w);
+						}
+						for (int k = vertexEdges[v]; k < vertexEdges[v + 1]; k++)
+						{
+							add(edgeStart(edgeList[k]), 1.0f / (n * n));
+							add(edgeEnd(edgeList[k]), 1.0f / (n * n));
+						}
+					}
+				}
+				else if (boundaryCount == 2)
+				{
+					add(v, 0.75f);
+					for (int k = vertexEdges[v]; k < vertexEdges[v + 1]; k++)
+					{
+						const int e = edgeList[k];
+						if (isBoundaryEdge(e))
+							add(edgeStart(e) == v ? edgeEnd(e) : edgeStart(e), 0.125f);
+					}
+				}
+				else
+					add(v, 1.0f);
+				flush();
+			}
+
+			// Face points of Catmull-Clark subdivision
+			if (scheme == subdivision::catmullClark)
+			{
+				for (int f = 0; f < faceCount; f++)
+				{
+					const float w = 1.0f / float(faceOffsets[f + 1] - faceOffsets[f]);
+					for (int c = faceOffsets[f]; c < faceOffsets[f + 1]; c++)
+						add(faceVertices[c], w);
+					flush();
+				}
+			}
+
+			// Edge points
+			for (int e = 0; e < edgeCount; e++)
+			{
+				if (isBoundaryEdge(e))
+				{
+					add(edgeStart(e), 0.5f);
+					add(edgeEnd(e), 0.5f);
+				}
+				else if (scheme == subdivision::loop)
+				{
+					add(edgeStart(e), 0.375f);
+					add(edgeEnd(e), 0.375f);
+					for (int k = edgeOffsets[e]; k < edgeOffsets[e + 1]; k++)
+					{
+						const int c = edgeCorners[k];
+						add(faceVertices[cornerNext[cornerNext[c]]], 0.125f);
+					}
+				}
+				else
+				{
+					add(edgeStart(e), 0.25f);
+					add(edgeEnd(e), 0.25f);
+					for (int k = edgeOffsets[e]; k < edgeOffsets[e + 1]; k++)
+					{
+						const int f = cornerFace[edgeCorners[k]];
+						const float w = 0.25f / float(faceOffsets[f + 1] - faceOffsets[f]);
+						for (int c = faceOffsets[f]; c < faceOffsets[f + 1]; c++)
+							add(faceVertices[c], w);
+					}
+				}
+				flush();
+			}
+
+			// Refined polygons
+			const int edgeBase = scheme == subdivision::loop ? vertexCount : vertexCount + faceCount;
+			std::vector<int> newOffsets(1, 0), newVertices;
+			for (int f = 0; f < faceCount; f++)
+			{
+				const int first = faceOffsets[f], n = faceOffsets[f + 1] - first;
+				if (scheme == subdivision::loop)
+				{
+					const int v0 = faceVertices[first], v1 = faceVertices[first + 1], v2 = faceVertices[first + 2];
+					const int m0 = edgeBase + cornerEdge[first], m1 = edgeBase + cornerEdge[first + 1], m2 = edgeBase + cornerEdge[first + 2];
+					newVertices.insert(newVertices.end(), { v0, m0, m2, m0, v1, m1, m2, m1, v2, m0, m1, m2 });
+					for (int k = 0; k < 4; k++)
+						newOffsets.push_back(newOffsets.back() + 3);
+				}
+				else
+				{
+					for (int i = 0; i < n; i++)
+					{
+						const int c = first + i, previous = first + (i + n - 1) % n;
+						newVertices.insert(newVertices.end(), { faceVertices[c], edgeBase + cornerEdge[c], vertexCount + f, edgeBase + cornerEdge[previous] });
+						newOffsets.push_back(newOffsets.back() + 4);
+					}
+				}
+			}
+			faceOffsets.swap(newOffsets);
+			faceVertices.swap(newVertices);
+			vertexCount = edgeBase + edgeCount;
+		}
+
+		// Triangulate the final polygons
+		Result.triangles.clear();
+		for (int f = 0; f + 1 < int(faceOffsets.size()); f++)
+		{
+			for (int c = faceOffsets[f] + 1; c + 1 < faceOffsets[f + 1]; c++)
+				Result.triangles.insert(Result.triangles.end(), { faceVertices[faceOffsets[f]], faceVertices[c], faceVertices[c + 1] });
+		}
+		_internalBuildVertexFaceAdjacency(Result.triangles, vertexCount, Result.adjacency);
+	}
+
+	/*!
+	\brief Refine values of the control cage with the stencil tables of a subdivision surface: a sparse matrix-vector
+	product per level, computed in parallel.
+	\param s stencil tables
+	\param control values at the vertices of the control cage
+	\returns the values at the vertices of the refined mesh.
+	*/
+	template<typename T>
+	static std::vector<T> _internalRefine(const subdivision_internal& s, const std::vector<T>& control)
+	{
+		std::vector<T> current = control, refined;
+		for (const subdivision_internal::level& table : s.levels)
+		{
+			const int rowCount = int(table.offsets.size()) - 1;
+			refined.resize(rowCount);
+			_internalParallelFor(rowCount, [&](int begin, int end)
+				{
+					for (int i = begin; i < end; i++)
+					{
+						T sum = current[table.indices[table.offsets[i]]] * table.weights[table.offsets[i]];
+						for (int k = table.offsets[i] + 1; k < table.offsets[i + 1]; k++)
+							sum = sum + current[table.indices[k]] * table.weights[k];
+						refined[i] = sum;
+					}
+				});
+			current.swap(refined);
+		}
+		return current;
+	}
+
+	/*!
+	\brief Refine a control cage into a full object: positions, colors and scalars use the stencil tables, and
+	normals are computed on the refined mesh.
+	\param s stencil tables
+	\param cage control cage
+	\param Result refined object
+	*/
+	static void _internalRefineObject(const subdivision_internal& s, const object& cage, object& Result)
+	{
+		Result.position = cage.position;
+		Result.scale = cage.scale;
+		Result.vertices = _internalRefine(s, cage.vertices);
+		Result.colors = cage.colors.empty() ? std::vector<v3f>() : _internalRefine(s, cage.colors);
+		Result.scalars = cage.scalars.empty() ? std::vector<float>() : _internalRefine(s, cage.scalars);
+		Result.triangles = s.triangles;
+		_internalComputeNormals(Result.vertices, Result.triangles, s.adjacency, Result.normals);
+	}
+
 	/*!
 	\brief Create the internal representation of an object. Initialize opengl buffers.
 	\param obj high level object with mesh and color data.
@@ -232,6 +1651,7 @@ namespace tinyrender
 			colors.resize(obj.vertices.size(), { 0.5f, 0.5f, 0.5f });
 
 		// Model matrix
+		_internalComputeModelMatrix(ret.localMatrix, obj.position, obj.scale);
 		_internalComputeModelMatrix(ret.modelMatrix, obj.position, obj.scale);
 
 		// VAO
@@ -267,112 +1687,3037 @@ namespace tinyrender
 		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ret.triangleBuffer);
 		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(int) * obj.triangles.size(), &obj.triangles.front(), GL_STATIC_DRAW);
 		ret.triangleCount = int(obj.triangles.size());
+		ret.vertexCount = int(obj.vertices.size());
+
+		// Optional scalar field, stored in its own buffer
+		if (!obj.scalars.empty())
+			_internalUploadScalars(ret, obj.scalars);
+
+		// Bounds, for culling
+		_internalComputeBounds(obj.vertices, ret.boundsMin, ret.boundsMax);
+		ret.hasBounds = true;
 
 		return ret;
 	}
 
-	/*
-	\brief Update an already created object with new vertice/normal/color data.
-	\param id object index
-	\param newObj new data for the object.
+	/*!
+	\brief Compute the bounds of an object split in chunks, from the bounds of its chunks.
+	\param obj split object
 	*/
-	static void _internalUpdateObject(int id, const object& newObj)
+	static void _internalComputeChunkBounds(object_internal& obj)
 	{
-		object_internal& obj = internalObjects[id];
-
-		// Model matrix
-		_internalComputeModelMatrix(obj.modelMatrix, newObj.position, newObj.scale);
-
-		glBindVertexArray(obj.vao);
-		glBindBuffer(GL_ARRAY_BUFFER, obj.buffers);
-		size_t size = 0;
-		size_t offset = 0;
-		size = sizeof(v3f) * newObj.vertices.size();
-		glBufferSubData(GL_ARRAY_BUFFER, offset, size, &newObj.vertices.front());
-		offset = offset + size;
-		size = sizeof(v3f) * newObj.normals.size();
-		glBufferSubData(GL_ARRAY_BUFFER, offset, size, &newObj.normals.front());
-		if (newObj.colors.size() != 0)
+		for (size_t c = 0; c < obj.chunks.size(); c++)
 		{
-			offset = offset + size;
-			size = sizeof(v3f) * newObj.colors.size();
-			glBufferSubData(GL_ARRAY_BUFFER, offset, size, &newObj.colors.front());
+			const object_internal& chunk = obj.chunks[c];
+			obj.boundsMin = c == 0 ? chunk.boundsMin : v3f({ std::min(obj.boundsMin.x, chunk.boundsMin.x), std::min(obj.boundsMin.y, chunk.boundsMin.y), std::min(obj.boundsMin.z, chunk.boundsMin.z) });
+			obj.boundsMax = c == 0 ? chunk.boundsMax : v3f({ std::max(obj.boundsMax.x, chunk.boundsMax.x), std::max(obj.boundsMax.y, chunk.boundsMax.y), std::max(obj.boundsMax.z, chunk.boundsMax.z) });
 		}
+		obj.hasBounds = true;
 	}
 
-	/*
-	\brief Update an already created object with new color data.
-	\param id object index
-	\param newColors new color data for the object.
+	/*!
+	\brief Gather the values of the vertices of a chunk from a per-vertex array of the whole object.
+	\param chunk chunk of a split object
+	\param values per-vertex values of the whole object
+	\param Result values of the chunk vertices
 	*/
-	static void _internalUpdateObject(int id, const std::vector<v3f>& newColors)
+	template<typename T>
+	static void _internalGatherChunk(const object_internal& chunk, const std::vector<T>& values, std::vector<T>& Result)
 	{
-		object_internal& obj = internalObjects[id];
-		glBindVertexArray(obj.vao);
-		glBindBuffer(GL_ARRAY_BUFFER, obj.buffers);
-		size_t size = 0;
-		size_t offset = 0;
-		size = sizeof(v3f) * newColors.size();
-		offset = offset + 2 * size; // offset = vertexCount + normalCount (and vertexCount == colorCount)
-		glBufferSubData(GL_ARRAY_BUFFER, offset, size, &newColors.front());
+		Result.resize(chunk.chunkVertices.size());
+		for (size_t i = 0; i < chunk.chunkVertices.size(); i++)
+			Result[i] = values[chunk.chunkVertices[i]];
 	}
 
-	/*
-	\brief Deletes an object from the internal hierarchy. Destroys the opengl buffers.
-	\param id object index
+	/*!
+	\brief Create an object split into spatially coherent chunks of at most internalMaxChunkTriangles triangles.
+	Triangles are recursively partitioned at the median of their centroids along the longest axis, and each chunk
+	gets its own vertex subset, buffers and bounds, so that chunks are culled and drawn independently.
+	\param obj object data
 	*/
-	static bool _internalDeleteObject(int id)
+	static object_internal _internalCreateSplitObject(const object& obj)
 	{
-		object_internal& obj = internalObjects[id];
-		if (obj.isDeleted)
-			return false;
+		object_internal ret;
+		_internalComputeModelMatrix(ret.localMatrix, obj.position, obj.scale);
+		_internalComputeModelMatrix(ret.modelMatrix, obj.position, obj.scale);
+		ret.vertexCount = int(obj.vertices.size());
+		ret.triangleCount = int(obj.triangles.size());
+		if (!obj.scalars.empty())
+			_internalScalarRange(obj.scalars, ret.scalarRange);
 
-		glDeleteBuffers(1, &obj.buffers);
-		glDeleteBuffers(1, &obj.triangleBuffer);
-		glDeleteVertexArrays(1, &obj.vao);
+		// Triangle centroids
+		const int triangleCount = int(obj.triangles.size() / 3);
+		std::vector<v3f> centroids(triangleCount);
+		_internalParallelFor(triangleCount, [&](int begin, int end)
+		{
+			for (int t = begin; t < end; t++)
+				centroids[t] = (obj.vertices[obj.triangles[3 * t]] + obj.vertices[obj.triangles[3 * t + 1]] + obj.vertices[obj.triangles[3 * t + 2]]) / 3.0f;
+		});
 
-		// Objects are not actually removed from the internal vector, but flagged as deleted.
-		// This is to ensure indices of existing objects will not change from the API point of view.
-		obj.isDeleted = true;
+		// Median splits, until every range is small enough
+		std::vector<int> order(triangleCount);
+		for (int t = 0; t < triangleCount; t++)
+			order[t] = t;
+		std::vector<std::pair<int, int>> ranges, stack = { { 0, triangleCount } };
+		while (!stack.empty())
+		{
+			const std::pair<int, int> range = stack.back();
+			stack.pop_back();
+			if (range.second - range.first <= internalMaxChunkTriangles)
+			{
+				ranges.push_back(range);
+				continue;
+			}
+			v3f lo = centroids[order[range.first]], hi = lo;
+			for (int k = range.first; k < range.second; k++)
+			{
+				const v3f& c = centroids[order[k]];
+				lo = { std::min(lo.x, c.x), std::min(lo.y, c.y), std::min(lo.z, c.z) };
+				hi = { std::max(hi.x, c.x), std::max(hi.y, c.y), std::max(hi.z, c.z) };
+			}
+			const v3f extent = hi - lo;
+			const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+			const int middle = (range.first + range.second) / 2;
+			std::nth_element(order.begin() + range.first, order.begin() + middle, order.begin() + range.second,
+				[&centroids, axis](int a, int b) { return centroids[a].v[axis] < centroids[b].v[axis]; });
+			stack.push_back({ range.first, middle });
+			stack.push_back({ middle, range.second });
+		}
 
-		return true;
-	}
+		// Chunk data, with vertices remapped to a local index range
+		std::vector<object> chunkData(ranges.size());
+		std::vector<std::vector<int>> chunkVertices(ranges.size());
+		_internalParallelFor(int(ranges.size()), [&](int begin, int end)
+		{
+			std::vector<int> remap(obj.vertices.size(), -1);
+			for (int c = begin; c < end; c++)
+			{
+				object& chunk = chunkData[c];
+				for (int k = ranges[c].first; k < ranges[c].second; k++)
+				{
+					for (int j = 0; j < 3; j++)
+					{
+						const int v = obj.triangles[3 * order[k] + j];
+						if (remap[v] == -1)
+						{
+							remap[v] = int(chunk.vertices.size());
+							chunkVertices[c].push_back(v);
+							chunk.vertices.push_back(obj.vertices[v]);
+							chunk.normals.push_back(obj.normals[v]);
+							if (!obj.colors.empty())
+								chunk.colors.push_back(obj.colors[v]);
+							if (!obj.scalars.empty())
+								chunk.scalars.push_back(obj.scalars[v]);
+						}
+						chunk.triangles.push_back(remap[v]);
+					}
+				}
+				for (int k = ranges[c].first; k < ranges[c].second; k++)
+				{
+					for (int j = 0; j < 3; j++)
+						remap[obj.triangles[3 * order[k] + j]] = -1;
+				}
+			}
+		}, 1);
 
-	/*
-	\brief Returns the next free index in the internal object array.
-	*/
-	static int _internalGetNextFreeIndex()
-	{
-		for (int i = 0; i < internalObjects.size(); i++)
+		// Buffers and bounds of each chunk, and bounds of the whole object
+		ret.chunks.resize(chunkData.size());
+		for (size_t c = 0; c < chunkData.size(); c++)
 		{
-			if (internalObjects[i].isDeleted)
-				return i;
+			ret.chunks[c] = _internalCreateObject(chunkData[c]);
+			ret.chunks[c].chunkVertices.swap(chunkVertices[c]);
 		}
-		return int(internalObjects.size());
+		_internalComputeChunkBounds(ret);
+		return ret;
 	}
 
+	/*!
+	\brief Returns false, with an error message, if an object has no geometry to modify: groups, and out-of-core
+	objects that are not resident.
+	\param id object index
+	*/
+	static bool _internalCheckHasGeometry(int id)
+	{
+		const object_internal& obj = internalObjects[id];
+		if (obj.vao != 0 || !obj.chunks.empty())
+			return true;
+		if (obj.streamId != -1)
+			fprintf(stderr, "Object %d is not resident, its geometry cannot be modified\n", id);
+		else
+			fprintf(stderr, "Object %d is a group, it has no geometry\n", id);
+		return false;
+	}
 
 	/*!
-	\brief Init a window sized (width, height) with a given name.
-	\param windowName name of the window on top bar
-	\param width, height window dimensions. If either is -1, then the window will
-	maximized at startup with screen resolution.
+	\brief Returns false, with an error message, if an object is split in chunks, for operations that need a single
+	vertex and element buffer.
+	\param id object index
 	*/
-	void init(const char* windowName, int width, int height)
+	static bool _internalCheckNotSplit(int id)
 	{
-		// Window
-		glfwInit();
-		if (width == -1 || height == -1)
-		{
-			const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
-			width = mode->width;
-			height = mode->height;
-		}
-		width_internal = width;
-		height_internal = height;
+		if (internalObjects[id].chunks.empty())
+			return true;
+		fprintf(stderr, "Object %d is split in chunks, which this operation does not support\n", id);
+		return false;
+	}
 
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
-		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
+	/*!
+	\brief Set the local transform of an object, relative to its parent, and flag it as dirty.
+	\param id object index
+	\param position, scale local position and scale
+	*/
+	static void _internalSetLocalTransform(int id, const v3f& position, const v3f& scale)
+	{
+		object_internal& obj = internalObjects[id];
+		_internalComputeModelMatrix(obj.localMatrix, position, scale);
+		if (internalHierarchy.needsRebuild)
+			return;
+		const int index = internalHierarchy.nodeIndex[id];
+		internalHierarchy.local[index] = *reinterpret_cast<const transform_internal*>(obj.localMatrix);
+		internalHierarchy.dirty[index] = 1;
+		internalHierarchy.hasDirty = true;
+	}
+
+	/*!
+	\brief Rebuild the breadth-first order of the scene graph after objects were added, removed or reparented.
+	All transforms are flagged as dirty.
+	*/
+	static void _internalRebuildHierarchy()
+	{
+		hierarchy_internal& h = internalHierarchy;
+		const int objectCount = int(internalObjects.size());
+
+		// Children of each object, in compressed rows: roots are the children of the virtual node objectCount
+		std::vector<int> offsets(objectCount + 2, 0);
+		for (int i = 0; i < objectCount; i++)
+		{
+			if (!internalObjects[i].isDeleted)
+			{
+				const int p = internalObjects[i].parent;
+				offsets[(p < 0 ? objectCount : p) + 1]++;
+			}
+		}
+		for (int i = 0; i <= objectCount; i++)
+			offsets[i + 1] += offsets[i];
+		std::vector<int> children(offsets.back());
+		std::vector<int> fill(offsets.begin(), offsets.end() - 1);
+		for (int i = 0; i < objectCount; i++)
+		{
+			if (!internalObjects[i].isDeleted)
+			{
+				const int p = internalObjects[i].parent;
+				children[fill[p < 0 ? objectCount : p]++] = i;
+			}
+		}
+
+		// Breadth-first traversal, level by level
+		h.nodes.clear();
+		h.parents.clear();
+		h.levels.clear();
+		h.nodeIndex.assign(objectCount, -1);
+		for (int c = offsets[objectCount]; c < offsets[objectCount + 1]; c++)
+		{
+			h.nodes.push_back(children[c]);
+			h.parents.push_back(-1);
+		}
+		int levelBegin = 0;
+		while (levelBegin < int(h.nodes.size()))
+		{
+			const int levelEnd = int(h.nodes.size());
+			h.levels.push_back(levelBegin);
+			for (int i = levelBegin; i < levelEnd; i++)
+			{
+				const int id = h.nodes[i];
+				h.nodeIndex[id] = i;
+				for (int c = offsets[id]; c < offsets[id + 1]; c++)
+				{
+					h.nodes.push_back(children[c]);
+					h.parents.push_back(i);
+				}
+			}
+			levelBegin = levelEnd;
+		}
+		h.levels.push_back(int(h.nodes.size()));
+
+		const int nodeCount = int(h.nodes.size());
+		h.local.resize(nodeCount);
+		h.world.resize(nodeCount);
+		h.dirty.assign(nodeCount, 1);
+		for (int i = 0; i < nodeCount; i++)
+			h.local[i] = *reinterpret_cast<const transform_internal*>(internalObjects[h.nodes[i]].localMatrix);
+		h.needsRebuild = false;
+		h.hasDirty = true;
+	}
+
+	/*!
+	\brief Recompute the world transforms of dirty subtrees, and write them to the model matrices of the objects.
+	Levels are processed in order, each one in parallel: a node is recomputed if it, or its parent, is dirty.
+	*/
+	static void _internalUpdateTransforms()
+	{
+		hierarchy_internal& h = internalHierarchy;
+		if (h.needsRebuild)
+			_internalRebuildHierarchy();
+		if (!h.hasDirty)
+			return;
+
+		for (size_t l = 0; l + 1 < h.levels.size(); l++)
+		{
+			const int levelBegin = h.levels[l];
+			_internalParallelFor(h.levels[l + 1] - levelBegin, [&h, levelBegin](int begin, int end)
+			{
+				for (int i = levelBegin + begin; i < levelBegin + end; i++)
+				{
+					const int p = h.parents[i];
+					if (p >= 0 && h.dirty[p])
+						h.dirty[i] = 1;
+					if (!h.dirty[i])
+						continue;
+					if (p < 0)
+						h.world[i] = h.local[i];
+					else
+						_internalMultiplyMatrix(h.world[i].m, h.world[p].m, h.local[i].m);
+					std::copy(&h.world[i].m[0][0], &h.world[i].m[0][0] + 16, &internalObjects[h.nodes[i]].modelMatrix[0][0]);
+				}
+			}, 1024);
+		}
+		std::fill(h.dirty.begin(), h.dirty.end(), 0);
+		h.hasDirty = false;
+	}
+
+	/*!
+	\brief Rasterize occluder triangles in rows [yBegin, yEnd) of the occlusion depth buffer, keeping the nearest
+	depth, four pixels at a time with SSE2 when available.
+	\param yBegin, yEnd rows to rasterize
+	*/
+	static void _internalRasterizeOccluders(int yBegin, int yEnd)
+	{
+		occlusion_internal& occlusion = internalOcclusion;
+		const int width = occlusion.width;
+		const size_t triangleCount = occlusion.triangles.size() / 9;
+		for (size_t t = 0; t < triangleCount; t++)
+		{
+			const float* v = &occlusion.triangles[9 * t];
+			float x0 = v[0], y0 = v[1], z0 = v[2], x1 = v[3], y1 = v[4], z1 = v[5], x2 = v[6], y2 = v[7], z2 = v[8];
+			const int minY = std::max(yBegin, int(std::floor(std::min(y0, std::min(y1, y2)))));
+			const int maxY = std::min(yEnd - 1, int(std::ceil(std::max(y0, std::max(y1, y2)))));
+			const int minX = std::max(0, int(std::floor(std::min(x0, std::min(x1, x2)))));
+			const int maxX = std::min(width - 1, int(std::ceil(std::max(x0, std::max(x1, x2)))));
+			if (minY > maxY || minX > maxX)
+				continue;
+
+			// Counter-clockwise winding, so that edge functions are positive inside
+			float area = (x1 - x0) * (y2 - y0) - (y1 - y0) * (x2 - x0);
+			if (std::abs(area) < 1e-8f)
+				continue;
+			if (area < 0.0f)
+			{
+				std::swap(x1, x2); std::swap(y1, y2); std::swap(z1, z2);
+				area = -area;
+			}
+
+			// Edge functions and depth as linear functions a * x + b * y + c of the pixel center
+			const float a0 = y1 - y2, b0 = x2 - x1, c0 = x1 * y2 - x2 * y1;
+			const float a1 = y2 - y0, b1 = x0 - x2, c1 = x2 * y0 - x0 * y2;
+			const float a2 = y0 - y1, b2 = x1 - x0, c2 = x0 * y1 - x1 * y0;
+			const float za = (a0 * z0 + a1 * z1 + a2 * z2) / area;
+			const float zb = (b0 * z0 + b1 * z1 + b2 * z2) / area;
+			const float zc = (c0 * z0 + c1 * z1 + c2 * z2) / area;
+			const int startX = minX & ~3;
+			for (int y = minY; y <= maxY; y++)
+			{
+				const float py = float(y) + 0.5f;
+				float* row = &occlusion.depth[size_t(y) * width];
+#ifdef TINYRENDER_USE_SSE2
+				const __m128 offsets = _mm_setr_ps(0.5f, 1.5f, 2.5f, 3.5f);
+				const __m128 zero = _mm_setzero_ps();
+				for (int x = startX; x <= maxX; x += 4)
+				{
+					const __m128 px = _mm_add_ps(_mm_set1_ps(float(x)), offsets);
+					const __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a0), px), _mm_set1_ps(b0 * py + c0));
+					const __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a1), px), _mm_set1_ps(b1 * py + c1));
+					const __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(a2), px), _mm_set1_ps(b2 * py + c2));
+					const __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero), _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+					if (_mm_movemask_ps(inside) == 0)
+						continue;
+					const __m128 z = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(za), px), _mm_set1_ps(zb * py + zc));
+					const __m128 previous = _mm_loadu_ps(row + x);
+					const __m128 nearest = _mm_min_ps(previous, z);
+					_mm_storeu_ps(row + x, _mm_or_ps(_mm_and_ps(inside, nearest), _mm_andnot_ps(inside, previous)));
+				}
+#else
+				for (int x = minX; x <= maxX; x++)
+				{
+					const float px = float(x) + 0.5f;
+					if (a0 * px + b0 * py + c0 >= 0.0f && a1 * px + b1 * py + c1 >= 0.0f && a2 * px + b2 * py + c2 >= 0.0f)
+						row[x] = std::min(row[x], za * px + zb * py + zc);
+				}
+#endif
+			}
+		}
+	}
+
+	/*!
+	\brief Build the occlusion depth buffer for a frame: select the occluders with the largest projected size,
+	transform their triangles to screen space, then rasterize bands of tile rows in parallel, and compute the
+	farthest depth of each tile.
+	\param viewProjection view projection matrix
+	\param frustum frustum planes
+	\param targetWidth, targetHeight dimensions of the render target, for the aspect ratio of the depth buffer
+	*/
+	static void _internalBuildOcclusion(const float viewProjection[4][4], const float frustum[6][4], int targetWidth, int targetHeight)
+	{
+		occlusion_internal& occlusion = internalOcclusion;
+		const auto start = std::chrono::high_resolution_clock::now();
+		const int tileSize = occlusion_internal::tileSize;
+		occlusion.height = std::max(tileSize, (occlusion.width * targetHeight / std::max(1, targetWidth) + tileSize - 1) / tileSize * tileSize);
+		occlusion.depth.assign(size_t(occlusion.width) * occlusion.height, 1.0f);
+		occlusion.tileMax.assign(size_t(occlusion.width / tileSize) * (occlusion.height / tileSize), 1.0f);
+		occlusion.triangles.clear();
+
+		// Occluders in the draw list and in the frustum, by decreasing projected size
+		std::vector<std::pair<float, int>> candidates;
+		for (int i : internalDrawList)
+		{
+			const object_internal& obj = internalObjects[i];
+			if (!obj.occluder || !_internalBoxInFrustum(frustum, obj.modelMatrix, obj.occluder->boundsMin, obj.occluder->boundsMax))
+				continue;
+			float center[3], radius = 0.0f;
+			const v3f c = (obj.occluder->boundsMin + obj.occluder->boundsMax) * 0.5f;
+			const v3f e = (obj.occluder->boundsMax - obj.occluder->boundsMin) * 0.5f;
+			for (int k = 0; k < 3; k++)
+			{
+				center[k] = obj.modelMatrix[0][k] * c.x + obj.modelMatrix[1][k] * c.y + obj.modelMatrix[2][k] * c.z + obj.modelMatrix[3][k];
+				const float axis = std::abs(obj.modelMatrix[0][k]) * e.x + std::abs(obj.modelMatrix[1][k]) * e.y + std::abs(obj.modelMatrix[2][k]) * e.z;
+				radius += axis * axis;
+			}
+			const v3f d = v3f({ center[0], center[1], center[2] }) - internalScene.eye;
+			candidates.push_back({ -radius / std::max(internalLength2(d), 1e-6f), i });
+		}
+		std::sort(candidates.begin(), candidates.end());
+		candidates.resize(std::min(candidates.size(), size_t(occlusion.maxOccluders)));
+		occlusion.occluderCount = int(candidates.size());
+
+		// Screen space triangles; triangles crossing the near plane are skipped, which is conservative
+		const float width = float(occlusion.width), height = float(occlusion.height);
+		for (const auto& candidate : candidates)
+		{
+			const object_internal& obj = internalObjects[candidate.second];
+			const occluder_internal& occluder = *obj.occluder;
+			float mvp[4][4];
+			_internalMultiplyMatrix(mvp, viewProjection, obj.modelMatrix);
+			std::vector<float> projected(4 * occluder.vertices.size());
+			_internalParallelFor(int(occluder.vertices.size()), [&](int begin, int end)
+			{
+				for (int v = begin; v < end; v++)
+				{
+					const v3f& p = occluder.vertices[v];
+					float clip[4];
+					for (int k = 0; k < 4; k++)
+						clip[k] = mvp[0][k] * p.x + mvp[1][k] * p.y + mvp[2][k] * p.z + mvp[3][k];
+					projected[4 * v + 3] = clip[3];
+					if (clip[3] <= 1e-5f)
+						continue;
+					projected[4 * v] = (clip[0] / clip[3] * 0.5f + 0.5f) * width;
+					projected[4 * v + 1] = (clip[1] / clip[3] * 0.5f + 0.5f) * height;
+					projected[4 * v + 2] = clip[2] / clip[3] * 0.5f + 0.5f;
+				}
+			});
+			for (size_t t = 0; t + 2 < occluder.triangles.size(); t += 3)
+			{
+				const int* tri = &occluder.triangles[t];
+				if (projected[4 * tri[0] + 3] <= 1e-5f || projected[4 * tri[1] + 3] <= 1e-5f || projected[4 * tri[2] + 3] <= 1e-5f)
+					continue;
+				for (int j = 0; j < 3; j++)
+					occlusion.triangles.insert(occlusion.triangles.end(), &projected[4 * tri[j]], &projected[4 * tri[j]] + 3);
+			}
+		}
+
+		// Rasterize and reduce each row of tiles on its own thread
+		const int tileColumns = occlusion.width / tileSize;
+		_internalParallelFor(occlusion.height / tileSize, [&](int begin, int end)
+		{
+			for (int ty = begin; ty < end; ty++)
+			{
+				_internalRasterizeOccluders(ty * tileSize, (ty + 1) * tileSize);
+				for (int tx = 0; tx < tileColumns; tx++)
+				{
+					float farthest = 0.0f;
+					for (int y = ty * tileSize; y < (ty + 1) * tileSize; y++)
+					{
+						for (int x = tx * tileSize; x < (tx + 1) * tileSize; x++)
+							farthest = std::max(farthest, occlusion.depth[size_t(y) * occlusion.width + x]);
+					}
+					occlusion.tileMax[size_t(ty) * tileColumns + tx] = farthest;
+				}
+			}
+		}, 1);
+		occlusion.buildTimeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+	}
+
+	/*!
+	\brief Returns true if a box is hidden behind the occluders: its nearest depth is behind the farthest depth of
+	every tile it covers on screen.
+	\param viewProjection view projection matrix
+	\param model model matrix
+	\param boundsMin, boundsMax local box
+	*/
+	static bool _internalIsOccluded(const float viewProjection[4][4], const float model[4][4], const v3f& boundsMin, const v3f& boundsMax)
+	{
+		const occlusion_internal& occlusion = internalOcclusion;
+		if (occlusion.triangles.empty())
+			return false;
+		float mvp[4][4];
+		_internalMultiplyMatrix(mvp, viewProjection, model);
+		float minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, minZ = 1e30f;
+		for (int c = 0; c < 8; c++)
+		{
+			const v3f p = { (c & 1) ? boundsMax.x : boundsMin.x, (c & 2) ? boundsMax.y : boundsMin.y, (c & 4) ? boundsMax.z : boundsMin.z };
+			float clip[4];
+			for (int k = 0; k < 4; k++)
+				clip[k] = mvp[0][k] * p.x + mvp[1][k] * p.y + mvp[2][k] * p.z + mvp[3][k];
+			if (clip[3] <= 1e-5f)
+				return false;
+			const float x = (clip[0] / clip[3] * 0.5f + 0.5f) * float(occlusion.width);
+			const float y = (clip[1] / clip[3] * 0.5f + 0.5f) * float(occlusion.height);
+			minX = std::min(minX, x); maxX = std::max(maxX, x);
+			minY = std::min(minY, y); maxY = std::max(maxY, y);
+			minZ = std::min(minZ, clip[2] / clip[3] * 0.5f + 0.5f);
+		}
+
+		const int tileSize = occlusion_internal::tileSize;
+		const int tileColumns = occlusion.width / tileSize, tileRows = occlusion.height / tileSize;
+		const int tx0 = std::max(0, int(minX) / tileSize), tx1 = std::min(tileColumns - 1, int(maxX) / tileSize);
+		const int ty0 = std::max(0, int(minY) / tileSize), ty1 = std::min(tileRows - 1, int(maxY) / tileSize);
+		for (int ty = ty0; ty <= ty1; ty++)
+		{
+			for (int tx = tx0; tx <= tx1; tx++)
+			{
+				if (occlusion.tileMax[size_t(ty) * tileColumns + tx] >= minZ)
+					return false;
+			}
+		}
+		return tx0 <= tx1 && ty0 <= ty1;
+	}
+
+	/*!
+	\brief Create the grid patch shared by all terrain nodes.
+	*/
+	static void _internalCreateTerrainPatch()
+	{
+		const int n = internalTerrainPatchResolution;
+		std::vector<float> vertices;
+		for (int j = 0; j <= n; j++)
+		{
+			for (int i = 0; i <= n; i++)
+			{
+				vertices.push_back(float(i) / float(n));
+				vertices.push_back(float(j) / float(n));
+			}
+		}
+		std::vector<int> indices;
+		for (int q = 0; q < 4; q++)
+		{
+			const int i0 = (q & 1) * n / 2, j0 = (q >> 1) * n / 2;
+			for (int j = j0; j < j0 + n / 2; j++)
+			{
+				for (int i = i0; i < i0 + n / 2; i++)
+				{
+					const int v0 = j * (n + 1) + i, v1 = v0 + 1, v2 = v0 + n + 1, v3 = v2 + 1;
+					const int quad[6] = { v0, v2, v1, v2, v3, v1 };
+					indices.insert(indices.end(), quad, quad + 6);
+				}
+			}
+		}
+
+		terrain_patch_internal& patch = internalTerrainPatch;
+		patch.quadrantIndexCount = int(indices.size() / 4);
+		glGenVertexArrays(1, &patch.vao);
+		glBindVertexArray(patch.vao);
+		glGenBuffers(1, &patch.vertexBuffer);
+		glBindBuffer(GL_ARRAY_BUFFER, patch.vertexBuffer);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vertices.size(), &vertices.front(), GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 0, (const void*)0);
+		glEnableVertexAttribArray(0);
+		glGenBuffers(1, &patch.indexBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, patch.indexBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(int) * indices.size(), &indices.front(), GL_STATIC_DRAW);
+		glBindVertexArray(0);
+	}
+
+	/*!
+	\brief Update the minimum and maximum heights of the quadtree nodes covering a rectangle of height samples.
+	\param terrain terrain
+	\param x0, y0, x1, y1 inclusive rectangle of height samples
+	*/
+	static void _internalUpdateTerrainBounds(terrain_internal& terrain, int x0, int y0, int x1, int y1)
+	{
+		const int n = internalTerrainPatchResolution;
+		for (int level = 0; level < terrain.levelCount; level++)
+		{
+			const int nodeCount = 1 << (terrain.levelCount - 1 - level);
+			const int cells = n << level;
+			std::vector<float>& minMax = terrain.minMax[level];
+			const int nx0 = std::max(0, (x0 - 1) / cells), nx1 = std::min(nodeCount - 1, x1 / cells);
+			const int ny0 = std::max(0, (y0 - 1) / cells), ny1 = std::min(nodeCount - 1, y1 / cells);
+			for (int ny = ny0; ny <= ny1; ny++)
+			{
+				for (int nx = nx0; nx <= nx1; nx++)
+				{
+					float lo = 1e30f, hi = -1e30f;
+					if (level == 0)
+					{
+						// Nodes share their border samples
+						for (int y = ny * cells; y <= (ny + 1) * cells; y++)
+						{
+							for (int x = nx * cells; x <= (nx + 1) * cells; x++)
+							{
+								const float h = terrain.heights[size_t(y) * terrain.resolution + x];
+								lo = std::min(lo, h);
+								hi = std::max(hi, h);
+							}
+						}
+					}
+					else
+					{
+						const std::vector<float>& children = terrain.minMax[level - 1];
+						const int childCount = 2 * nodeCount;
+						for (int c = 0; c < 4; c++)
+						{
+							const size_t child = size_t(2 * ny + (c >> 1)) * childCount + 2 * nx + (c & 1);
+							lo = std::min(lo, children[2 * child]);
+							hi = std::max(hi, children[2 * child + 1]);
+						}
+					}
+					minMax[2 * (size_t(ny) * nodeCount + nx)] = lo * terrain.heightScale;
+					minMax[2 * (size_t(ny) * nodeCount + nx) + 1] = hi * terrain.heightScale;
+				}
+			}
+		}
+	}
+
+	/*!
+	\brief Returns true if a box intersects a sphere.
+	\param boundsMin, boundsMax box
+	\param center, radius sphere
+	*/
+	static bool _internalBoxIntersectsSphere(const v3f& boundsMin, const v3f& boundsMax, const v3f& center, float radius)
+	{
+		float d2 = 0.0f;
+		for (int k = 0; k < 3; k++)
+		{
+			const float d = std::max(boundsMin.v[k] - center.v[k], std::max(0.0f, center.v[k] - boundsMax.v[k]));
+			d2 += d * d;
+		}
+		return d2 <= radius * radius;
+	}
+
+	/*!
+	\brief Select and draw the quadtree nodes of a terrain (CDLOD): a node is refined where the camera is within the
+	range of the finer level, and quadrants whose child is out of that range are drawn at the level of the node.
+	\param terrain terrain
+	\param frustum frustum planes
+	\param level node level
+	\param nx, ny node coordinates in its level
+	\returns false if the node is out of the range of its level, in which case its parent draws it.
+	*/
+	static bool _internalDrawTerrainNode(terrain_internal& terrain, const float frustum[6][4], int level, int nx, int ny)
+	{
+		const int nodeCount = 1 << (terrain.levelCount - 1 - level);
+		const float nodeSize = terrain.size / float(nodeCount);
+		const float* minMax = &terrain.minMax[level][2 * (size_t(ny) * nodeCount + nx)];
+		const v3f origin = terrain.position - v3f({ terrain.size * 0.5f, 0.0f, terrain.size * 0.5f });
+		const v3f boundsMin = origin + v3f({ nodeSize * float(nx), minMax[0], nodeSize * float(ny) });
+		const v3f boundsMax = origin + v3f({ nodeSize * float(nx + 1), minMax[1], nodeSize * float(ny + 1) });
+		const float range = terrain.lodDistance * float(1 << level);
+		const bool isRoot = level == terrain.levelCount - 1;
+		if (!isRoot && !_internalBoxIntersectsSphere(boundsMin, boundsMax, internalScene.eye, range))
+			return false;
+		if (!_internalBoxInFrustum(frustum, internalIdentityMatrix, boundsMin, boundsMax))
+			return true;
+
+		// Children within the range of the finer level are drawn by themselves
+		bool drawQuadrant[4] = { true, true, true, true };
+		if (level > 0 && _internalBoxIntersectsSphere(boundsMin, boundsMax, internalScene.eye, range * 0.5f))
+		{
+			for (int q = 0; q < 4; q++)
+				drawQuadrant[q] = !_internalDrawTerrainNode(terrain, frustum, level - 1, 2 * nx + (q & 1), 2 * ny + (q >> 1));
+		}
+
+		// Vertices morph to the coarser grid over the last part of the range of this level
+		const GLuint program = internalTerrainProgram;
+		const float morphEnd = isRoot ? 1e30f : range;
+		glUniform4f(glGetUniformLocation(program, "uNode"), boundsMin.x - origin.x, boundsMin.z - origin.z, nodeSize, float(level));
+		glUniform2f(glGetUniformLocation(program, "uMorph"), morphEnd * 0.7f, morphEnd);
+		for (int q = 0; q < 4; q++)
+		{
+			if (!drawQuadrant[q])
+				continue;
+			const size_t offset = sizeof(int) * size_t(q) * internalTerrainPatch.quadrantIndexCount;
+			glDrawElements(GL_TRIANGLES, internalTerrainPatch.quadrantIndexCount, GL_UNSIGNED_INT, (const void*)offset);
+			terrain.trianglesDrawn += internalTerrainPatch.quadrantIndexCount / 3;
+		}
+		terrain.nodesDrawn++;
+		return true;
+	}
+
+	/*!
+	\brief Draw all terrains with the terrain program.
+	\param viewMatrix, projectionMatrix camera matrices
+	\param frustum frustum planes
+	*/
+	static void _internalRenderTerrains(const float viewMatrix[4][4], const float projectionMatrix[4][4], const float frustum[6][4])
+	{
+		if (internalTerrainPatch.vao == 0)
+			return;
+		const GLuint program = internalTerrainProgram;
+		const v3f light = internalNormalize(internalScene.lightDir);
+		glUseProgram(program);
+		glUniformMatrix4fv(glGetUniformLocation(program, "uProjection"), 1, GL_FALSE, &projectionMatrix[0][0]);
+		glUniformMatrix4fv(glGetUniformLocation(program, "uView"), 1, GL_FALSE, &viewMatrix[0][0]);
+		glUniform3f(glGetUniformLocation(program, "uLightDir"), light.x, light.y, light.z);
+		glUniform1i(glGetUniformLocation(program, "uDoLighting"), int(internalScene.doLighting));
+		glUniform3f(glGetUniformLocation(program, "uEye"), internalScene.eye.x, internalScene.eye.y, internalScene.eye.z);
+		glUniform1f(glGetUniformLocation(program, "uGridResolution"), float(internalTerrainPatchResolution));
+		glUniform1i(glGetUniformLocation(program, "uHeightmap"), 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindVertexArray(internalTerrainPatch.vao);
+		for (terrain_internal& terrain : internalTerrains)
+		{
+			terrain.nodesDrawn = terrain.trianglesDrawn = 0;
+			if (terrain.isDeleted)
+				continue;
+			const v3f origin = terrain.position - v3f({ terrain.size * 0.5f, 0.0f, terrain.size * 0.5f });
+			glUniform3f(glGetUniformLocation(program, "uTerrainOrigin"), origin.x, origin.y, origin.z);
+			glUniform3f(glGetUniformLocation(program, "uTerrainSize"), terrain.size, terrain.heightScale, float(terrain.resolution));
+			glBindTexture(GL_TEXTURE_2D, terrain.heightTexture);
+			_internalDrawTerrainNode(terrain, frustum, terrain.levelCount - 1, 0, 0);
+		}
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	/*!
+	\brief Draw signed distance field objects: the back faces of their proxy box are rasterized, and each fragment
+	sphere traces the field from the entry point of the view ray in the box, writing the depth of the hit.
+	\param viewMatrix, projectionMatrix camera matrices
+	\param frustum frustum planes, for culling the proxy boxes
+	\param height height of the render target in pixels, for the pixel footprint of the rays
+	*/
+	static void _internalRenderSdfObjects(const float viewMatrix[4][4], const float projectionMatrix[4][4], const float frustum[6][4], int height)
+	{
+		if (internalSdfBoxVao == 0)
+			return;
+		const GLuint program = internalSdfProgram;
+		const v3f light = internalNormalize(internalScene.lightDir);
+		glUseProgram(program);
+		glUniformMatrix4fv(glGetUniformLocation(program, "uProjection"), 1, GL_FALSE, &projectionMatrix[0][0]);
+		glUniformMatrix4fv(glGetUniformLocation(program, "uView"), 1, GL_FALSE, &viewMatrix[0][0]);
+		glUniform3f(glGetUniformLocation(program, "uLightDir"), light.x, light.y, light.z);
+		glUniform1i(glGetUniformLocation(program, "uDoLighting"), int(internalScene.doLighting));
+		glUniform1i(glGetUniformLocation(program, "uProgram"), 0);
+		glUniform1i(glGetUniformLocation(program, "uVolume"), 1);
+		glEnable(GL_CULL_FACE);
+		glCullFace(GL_FRONT);
+		glBindVertexArray(internalSdfBoxVao);
+		for (const sdf_internal& sdf : internalSdfObjects)
+		{
+			if (sdf.isDeleted || !_internalBoxInFrustum(frustum, sdf.modelMatrix, sdf.boundsMin, sdf.boundsMax))
+				continue;
+
+			// Camera position in object space, and angular size of a pixel
+			float inverse[4][4];
+			_internalInverseAffine(inverse, sdf.modelMatrix);
+			const v3f& e = internalScene.eye;
+			const v3f localEye = { inverse[0][0] * e.x + inverse[1][0] * e.y + inverse[2][0] * e.z + inverse[3][0],
+				inverse[0][1] * e.x + inverse[1][1] * e.y + inverse[2][1] * e.z + inverse[3][1],
+				inverse[0][2] * e.x + inverse[1][2] * e.y + inverse[2][2] * e.z + inverse[3][2] };
+			glUniformMatrix4fv(glGetUniformLocation(program, "uModel"), 1, GL_FALSE, &sdf.modelMatrix[0][0]);
+			glUniform3f(glGetUniformLocation(program, "uLocalEye"), localEye.x, localEye.y, localEye.z);
+			glUniform1f(glGetUniformLocation(program, "uPixelRadius"), 1.0f / (projectionMatrix[1][1] * float(std::max(1, height))));
+			glUniform3f(glGetUniformLocation(program, "uBoundsMin"), sdf.boundsMin.x, sdf.boundsMin.y, sdf.boundsMin.z);
+			glUniform3f(glGetUniformLocation(program, "uBoundsMax"), sdf.boundsMax.x, sdf.boundsMax.y, sdf.boundsMax.z);
+			glUniform3f(glGetUniformLocation(program, "uColor"), sdf.color.x, sdf.color.y, sdf.color.z);
+			glUniform1i(glGetUniformLocation(program, "uInstructionCount"), sdf.volumeTexture != 0 ? 0 : sdf.instructionCount);
+			glUniform1f(glGetUniformLocation(program, "uResolution"), float(sdf.resolution));
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_BUFFER, sdf.programTexture);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_3D, sdf.volumeTexture);
+			glDrawElements(GL_TRIANGLES, 36, GL_UNSIGNED_INT, 0);
+		}
+		glActiveTexture(GL_TEXTURE1);
+		glBindTexture(GL_TEXTURE_3D, 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glCullFace(GL_BACK);
+		glDisable(GL_CULL_FACE);
+	}
+
+	/*!
+	\brief Create the unit cube drawn as the proxy box of signed distance field objects.
+	*/
+	static void _internalCreateSdfBox()
+	{
+		const float corners[24] = { 0, 0, 0, 1, 0, 0, 1, 1, 0, 0, 1, 0, 0, 0, 1, 1, 0, 1, 1, 1, 1, 0, 1, 1 };
+		const int indices[36] = { 0, 2, 1, 0, 3, 2, 4, 5, 6, 4, 6, 7, 0, 1, 5, 0, 5, 4, 2, 3, 7, 2, 7, 6, 1, 2, 6, 1, 6, 5, 0, 4, 7, 0, 7, 3 };
+		glGenVertexArrays(1, &internalSdfBoxVao);
+		glBindVertexArray(internalSdfBoxVao);
+		glGenBuffers(2, internalSdfBoxBuffers);
+		glBindBuffer(GL_ARRAY_BUFFER, internalSdfBoxBuffers[0]);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(corners), corners, GL_STATIC_DRAW);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const void*)0);
+		glEnableVertexAttribArray(0);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, internalSdfBoxBuffers[1]);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+		glBindVertexArray(0);
+	}
+
+	/*!
+	\brief Compile a node of a CSG graph and its operands into a postfix program, and compute a conservative bounding box
+	of the node.
+	\param nodes node graph
+	\param index node to compile
+	\param depth current recursion depth, to reject cycles
+	\param program compiled instructions, four texels of four floats each
+	\param stackSize number of values on the evaluation stack, updated
+	\param maxStackSize maximum size of the evaluation stack, updated
+	\param boundsMin, boundsMax bounds of the node
+	\returns false if the graph is invalid.
+	*/
+	static bool _internalCompileCsg(const std::vector<csgnode>& nodes, int index, int depth, std::vector<float>& program, int& stackSize, int& maxStackSize, v3f& boundsMin, v3f& boundsMax)
+	{
+		if (index < 0 || index >= int(nodes.size()) || depth > int(nodes.size()))
+			return false;
+		const csgnode& node = nodes[index];
+		const int op = int(node.operation);
+		if (node.operation == csg::smoothUnion || node.operation == csg::smoothSubtraction || node.operation == csg::smoothIntersection)
+		{
+			v3f leftMin, leftMax, rightMin, rightMax;
+			if (!_internalCompileCsg(nodes, node.left, depth + 1, program, stackSize, maxStackSize, leftMin, leftMax) ||
+				!_internalCompileCsg(nodes, node.right, depth + 1, program, stackSize, maxStackSize, rightMin, rightMax))
+				return false;
+			stackSize--;
+			const v3f blend = { node.blend, node.blend, node.blend };
+			if (node.operation == csg::smoothUnion)
+			{
+				boundsMin = v3f({ std::min(leftMin.x, rightMin.x), std::min(leftMin.y, rightMin.y), std::min(leftMin.z, rightMin.z) }) - blend;
+				boundsMax = v3f({ std::max(leftMax.x, rightMax.x), std::max(leftMax.y, rightMax.y), std::max(leftMax.z, rightMax.z) }) + blend;
+			}
+			else if (node.operation == csg::smoothSubtraction)
+			{
+				boundsMin = leftMin;
+				boundsMax = leftMax;
+			}
+			else
+			{
+				boundsMin = { std::max(leftMin.x, rightMin.x), std::max(leftMin.y, rightMin.y), std::max(leftMin.z, rightMin.z) };
+				boundsMax = { std::min(leftMax.x, rightMax.x), std::min(leftMax.y, rightMax.y), std::min(leftMax.z, rightMax.z) };
+			}
+			const float instruction[16] = { float(op), node.blend, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0 };
+			program.insert(program.end(), instruction, instruction + 16);
+			return true;
+		}
+
+		v3f extent = node.size;
+		if (node.operation == csg::sphere)
+			extent = { node.size.x, node.size.x, node.size.x };
+		else if (node.operation == csg::torus)
+			extent = { node.size.x + node.size.y, node.size.y, node.size.x + node.size.y };
+		else if (node.operation == csg::cylinder)
+			extent = { node.size.x, node.size.y, node.size.x };
+		boundsMin = node.center - extent;
+		boundsMax = node.center + extent;
+		const float instruction[16] = { float(op), 0, 0, 0, node.center.x, node.center.y, node.center.z, 0,
+			node.size.x, node.size.y, node.size.z, 0, node.color.x, node.color.y, node.color.z, 0 };
+		program.insert(program.end(), instruction, instruction + 16);
+		maxStackSize = std::max(maxStackSize, ++stackSize);
+		return true;
+	}
+
+	/*!
+	\brief Compile the node graph of a signed distance field object and upload it. The root is the last node.
+	\param sdf signed distance field object
+	\param nodes node graph
+	\returns false if the graph is invalid, in which case the object is unchanged.
+	*/
+	static bool _internalUploadCsg(sdf_internal& sdf, const std::vector<csgnode>& nodes)
+	{
+		std::vector<float> program;
+		int stackSize = 0, maxStackSize = 0;
+		v3f boundsMin, boundsMax;
+		if (nodes.empty() || !_internalCompileCsg(nodes, int(nodes.size()) - 1, 0, program, stackSize, maxStackSize, boundsMin, boundsMax))
+		{
+			fprintf(stderr, "Invalid CSG graph: operands must be valid node indices, without cycles\n");
+			return false;
+		}
+		if (maxStackSize > internalMaxSdfStack)
+		{
+			fprintf(stderr, "CSG graph too deep: at most %d operands can be pending\n", internalMaxSdfStack);
+			return false;
+		}
+
+		// Margin so that the surface never touches the proxy box
+		const v3f margin = (boundsMax - boundsMin) * 0.01f + v3f({ 1e-3f, 1e-3f, 1e-3f });
+		sdf.boundsMin = boundsMin - margin;
+		sdf.boundsMax = boundsMax + margin;
+		sdf.instructionCount = int(program.size() / 16);
+		if (sdf.programBuffer == 0)
+		{
+			glGenBuffers(1, &sdf.programBuffer);
+			glGenTextures(1, &sdf.programTexture);
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, sdf.programBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * program.size(), &program.front(), GL_STATIC_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, sdf.programTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, sdf.programBuffer);
+		glBindTexture(GL_TEXTURE_BUFFER, 0);
+		glBindBuffer(GL_TEXTURE_BUFFER, 0);
+		return true;
+	}
+
+	/*!
+	\brief Add the quadric of a plane n.p + d = 0 to a quadric.
+	\param Result quadric
+	\param n plane normal, normalized
+	\param d plane offset
+	\param weight weight of the plane
+	*/
+	static void _internalAddPlaneQuadric(quadric_internal& Result, const v3f& n, float d, double weight)
+	{
+		const double p[4] = { n.x, n.y, n.z, d };
+		int k = 0;
+		for (int i = 0; i < 4; i++)
+		{
+			for (int j = i; j < 4; j++)
+				Result.q[k++] += weight * p[i] * p[j];
+		}
+	}
+
+	/*!
+	\brief Evaluate a quadric at a point: sum of the weighted squared distances to its planes.
+	\param q quadric
+	\param p point
+	*/
+	static double _internalEvaluateQuadric(const quadric_internal& q, const v3f& p)
+	{
+		const double x = p.x, y = p.y, z = p.z;
+		const double* a = q.q;
+		return a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x
+			+ a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y
+			+ a[7] * z * z + 2.0 * a[8] * z + a[9];
+	}
+
+	/*!
+	\brief Returns the error of collapsing vertex u onto vertex v.
+	\param s simplification state
+	\param u, v vertices
+	*/
+	static double _internalCollapseCost(const simplify_internal& s, int u, int v)
+	{
+		quadric_internal q = s.quadrics[u];
+		for (int k = 0; k < 10; k++)
+			q.q[k] += s.quadrics[v].q[k];
+		return _internalEvaluateQuadric(q, s.vertices[v]);
+	}
+
+	/*!
+	\brief Collect the distinct neighbors of a vertex, from its adjacent triangles.
+	\param s simplification state
+	\param v vertex
+	\param neighbors returned neighbors
+	*/
+	static void _internalCollectNeighbors(const simplify_internal& s, int v, std::vector<int>& neighbors)
+	{
+		neighbors.clear();
+		for (int t : s.adjacency[v])
+		{
+			if (s.triangles[3 * t] == -1)
+				continue;
+			for (int j = 0; j < 3; j++)
+			{
+				const int w = s.triangles[3 * t + j];
+				if (w != v && std::find(neighbors.begin(), neighbors.end(), w) == neighbors.end())
+					neighbors.push_back(w);
+			}
+		}
+	}
+
+	/*!
+	\brief Returns true if vertex u can be collapsed onto vertex v: boundaries must be preserved, the mesh must stay
+	manifold (link condition), and no triangle may flip.
+	\param s simplification state
+	\param u, v vertices
+	\param neighborsU, neighborsV temporary storage
+	*/
+	static bool _internalCanCollapse(const simplify_internal& s, int u, int v, std::vector<int>& neighborsU, std::vector<int>& neighborsV)
+	{
+		// Boundary vertices only move along boundary edges
+		int sharedTriangles = 0;
+		for (int t : s.adjacency[u])
+		{
+			const int* tri = &s.triangles[3 * t];
+			if (tri[0] != -1 && (tri[0] == v || tri[1] == v || tri[2] == v))
+				sharedTriangles++;
+		}
+		if (sharedTriangles == 0 || (s.isBoundary[u] && (!s.isBoundary[v] || sharedTriangles != 1)))
+			return false;
+
+		// Link condition: u and v share exactly the neighbors of their common triangles
+		_internalCollectNeighbors(s, u, neighborsU);
+		_internalCollectNeighbors(s, v, neighborsV);
+		int common = 0;
+		for (int a : neighborsU)
+		{
+			if (a != v && std::find(neighborsV.begin(), neighborsV.end(), a) != neighborsV.end())
+				common++;
+		}
+		if (common != sharedTriangles)
+			return false;
+
+		// Triangles moving with u must not flip
+		for (int t : s.adjacency[u])
+		{
+			const int* tri = &s.triangles[3 * t];
+			if (tri[0] == -1 || tri[0] == v || tri[1] == v || tri[2] == v)
+				continue;
+			v3f p[3], q[3];
+			for (int j = 0; j < 3; j++)
+			{
+				p[j] = s.vertices[tri[j]];
+				q[j] = tri[j] == u ? s.vertices[v] : p[j];
+			}
+			if (internalDot(internalCross(p[1] - p[0], p[2] - p[0]), internalCross(q[1] - q[0], q[2] - q[0])) <= 0.0f)
+				return false;
+		}
+		return true;
+	}
+
+	/*!
+	\brief Simplify the triangles of one cell of the spatial partition with half-edge collapses of increasing
+	quadric error, until the triangle budget of the cell or the maximum error is reached. Only unlocked vertices of
+	the cell are modified, so that cells can be processed in parallel.
+	\param s simplification state
+	\param cellTriangles triangles of the cell
+	\param removeCount number of triangles to remove
+	\returns the number of removed triangles.
+	*/
+	static int _internalSimplifyCell(simplify_internal& s, const std::vector<int>& cellTriangles, int removeCount)
+	{
+		struct candidate
+		{
+			double cost;
+			int u, v;
+			unsigned int stampU, stampV;
+			bool operator<(const candidate& other) const { return cost > other.cost; }
+		};
+		std::vector<candidate> heap;
+		auto push = [&](int a, int b)
+		{
+			if (s.isLocked[a] || s.isLocked[b] || s.isRemoved[a] || s.isRemoved[b])
+				return false;
+			const double costAB = _internalCollapseCost(s, a, b), costBA = _internalCollapseCost(s, b, a);
+			const int u = costAB <= costBA ? a : b, v = costAB <= costBA ? b : a;
+			heap.push_back({ std::min(costAB, costBA), u, v, s.stamps[u], s.stamps[v] });
+			return true;
+		};
+		for (int t : cellTriangles)
+		{
+			for (int j = 0; j < 3; j++)
+			{
+				const int a = s.triangles[3 * t + j], b = s.triangles[3 * t + (j + 1) % 3];
+				if (a < b)
+					push(a, b);
+			}
+		}
+		std::make_heap(heap.begin(), heap.end());
+
+		int removed = 0;
+		std::vector<int> neighborsU, neighborsV;
+		while (removed < removeCount && !heap.empty())
+		{
+			std::pop_heap(heap.begin(), heap.end());
+			const candidate c = heap.back();
+			heap.pop_back();
+			if (c.cost > double(s.maxError2))
+				break;
+			if (s.isRemoved[c.u] || s.isRemoved[c.v])
+				continue;
+
+			// Quadrics only grow, so an outdated candidate is evaluated again when it reaches the top of the heap
+			if (s.stamps[c.u] != c.stampU || s.stamps[c.v] != c.stampV)
+			{
+				if (push(c.u, c.v))
+					std::push_heap(heap.begin(), heap.end());
+				continue;
+			}
+			if (!_internalCanCollapse(s, c.u, c.v, neighborsU, neighborsV))
+				continue;
+
+			// Collapse u onto v: triangles sharing the edge are removed, the others move to v
+			const int u = c.u, v = c.v;
+			for (int t : s.adjacency[u])
+			{
+				int* tri = &s.triangles[3 * t];
+				if (tri[0] == -1)
+					continue;
+				if (tri[0] == v || tri[1] == v || tri[2] == v)
+				{
+					tri[0] = -1;
+					removed++;
+					continue;
+				}
+				for (int j = 0; j < 3; j++)
+				{
+					if (tri[j] == u)
+						tri[j] = v;
+				}
+				s.adjacency[v].push_back(t);
+			}
+			s.adjacency[u].clear();
+			for (int k = 0; k < 10; k++)
+				s.quadrics[v].q[k] += s.quadrics[u].q[k];
+			s.isRemoved[u] = 1;
+			s.stamps[v]++;
+
+			// Compact the adjacency of v, and queue the edges v inherited from u
+			std::vector<int>& adjacency = s.adjacency[v];
+			adjacency.erase(std::remove_if(adjacency.begin(), adjacency.end(), [&s](int t) { return s.triangles[3 * t] == -1; }), adjacency.end());
+			for (int w : neighborsU)
+			{
+				if (w != v && s.vertexCell[w] == s.vertexCell[v] && std::find(neighborsV.begin(), neighborsV.end(), w) == neighborsV.end() && push(v, w))
+					std::push_heap(heap.begin(), heap.end());
+			}
+		}
+		return removed;
+	}
+
+	/*!
+	\brief Loading thread of out-of-core objects: calls the source of each requested object, without holding the lock.
+	*/
+	static void _internalResidencyLoader()
+	{
+		residency_internal& residency = internalResidency;
+		std::unique_lock<std::mutex> lock(residency.mutex);
+		while (true)
+		{
+			residency.condition.wait(lock, [&residency]() { return residency.quit || !residency.requests.empty(); });
+			if (residency.quit)
+				return;
+			streamed_internal* streamed = residency.objects[residency.requests.front()].get();
+			residency.requests.pop_front();
+			std::function<object()> source = streamed->source;
+			lock.unlock();
+
+			object data = source();
+
+			lock.lock();
+			if (streamed->state == residency_state::loading)
+			{
+				streamed->data = std::move(data);
+				streamed->state = residency_state::loaded;
+			}
+		}
+	}
+
+	/*!
+	\brief Queue an out-of-core object for loading, if it is not resident or already requested.
+	\param streamId residency record index
+	*/
+	static void _internalRequestResidency(int streamId)
+	{
+		residency_internal& residency = internalResidency;
+		{
+			std::lock_guard<std::mutex> lock(residency.mutex);
+			streamed_internal& streamed = *residency.objects[streamId];
+			if (streamed.state != residency_state::unloaded)
+				return;
+			streamed.state = residency_state::loading;
+			residency.requests.push_back(streamId);
+		}
+		residency.condition.notify_one();
+	}
+
+	/*!
+	\brief Free the GPU buffers of an object and everything derived from its geometry: the normal adjacency buffer,
+	morph targets, CPU copies of the topology and meshlets. Transform, hierarchy, bounds and visibility are kept.
+	\param obj internal object
+	*/
+	static void _internalReleaseGeometry(object_internal& obj)
+	{
+		glDeleteBuffers(1, &obj.buffers);
+		glDeleteBuffers(1, &obj.triangleBuffer);
+		if (obj.scalarBuffer != 0)
+			glDeleteBuffers(1, &obj.scalarBuffer);
+		if (obj.adjacencyBuffer != 0)
+			glDeleteBuffers(1, &obj.adjacencyBuffer);
+		if (obj.morphBuffer != 0)
+		{
+			glDeleteTextures(1, &obj.morphTexture);
+			glDeleteBuffers(1, &obj.morphBuffer);
+		}
+		glDeleteVertexArrays(1, &obj.vao);
+		obj.vao = obj.buffers = obj.triangleBuffer = obj.scalarBuffer = obj.adjacencyBuffer = 0;
+		obj.morphBuffer = obj.morphTexture = 0;
+		obj.morphCount = 0;
+		obj.morphActiveCount = 0;
+		obj.cpuAdjacency.clear();
+		obj.cpuTriangles.clear();
+		obj.meshlets.clear();
+	}
+
+	/*!
+	\brief Free the GPU buffers of a resident out-of-core object, keeping its transform and bounds. The residency lock
+	must be held.
+	\param streamed residency record
+	*/
+	static void _internalEvict(streamed_internal& streamed)
+	{
+		_internalReleaseGeometry(internalObjects[streamed.objectId]);
+		internalResidency.residentBytes -= streamed.bytes;
+		internalResidency.evictions++;
+		internalScene.sceneVersion++;
+		streamed.state = residency_state::unloaded;
+	}
+
+	/*!
+	\brief Upload loaded out-of-core objects, at most a fixed number of bytes per frame, evicting the least recently
+	drawn objects to stay under the memory budget. Objects drawn in the last frame are never evicted.
+	*/
+	static void _internalUpdateResidency()
+	{
+		residency_internal& residency = internalResidency;
+		if (residency.objects.empty())
+			return;
+		std::lock_guard<std::mutex> lock(residency.mutex);
+
+		// Least recently used resident objects first
+		std::vector<streamed_internal*> candidates;
+		for (auto& streamed : residency.objects)
+		{
+			if (streamed->state == residency_state::resident && streamed->lastUsedFrame < internalScene.frameIndex - 1)
+				candidates.push_back(streamed.get());
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const streamed_internal* a, const streamed_internal* b) { return a->lastUsedFrame < b->lastUsedFrame; });
+		size_t nextCandidate = 0;
+		while (residency.residentBytes > residency.budget && nextCandidate < candidates.size())
+			_internalEvict(*candidates[nextCandidate++]);
+
+		size_t uploadedBytes = 0;
+		for (auto& streamedPtr : residency.objects)
+		{
+			streamed_internal& streamed = *streamedPtr;
+			if (streamed.state != residency_state::loaded)
+				continue;
+			const object& data = streamed.data;
+			const size_t bytes = sizeof(v3f) * 3 * data.vertices.size() + sizeof(int) * data.triangles.size() + sizeof(float) * data.scalars.size();
+			if (uploadedBytes > 0 && uploadedBytes + bytes > residency.uploadBytesPerFrame)
+				break;
+
+			// Make room, or wait for objects to become unused
+			while (residency.residentBytes + bytes > residency.budget && nextCandidate < candidates.size())
+				_internalEvict(*candidates[nextCandidate++]);
+			if (residency.residentBytes + bytes > residency.budget && residency.residentBytes > 0)
+				break;
+
+			// Keep the transform, hierarchy and visibility of the existing object
+			object_internal created = _internalCreateObject(data);
+			object_internal& obj = internalObjects[streamed.objectId];
+			obj.vao = created.vao;
+			obj.buffers = created.buffers;
+			obj.triangleBuffer = created.triangleBuffer;
+			obj.scalarBuffer = created.scalarBuffer;
+			obj.vertexCount = created.vertexCount;
+			obj.triangleCount = created.triangleCount;
+			obj.scalarRange[0] = created.scalarRange[0];
+			obj.scalarRange[1] = created.scalarRange[1];
+			streamed.data = object();
+			streamed.bytes = bytes;
+			streamed.state = residency_state::resident;
+			residency.residentBytes += bytes;
+			uploadedBytes += bytes;
+			internalScene.sceneVersion++;
+		}
+	}
+
+	/*!
+	\brief Create the unit box drawn in place of out-of-core objects that are not resident.
+	*/
+	static void _internalCreatePlaceholder()
+	{
+		object box;
+		for (int axis = 0; axis < 3; axis++)
+		{
+			for (int side = 0; side < 2; side++)
+			{
+				v3f n = { 0, 0, 0 };
+				n[axis] = side == 0 ? -1.0f : 1.0f;
+				const int u = (axis + 1) % 3, v = (axis + 2) % 3;
+				const int base = int(box.vertices.size());
+				for (int k = 0; k < 4; k++)
+				{
+					v3f p = n * 0.5f;
+					p[u] = (k == 1 || k == 2) ? 0.5f : -0.5f;
+					p[v] = (k >= 2) ? 0.5f : -0.5f;
+					box.vertices.push_back(p);
+					box.normals.push_back(n);
+					box.colors.push_back({ 0.7f, 0.7f, 0.7f });
+				}
+				const int order[6] = { 0, 1, 2, 0, 2, 3 };
+				for (int k = 0; k < 6; k++)
+					box.triangles.push_back(base + order[k]);
+			}
+		}
+		internalResidency.placeholder = _internalCreateObject(box);
+	}
+
+	/*!
+	\brief Stop the loading thread of out-of-core objects.
+	*/
+	static void _internalStopResidency()
+	{
+		{
+			std::lock_guard<std::mutex> lock(internalResidency.mutex);
+			internalResidency.quit = true;
+		}
+		internalResidency.condition.notify_one();
+		if (internalResidency.thread.joinable())
+			internalResidency.thread.join();
+	}
+
+	/*!
+	\brief Build a bounding volume hierarchy over triangles, splitting nodes at the median of the triangle centroids
+	along their longest axis.
+	\param triangles three corners per triangle
+	\param Result hierarchy, with its triangles reordered
+	*/
+	static void _internalBuildBvh(const std::vector<v3f>& triangles, bvh_internal& Result)
+	{
+		const int triangleCount = int(triangles.size() / 3);
+		std::vector<int> order(triangleCount);
+		std::vector<v3f> centroids(triangleCount);
+		for (int t = 0; t < triangleCount; t++)
+		{
+			order[t] = t;
+			centroids[t] = (triangles[3 * t] + triangles[3 * t + 1] + triangles[3 * t + 2]) / 3.0f;
+		}
+
+		Result.nodes.assign(1, bvh_node_internal());
+		Result.nodes[0].count = triangleCount;
+		std::vector<int> stack(1, 0);
+		while (!stack.empty())
+		{
+			const int n = stack.back();
+			stack.pop_back();
+			const int first = Result.nodes[n].first, count = Result.nodes[n].count;
+			v3f boundsMin = { 1e30f, 1e30f, 1e30f }, boundsMax = { -1e30f, -1e30f, -1e30f };
+			v3f centerMin = boundsMin, centerMax = boundsMax;
+			for (int i = first; i < first + count; i++)
+			{
+				for (int k = 0; k < 3; k++)
+				{
+					for (int j = 0; j < 3; j++)
+					{
+						boundsMin.v[k] = std::min(boundsMin.v[k], triangles[3 * order[i] + j].v[k]);
+						boundsMax.v[k] = std::max(boundsMax.v[k], triangles[3 * order[i] + j].v[k]);
+					}
+					centerMin.v[k] = std::min(centerMin.v[k], centroids[order[i]].v[k]);
+					centerMax.v[k] = std::max(centerMax.v[k], centroids[order[i]].v[k]);
+				}
+			}
+			Result.nodes[n].boundsMin = boundsMin;
+			Result.nodes[n].boundsMax = boundsMax;
+			if (count <= 4)
+				continue;
+
+			const v3f extent = centerMax - centerMin;
+			const int axis = extent.x > extent.y ? (extent.x > extent.z ? 0 : 2) : (extent.y > extent.z ? 1 : 2);
+			const int middle = first + count / 2;
+			std::nth_element(order.begin() + first, order.begin() + middle, order.begin() + first + count,
+				[&centroids, axis](int a, int b) { return centroids[a].v[axis] < centroids[b].v[axis]; });
+
+			const int child = int(Result.nodes.size());
+			Result.nodes.resize(child + 2);
+			Result.nodes[child].first = first;
+			Result.nodes[child].count = middle - first;
+			Result.nodes[child + 1].first = middle;
+			Result.nodes[child + 1].count = first + count - middle;
+			Result.nodes[n].first = child;
+			Result.nodes[n].count = 0;
+			stack.push_back(child);
+			stack.push_back(child + 1);
+		}
+
+		Result.triangles.resize(triangles.size());
+		for (int i = 0; i < triangleCount; i++)
+		{
+			for (int j = 0; j < 3; j++)
+				Result.triangles[3 * i + j] = triangles[3 * order[i] + j];
+		}
+	}
+
+	/*!
+	\brief Returns true if a ray segment hits a triangle of a bounding volume hierarchy.
+	\param bvh hierarchy
+	\param origin ray origin
+	\param direction ray direction, normalized
+	\param maxDistance length of the segment
+	*/
+	static bool _internalBvhOccluded(const bvh_internal& bvh, const v3f& origin, const v3f& direction, float maxDistance)
+	{
+		if (bvh.nodes.empty() || bvh.triangles.empty())
+			return false;
+		const v3f inverse = { 1.0f / direction.x, 1.0f / direction.y, 1.0f / direction.z };
+		int stack[64];
+		int stackSize = 0;
+		stack[stackSize++] = 0;
+		while (stackSize > 0)
+		{
+			const bvh_node_internal& node = bvh.nodes[stack[--stackSize]];
+
+			// Slab test
+			float tMin = 0.0f, tMax = maxDistance;
+			for (int k = 0; k < 3; k++)
+			{
+				float t0 = (node.boundsMin.v[k] - origin.v[k]) * inverse.v[k];
+				float t1 = (node.boundsMax.v[k] - origin.v[k]) * inverse.v[k];
+				if (t0 > t1)
+					std::swap(t0, t1);
+				tMin = std::max(tMin, t0);
+				tMax = std::min(tMax, t1);
+			}
+			if (tMin > tMax)
+				continue;
+
+			if (node.count == 0)
+			{
+				stack[stackSize++] = node.first;
+				stack[stackSize++] = node.first + 1;
+				continue;
+			}
+
+			// Moller-Trumbore intersection with the triangles of the leaf
+			for (int t = node.first; t < node.first + node.count; t++)
+			{
+				const v3f& a = bvh.triangles[3 * t];
+				const v3f e1 = bvh.triangles[3 * t + 1] - a, e2 = bvh.triangles[3 * t + 2] - a;
+				const v3f p = internalCross(direction, e2);
+				const float det = internalDot(e1, p);
+				if (std::abs(det) < 1e-12f)
+					continue;
+				const float invDet = 1.0f / det;
+				const v3f s = origin - a;
+				const float u = internalDot(s, p) * invDet;
+				if (u < 0.0f || u > 1.0f)
+					continue;
+				const v3f q = internalCross(s, e1);
+				const float v = internalDot(direction, q) * invDet;
+				if (v < 0.0f || u + v > 1.0f)
+					continue;
+				const float distance = internalDot(e2, q) * invDet;
+				if (distance > 0.0f && distance < maxDistance)
+					return true;
+			}
+		}
+		return false;
+	}
+
+	/*!
+	\brief Baking thread of ambient occlusion: casts cosine-distributed rays over the hemisphere of each vertex, a few
+	rays per vertex and per pass on all cores, and publishes the accumulated visibility after each pass.
+	\param bake bake record
+	\param points, normals world space vertices and normals of the baked object
+	\param sceneTriangles world space triangles of the scene, three corners per triangle
+	\param radius maximum distance of occluders
+	*/
+	static void _internalBakeAmbientOcclusion(bake_internal& bake, const std::vector<v3f>& points, const std::vector<v3f>& normals, const std::vector<v3f>& sceneTriangles, float radius)
+	{
+		bvh_internal bvh;
+		_internalBuildBvh(sceneTriangles, bvh);
+
+		const int vertexCount = int(points.size());
+		const int raysPerPass = 8;
+		const float offset = 1e-4f * radius;
+		std::vector<float> visibility(vertexCount, 0.0f);
+		for (int done = 0; done < bake.rays && !bake.cancel; )
+		{
+			const int count = std::min(raysPerPass, bake.rays - done);
+			_internalParallelFor(vertexCount, [&](int begin, int end)
+				{
+					for (int v = begin; v < end && !bake.cancel; v++)
+					{
+						// Tangent frame of the normal
+						const v3f& n = normals[v];
+						const float sign = n.z >= 0.0f ? 1.0f : -1.0f;
+						const float a = -1.0f / (sign + n.z), b = n.x * n.y * a;
+						const v3f tangent = { 1.0f + sign * n.x * n.x * a, sign * b, -sign * n.x };
+						const v3f bitangent = { b, sign + n.y * n.y * a, -n.y };
+
+						unsigned int seed = (unsigned int)(v) * 9781u + (unsigned int)(done) * 6271u + 1u;
+						for (int r = 0; r < count; r++)
+						{
+							float u[2];
+							for (int k = 0; k < 2; k++)
+							{
+								seed ^= seed << 13;
+								seed ^= seed >> 17;
+								seed ^= seed << 5;
+								u[k] = float(seed >> 8) / 16777216.0f;
+							}
+							const float phi = 6.28318530718f * u[0];
+							const float sinTheta = std::sqrt(u[1]), cosTheta = std::sqrt(1.0f - u[1]);
+							const v3f direction = tangent * (std::cos(phi) * sinTheta) + bitangent * (std::sin(phi) * sinTheta) + n * cosTheta;
+							if (!_internalBvhOccluded(bvh, points[v] + n * offset, direction, radius))
+								visibility[v] += 1.0f;
+						}
+					}
+				}, 256);
+			done += count;
+
+			std::lock_guard<std::mutex> lock(bake.mutex);
+			bake.visibility = visibility;
+			bake.rayCount = done;
+			bake.hasNewResult = true;
+		}
+		bake.isDone = true;
+	}
+
+	/*!
+	\brief Stop the ambient occlusion bake of an object, if any.
+	\param id object id
+	*/
+	static void _internalStopBake(int id)
+	{
+		for (size_t i = 0; i < internalBakes.size(); i++)
+		{
+			if (internalBakes[i]->objectId == id)
+			{
+				internalBakes[i]->cancel = true;
+				internalBakes[i]->thread.join();
+				internalBakes.erase(internalBakes.begin() + i);
+				return;
+			}
+		}
+	}
+
+	/*!
+	\brief Upload the latest results of ambient occlusion bakes as vertex colors, and remove finished bakes.
+	*/
+	static void _internalUpdateBakes()
+	{
+		for (size_t i = 0; i < internalBakes.size();)
+		{
+			bake_internal& bake = *internalBakes[i];
+			const bool isDone = bake.isDone;
+			std::vector<v3f> colors;
+			{
+				std::lock_guard<std::mutex> lock(bake.mutex);
+				if (bake.hasNewResult)
+				{
+					colors.resize(bake.baseColors.size());
+					for (size_t v = 0; v < colors.size(); v++)
+						colors[v] = bake.baseColors[v] * (bake.visibility[v] / float(bake.rayCount));
+					bake.hasNewResult = false;
+				}
+			}
+			if (!colors.empty())
+				updateObject(bake.objectId, colors);
+			if (isDone)
+			{
+				bake.thread.join();
+				internalBakes.erase(internalBakes.begin() + i);
+			}
+			else
+				i++;
+		}
+	}
+
+	/*!
+	\brief Flag the chunk containing a voxel as dirty, and its neighbors when the voxel lies on a chunk border, since
+	the faces between two chunks depend on both.
+	\param volume voxel volume
+	\param x, y, z voxel coordinates
+	*/
+	static void _internalMarkVoxelDirty(voxel_volume_internal& volume, int x, int y, int z)
+	{
+		auto mark = [&volume](const int c[3])
+		{
+			volume.isDirty[(size_t(c[2]) * volume.chunkCount[1] + c[1]) * volume.chunkCount[0] + c[0]] = 1;
+		};
+		const int p[3] = { x, y, z };
+		const int c[3] = { x / internalVoxelChunkSize, y / internalVoxelChunkSize, z / internalVoxelChunkSize };
+		mark(c);
+		for (int k = 0; k < 3; k++)
+		{
+			const int local = p[k] % internalVoxelChunkSize;
+			int n[3] = { c[0], c[1], c[2] };
+			if (local == 0 && c[k] > 0)
+			{
+				n[k] = c[k] - 1;
+				mark(n);
+			}
+			if (local == internalVoxelChunkSize - 1 && c[k] + 1 < volume.chunkCount[k])
+			{
+				n[k] = c[k] + 1;
+				mark(n);
+			}
+		}
+		volume.hasDirtyChunks = true;
+	}
+
+	/*!
+	\brief Mesh a chunk of a voxel volume with greedy meshing: for each face direction and slice, visible faces are
+	gathered in a mask, which is covered by maximal rectangles of the same material, each emitted as a single quad.
+	\param volume voxel volume
+	\param chunk chunk coordinates
+	\param Result mesh, in volume space
+	*/
+	static void _internalMeshVoxelChunk(const voxel_volume_internal& volume, const int chunk[3], object& Result)
+	{
+		const int n = internalVoxelChunkSize;
+		int origin[3], extent[3];
+		for (int k = 0; k < 3; k++)
+		{
+			origin[k] = chunk[k] * n;
+			extent[k] = std::min(n, volume.size[k] - origin[k]);
+		}
+		auto voxel = [&volume](const int p[3]) -> int
+		{
+			if (p[0] < 0 || p[1] < 0 || p[2] < 0 || p[0] >= volume.size[0] || p[1] >= volume.size[1] || p[2] >= volume.size[2])
+				return 0;
+			return volume.voxels[(size_t(p[2]) * volume.size[1] + p[1]) * volume.size[0] + p[0]];
+		};
+
+		std::vector<int> mask(n * n);
+		for (int d = 0; d < 3; d++)
+		{
+			const int u = (d + 1) % 3, v = (d + 2) % 3;
+			for (int sign = -1; sign <= 1; sign += 2)
+			{
+				v3f normal = { 0, 0, 0 };
+				normal.v[d] = float(sign);
+				for (int s = 0; s < extent[d]; s++)
+				{
+					// Faces of this slice that are not covered by a neighbor voxel
+					for (int j = 0; j < extent[v]; j++)
+					{
+						for (int i = 0; i < extent[u]; i++)
+						{
+							int p[3];
+							p[d] = origin[d] + s;
+							p[u] = origin[u] + i;
+							p[v] = origin[v] + j;
+							const int material = voxel(p);
+							p[d] += sign;
+							mask[j * n + i] = material != 0 && voxel(p) == 0 ? material : 0;
+						}
+					}
+
+					// Maximal rectangles of the same material
+					for (int j = 0; j < extent[v]; j++)
+					{
+						for (int i = 0; i < extent[u];)
+						{
+							const int material = mask[j * n + i];
+							if (material == 0)
+							{
+								i++;
+								continue;
+							}
+							int w = 1;
+							while (i + w < extent[u] && mask[j * n + i + w] == material)
+								w++;
+							int h = 1;
+							for (bool isFull = true; j + h < extent[v] && isFull; )
+							{
+								for (int k = 0; k < w && isFull; k++)
+									isFull = mask[(j + h) * n + i + k] == material;
+								if (isFull)
+									h++;
+							}
+							for (int l = 0; l < h; l++)
+							{
+								for (int k = 0; k < w; k++)
+									mask[(j + l) * n + i + k] = 0;
+							}
+
+							// Quad, counter-clockwise when seen from the side of its normal
+							v3f corner = { 0, 0, 0 }, du = { 0, 0, 0 }, dv = { 0, 0, 0 };
+							corner.v[d] = float(origin[d] + s + (sign > 0 ? 1 : 0));
+							corner.v[u] = float(origin[u] + i);
+							corner.v[v] = float(origin[v] + j);
+							du.v[u] = float(w);
+							dv.v[v] = float(h);
+							const int base = int(Result.vertices.size());
+							const v3f quad[4] = { corner, corner + du, corner + du + dv, corner + dv };
+							for (int k = 0; k < 4; k++)
+							{
+								Result.vertices.push_back(quad[k] * volume.voxelSize);
+								Result.normals.push_back(normal);
+								Result.colors.push_back(volume.palette[material]);
+							}
+							if (sign > 0)
+								Result.triangles.insert(Result.triangles.end(), { base, base + 1, base + 2, base, base + 2, base + 3 });
+							else
+								Result.triangles.insert(Result.triangles.end(), { base, base + 2, base + 1, base, base + 3, base + 2 });
+							i += w;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	/*!
+	\brief Replace the geometry of an object with a mesh of a different size, keeping its id, transform, parent and
+	visibility. Everything tied to the previous geometry is dropped: scalars, morph targets, normal adjacency,
+	meshlets, occluder and tessellation.
+	\param id object id
+	\param mesh new geometry
+	*/
+	static void _internalReplaceObjectGeometry(int id, const object& mesh)
+	{
+		object_internal& obj = internalObjects[id];
+		object_internal created = _internalCreateObject(mesh);
+		_internalReleaseGeometry(obj);
+		obj.occluder.reset();
+		if (obj.tessellation)
+		{
+			glDeleteTextures(1, &obj.tessellation->displacementTexture);
+			obj.tessellation.reset();
+		}
+		obj.vao = created.vao;
+		obj.buffers = created.buffers;
+		obj.triangleBuffer = created.triangleBuffer;
+		obj.scalarBuffer = created.scalarBuffer;
+		obj.scalarRange[0] = created.scalarRange[0];
+		obj.scalarRange[1] = created.scalarRange[1];
+		obj.vertexCount = created.vertexCount;
+		obj.triangleCount = created.triangleCount;
+		obj.boundsMin = created.boundsMin;
+		obj.boundsMax = created.boundsMax;
+		obj.hasBounds = created.hasBounds;
+	}
+
+	/*!
+	\brief Returns true if an object is still a chunk or the group of a voxel volume. The user may have removed it,
+	and its slot may have been reused by another object since.
+	\param objectId object id, -1 if none
+	\param volumeId voxel volume id
+	*/
+	static bool _internalIsVoxelObject(int objectId, int volumeId)
+	{
+		return objectId >= 0 && objectId < int(internalObjects.size()) && !internalObjects[objectId].isDeleted &&
+			internalObjects[objectId].voxelVolume == volumeId;
+	}
+
+	/*!
+	\brief Mesh the dirty chunks of all voxel volumes in parallel, then upload them. Only the edited chunks and their
+	neighbors are processed.
+	*/
+	static void _internalUpdateVoxelVolumes()
+	{
+		for (int v = 0; v < int(internalVoxelVolumes.size()); v++)
+		{
+			voxel_volume_internal& volume = internalVoxelVolumes[v];
+			if (volume.isDeleted || !volume.hasDirtyChunks)
+				continue;
+			auto start = std::chrono::high_resolution_clock::now();
+			std::vector<int> dirty;
+			for (int c = 0; c < int(volume.isDirty.size()); c++)
+			{
+				if (volume.isDirty[c])
+					dirty.push_back(c);
+				volume.isDirty[c] = 0;
+			}
+			volume.hasDirtyChunks = false;
+
+			std::vector<object> meshes(dirty.size());
+			_internalParallelFor(int(dirty.size()), [&](int begin, int end)
+				{
+					for (int i = begin; i < end; i++)
+					{
+						const int c = dirty[i];
+						const int chunk[3] = { c % volume.chunkCount[0], (c / volume.chunkCount[0]) % volume.chunkCount[1], c / (volume.chunkCount[0] * volume.chunkCount[1]) };
+						_internalMeshVoxelChunk(volume, chunk, meshes[i]);
+					}
+				}, 1);
+
+			// Recreate the group if it was removed, and reattach the remaining chunks, which became roots
+			if (!_internalIsVoxelObject(volume.groupId, v))
+			{
+				volume.groupId = addGroup(volume.position);
+				internalObjects[volume.groupId].voxelVolume = v;
+				for (int objectId : volume.chunkObjects)
+				{
+					if (!_internalIsVoxelObject(objectId, v))
+						continue;
+					_internalComputeModelMatrix(internalObjects[objectId].localMatrix, { 0, 0, 0 }, { 1, 1, 1 });
+					setParent(objectId, volume.groupId);
+				}
+			}
+
+			for (size_t i = 0; i < dirty.size(); i++)
+			{
+				int& objectId = volume.chunkObjects[dirty[i]];
+				if (objectId != -1 && !_internalIsVoxelObject(objectId, v))
+					objectId = -1;
+				if (meshes[i].triangles.empty())
+				{
+					if (objectId != -1)
+						setVisible(objectId, false);
+					continue;
+				}
+				if (objectId == -1)
+				{
+					objectId = addObject(meshes[i]);
+					internalObjects[objectId].voxelVolume = v;
+					setParent(objectId, volume.groupId);
+				}
+				else
+				{
+					_internalReplaceObjectGeometry(objectId, meshes[i]);
+					setVisible(objectId, true);
+				}
+			}
+			volume.remeshedChunks = int(dirty.size());
+			volume.remeshTimeMs = std::chrono::duration<float, std::milli>(std::chrono::high_resolution_clock::now() - start).count();
+			internalScene.sceneVersion++;
+		}
+	}
+
+	/*!
+	\brief Rebuild the list of objects to draw from their visibility flags, layers and the visible layer mask.
+	Objects are hidden along with any of their ancestors. Hidden objects keep their buffers, and are only skipped here.
+	*/
+	static void _internalRebuildDrawList()
+	{
+		internalDrawList.clear();
+		for (int i = 0; i < int(internalObjects.size()); i++)
+		{
+			const object_internal& obj = internalObjects[i];
+			if (obj.isDeleted || (obj.vao == 0 && obj.streamId == -1 && obj.chunks.empty()) || (obj.layers & internalScene.visibleLayers) == 0)
+				continue;
+			bool isVisible = true;
+			for (int p = i; p >= 0 && isVisible; p = internalObjects[p].parent)
+				isVisible = internalObjects[p].isVisible;
+			if (isVisible)
+				internalDrawList.push_back(i);
+		}
+		internalDrawListDirty = false;
+	}
+
+	/*!
+	\brief Upload new vertex, normal, color and scalar data to the buffers of an object or of a chunk.
+	\param obj internal object or chunk
+	\param newObj new data, of the same size as the buffers
+	*/
+	static void _internalUploadGeometry(object_internal& obj, const object& newObj)
+	{
+		glBindVertexArray(obj.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, obj.buffers);
+		size_t size = 0;
+		size_t offset = 0;
+		size = sizeof(v3f) * newObj.vertices.size();
+		glBufferSubData(GL_ARRAY_BUFFER, offset, size, &newObj.vertices.front());
+		offset = offset + size;
+		size = sizeof(v3f) * newObj.normals.size();
+		glBufferSubData(GL_ARRAY_BUFFER, offset, size, &newObj.normals.front());
+		if (newObj.colors.size() != 0)
+		{
+			offset = offset + size;
+			size = sizeof(v3f) * newObj.colors.size();
+			glBufferSubData(GL_ARRAY_BUFFER, offset, size, &newObj.colors.front());
+		}
+		if (newObj.scalars.size() != 0)
+			_internalUploadScalars(obj, newObj.scalars);
+		_internalComputeBounds(newObj.vertices, obj.boundsMin, obj.boundsMax);
+	}
+
+	/*
+	\brief Update an already created object with new vertice/normal/color data.
+	\param id object index
+	\param newObj new data for the object.
+	*/
+	static void _internalUpdateObject(int id, const object& newObj)
+	{
+		object_internal& obj = internalObjects[id];
+
+		// Model matrix
+		_internalSetLocalTransform(id, newObj.position, newObj.scale);
+		if (obj.chunks.empty())
+		{
+			_internalUploadGeometry(obj, newObj);
+			return;
+		}
+
+		// Split objects: the attributes of each chunk are gathered from the whole object
+		object chunkData;
+		for (object_internal& chunk : obj.chunks)
+		{
+			_internalGatherChunk(chunk, newObj.vertices, chunkData.vertices);
+			_internalGatherChunk(chunk, newObj.normals, chunkData.normals);
+			if (!newObj.colors.empty())
+				_internalGatherChunk(chunk, newObj.colors, chunkData.colors);
+			if (!newObj.scalars.empty())
+				_internalGatherChunk(chunk, newObj.scalars, chunkData.scalars);
+			_internalUploadGeometry(chunk, chunkData);
+		}
+		if (!newObj.scalars.empty())
+			_internalScalarRange(newObj.scalars, obj.scalarRange);
+		_internalComputeChunkBounds(obj);
+	}
+
+	/*
+	\brief Update an already created object with new color data.
+	\param id object index
+	\param newColors new color data for the object.
+	*/
+	static void _internalUpdateObject(int id, const std::vector<v3f>& newColors)
+	{
+		object_internal& obj = internalObjects[id];
+		if (!obj.chunks.empty())
+		{
+			std::vector<v3f> chunkColors;
+			for (object_internal& chunk : obj.chunks)
+			{
+				_internalGatherChunk(chunk, newColors, chunkColors);
+				glBindVertexArray(chunk.vao);
+				glBindBuffer(GL_ARRAY_BUFFER, chunk.buffers);
+				glBufferSubData(GL_ARRAY_BUFFER, 2 * sizeof(v3f) * chunkColors.size(), sizeof(v3f) * chunkColors.size(), &chunkColors.front());
+			}
+			return;
+		}
+		glBindVertexArray(obj.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, obj.buffers);
+		size_t size = 0;
+		size_t offset = 0;
+		size = sizeof(v3f) * newColors.size();
+		offset = offset + 2 * size; // offset = vertexCount + normalCount (and vertexCount == colorCount)
+		glBufferSubData(GL_ARRAY_BUFFER, offset, size, &newColors.front());
+	}
+
+	/*!
+	\brief Recompute the normals of an object on the GPU with the normal compute shader. The vertex-face adjacency
+	buffer is built on the first call.
+	\param obj internal object
+	\param buffer vertex buffer storing vertexCount positions followed by vertexCount normals, which are overwritten.
+	*/
+	static void _internalDispatchNormals(object_internal& obj, GLuint buffer)
+	{
+		if (obj.adjacencyBuffer == 0)
+		{
+			std::vector<int> triangles, adjacency;
+			_internalReadTriangles(obj, triangles);
+			_internalBuildVertexFaceAdjacency(triangles, obj.vertexCount, adjacency);
+			glGenBuffers(1, &obj.adjacencyBuffer);
+			glBindBuffer(GL_SHADER_STORAGE_BUFFER, obj.adjacencyBuffer);
+			glBufferData(GL_SHADER_STORAGE_BUFFER, sizeof(int) * adjacency.size(), &adjacency.front(), GL_STATIC_DRAW);
+		}
+
+		glUseProgram(internalNormalProgram);
+		glUniform1i(glGetUniformLocation(internalNormalProgram, "uVertexCount"), obj.vertexCount);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 0, buffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 1, obj.triangleBuffer);
+		glBindBufferBase(GL_SHADER_STORAGE_BUFFER, 2, obj.adjacencyBuffer);
+		glDispatchCompute(GLuint((obj.vertexCount + 63) / 64), 1, 1);
+		glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+	}
+
+	/*!
+	\brief Update the vertex positions of an already created object and recompute its normals. With compute shaders
+	(OpenGL 4.3), normals are recomputed on the GPU from the uploaded positions; otherwise they are computed on the CPU
+	and uploaded. The vertex-face adjacency is built on the first call.
+	\param id object index
+	\param vertices new vertex positions
+	*/
+	static void _internalUpdateVertices(int id, const std::vector<v3f>& vertices)
+	{
+		object_internal& obj = internalObjects[id];
+		const size_t size = sizeof(v3f) * vertices.size();
+		if (!obj.chunks.empty())
+		{
+			// Split objects: normals are computed on the CPU over the whole object, so that they are continuous
+			// across chunks, then positions and normals of each chunk are gathered and uploaded together
+			if (obj.cpuAdjacency.empty())
+			{
+				std::vector<int> chunkTriangles;
+				obj.cpuTriangles.clear();
+				obj.cpuTriangles.reserve(obj.triangleCount);
+				for (const object_internal& chunk : obj.chunks)
+				{
+					_internalReadTriangles(chunk, chunkTriangles);
+					for (int v : chunkTriangles)
+						obj.cpuTriangles.push_back(chunk.chunkVertices[v]);
+				}
+				_internalBuildVertexFaceAdjacency(obj.cpuTriangles, obj.vertexCount, obj.cpuAdjacency);
+			}
+			std::vector<v3f> normals, chunkData;
+			_internalComputeNormals(vertices, obj.cpuTriangles, obj.cpuAdjacency, normals);
+			for (object_internal& chunk : obj.chunks)
+			{
+				const size_t n = chunk.chunkVertices.size();
+				chunkData.resize(2 * n);
+				for (size_t i = 0; i < n; i++)
+				{
+					chunkData[i] = vertices[chunk.chunkVertices[i]];
+					chunkData[n + i] = normals[chunk.chunkVertices[i]];
+				}
+				glBindBuffer(GL_ARRAY_BUFFER, chunk.buffers);
+				glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(v3f) * chunkData.size(), &chunkData.front());
+				chunkData.resize(n);
+				_internalComputeBounds(chunkData, chunk.boundsMin, chunk.boundsMax);
+			}
+			return;
+		}
+
+		glBindVertexArray(obj.vao);
+		glBindBuffer(GL_ARRAY_BUFFER, obj.buffers);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, size, &vertices.front());
+
+		if (internalScene.hasComputeShaders)
+			_internalDispatchNormals(obj, obj.buffers);
+		else
+		{
+			if (obj.cpuAdjacency.empty())
+			{
+				_internalReadTriangles(obj, obj.cpuTriangles);
+				_internalBuildVertexFaceAdjacency(obj.cpuTriangles, obj.vertexCount, obj.cpuAdjacency);
+			}
+			std::vector<v3f> normals;
+			_internalComputeNormals(vertices, obj.cpuTriangles, obj.cpuAdjacency, normals);
+			glBufferSubData(GL_ARRAY_BUFFER, size, size, &normals.front());
+		}
+	}
+
+	/*!
+	\brief Store morph targets of an object in a texture buffer. Targets are stored as offsets from the current
+	vertex positions (and normals), which are read back from the object buffer.
+	\param obj internal object or chunk
+	\param targets target positions, each of the same size as the vertex array
+	\param targetNormals target normals, either empty or of the same size as targets
+	*/
+	static void _internalSetMorphTargets(object_internal& obj, const std::vector<std::vector<v3f>>& targets, const std::vector<std::vector<v3f>>& targetNormals)
+	{
+		const int vertexCount = obj.vertexCount;
+		const int targetCount = int(targets.size());
+		const bool hasNormals = !targetNormals.empty();
+
+		// Base positions and normals are stored contiguously at the start of the object buffer
+		std::vector<v3f> base(2 * size_t(vertexCount));
+		glBindBuffer(GL_COPY_READ_BUFFER, obj.buffers);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(v3f) * base.size(), &base.front());
+
+		// Offsets: all position targets, followed by all normal targets. Texels are padded to four floats, as three
+		// component texture buffers are not available before OpenGL 4.0.
+		std::vector<float> offsets(4 * size_t(vertexCount) * targetCount * (hasNormals ? 2 : 1), 0.0f);
+		_internalParallelFor(vertexCount, [&](int begin, int end)
+			{
+				for (int k = 0; k < targetCount; k++)
+				{
+					for (int v = begin; v < end; v++)
+					{
+						const v3f p = targets[k][v] - base[v];
+						std::copy(p.v, p.v + 3, &offsets[4 * (size_t(k) * vertexCount + v)]);
+						if (hasNormals)
+						{
+							const v3f n = targetNormals[k][v] - base[vertexCount + v];
+							std::copy(n.v, n.v + 3, &offsets[4 * (size_t(targetCount + k) * vertexCount + v)]);
+						}
+					}
+				}
+			});
+
+		if (obj.morphBuffer == 0)
+		{
+			glGenBuffers(1, &obj.morphBuffer);
+			glGenTextures(1, &obj.morphTexture);
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, obj.morphBuffer);
+		glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * offsets.size(), &offsets.front(), GL_STATIC_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, obj.morphTexture);
+		glTexBuffer(GL_TEXTURE_BUFFER, GL_RGBA32F, obj.morphBuffer);
+
+		obj.morphCount = targetCount;
+		obj.morphNormals = hasNormals;
+		obj.morphActiveCount = 0;
+	}
+
+	/*!
+	\brief Upload a texture buffer, creating it if needed.
+	\param buffer buffer handle
+	\param texture texture handle
+	\param format texel format
+	\param size size in bytes
+	\param data data
+	*/
+	static void _internalUploadTextureBuffer(GLuint& buffer, GLuint& texture, GLenum format, size_t size, const void* data)
+	{
+		if (buffer == 0)
+		{
+			glGenBuffers(1, &buffer);
+			glGenTextures(1, &texture);
+		}
+		glBindBuffer(GL_TEXTURE_BUFFER, buffer);
+		glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+		glBindTexture(GL_TEXTURE_BUFFER, texture);
+		glTexBuffer(GL_TEXTURE_BUFFER, format, buffer);
+	}
+
+	/*!
+	\brief Bin the point lights into the froxels of the view frustum, and upload the result for the fragment shader.
+	Froxels are the cells of a screen-space tile grid with exponentially distributed depth slices. Binning runs in
+	parallel over depth slices, and each froxel keeps at most internalMaxLightsPerCluster lights, the closest to its
+	center, which bounds the per-fragment cost.
+	\param viewMatrix camera view matrix
+	\param width, height dimensions of the render target
+	*/
+	static void _internalBuildClusters(const float viewMatrix[4][4], int width, int height)
+	{
+		auto start = std::chrono::high_resolution_clock::now();
+
+		// Lights in view space, where the camera looks towards -z
+		std::vector<float> lights;
+		for (const auto& light : internalLights)
+		{
+			if (light.isDeleted)
+				continue;
+			const v3f& p = light.position;
+			lights.push_back(viewMatrix[0][0] * p.x + viewMatrix[1][0] * p.y + viewMatrix[2][0] * p.z + viewMatrix[3][0]);
+			lights.push_back(viewMatrix[0][1] * p.x + viewMatrix[1][1] * p.y + viewMatrix[2][1] * p.z + viewMatrix[3][1]);
+			lights.push_back(viewMatrix[0][2] * p.x + viewMatrix[1][2] * p.y + viewMatrix[2][2] * p.z + viewMatrix[3][2]);
+			lights.push_back(light.radius);
+			lights.push_back(light.color.x);
+			lights.push_back(light.color.y);
+			lights.push_back(light.color.z);
+			lights.push_back(0.0f);
+		}
+		const int lightCount = int(lights.size() / 8);
+
+		// Per froxel light lists, built independently for each depth slice
+		const float tanHalfFovy = tan(toRadian(45.0f) / 2.0f);
+		const float tanHalfFovx = tanHalfFovy * float(width) / float(height);
+		const float zNear = internalScene.zNear, zFar = internalScene.zFar;
+		const int clusterCount = internalClusterX * internalClusterY * internalClusterZ;
+		std::vector<std::vector<int>> clusterLights(clusterCount);
+		_internalParallelFor(internalClusterZ, [&](int begin, int end)
+			{
+				std::vector<int> sliceLights;
+				std::vector<std::pair<float, int>> candidates;
+				for (int k = begin; k < end; k++)
+				{
+					const float z0 = zNear * std::pow(zFar / zNear, float(k) / float(internalClusterZ));
+					const float z1 = zNear * std::pow(zFar / zNear, float(k + 1) / float(internalClusterZ));
+
+					sliceLights.clear();
+					for (int l = 0; l < lightCount; l++)
+					{
+						const float depth = -lights[8 * l + 2];
+						const float radius = lights[8 * l + 3];
+						if (depth + radius >= z0 && depth - radius <= z1)
+							sliceLights.push_back(l);
+					}
+
+					for (int j = 0; j < internalClusterY && !sliceLights.empty(); j++)
+					{
+						for (int i = 0; i < internalClusterX; i++)
+						{
+							// Froxel bounding box in view space
+							const float x0 = (2.0f * float(i) / float(internalClusterX) - 1.0f) * tanHalfFovx;
+							const float x1 = (2.0f * float(i + 1) / float(internalClusterX) - 1.0f) * tanHalfFovx;
+							const float y0 = (2.0f * float(j) / float(internalClusterY) - 1.0f) * tanHalfFovy;
+							const float y1 = (2.0f * float(j + 1) / float(internalClusterY) - 1.0f) * tanHalfFovy;
+							const v3f boxMin = { std::min(x0 * z0, x0 * z1), std::min(y0 * z0, y0 * z1), -z1 };
+							const v3f boxMax = { std::max(x1 * z0, x1 * z1), std::max(y1 * z0, y1 * z1), -z0 };
+							const v3f center = (boxMin + boxMax) * 0.5f;
+
+							candidates.clear();
+							for (int l : sliceLights)
+							{
+								const v3f p = { lights[8 * l + 0], lights[8 * l + 1], lights[8 * l + 2] };
+								const v3f q = {
+									std::max(boxMin.x, std::min(p.x, boxMax.x)),
+									std::max(boxMin.y, std::min(p.y, boxMax.y)),
+									std::max(boxMin.z, std::min(p.z, boxMax.z))
+								};
+								const float radius = lights[8 * l + 3];
+								if (internalLength2(p - q) <= radius * radius)
+									candidates.push_back({ internalLength2(p - center), l });
+							}
+							if (candidates.size() > internalMaxLightsPerCluster)
+							{
+								std::nth_element(candidates.begin(), candidates.begin() + internalMaxLightsPerCluster, candidates.end());
+								candidates.resize(internalMaxLightsPerCluster + 1);
+							}
+
+							std::vector<int>& list = clusterLights[(k * internalClusterY + j) * internalClusterX + i];
+							for (const auto& c : candidates)
+								list.push_back(c.second);
+						}
+					}
+				}
+			}, 1);
+
+		// Flatten into the grid and index arrays
+		std::vector<unsigned int> grid(2 * size_t(clusterCount));
+		std::vector<unsigned int> indices;
+		int maxCount = 0, usedClusters = 0, truncated = 0;
+		for (int c = 0; c < clusterCount; c++)
+		{
+			int count = int(clusterLights[c].size());
+			if (count > internalMaxLightsPerCluster)
+			{
+				count = internalMaxLightsPerCluster;
+				truncated++;
+			}
+			grid[2 * c + 0] = (unsigned int)indices.size();
+			grid[2 * c + 1] = (unsigned int)count;
+			indices.insert(indices.end(), clusterLights[c].begin(), clusterLights[c].begin() + count);
+			maxCount = std::max(maxCount, count);
+			usedClusters += count > 0 ? 1 : 0;
+		}
+		if (lights.empty())
+			lights.resize(8, 0.0f);
+		if (indices.empty())
+			indices.push_back(0);
+
+		_internalUploadTextureBuffer(internalClusters.lightBuffer, internalClusters.lightTexture, GL_RGBA32F, sizeof(float) * lights.size(), &lights.front());
+		_internalUploadTextureBuffer(internalClusters.gridBuffer, internalClusters.gridTexture, GL_RG32UI, sizeof(unsigned int) * grid.size(), &grid.front());
+		_internalUploadTextureBuffer(internalClusters.indexBuffer, internalClusters.indexTexture, GL_R32UI, sizeof(unsigned int) * indices.size(), &indices.front());
+
+		internalClusters.lightCount = lightCount;
+		internalClusters.maxLightsPerCluster = maxCount;
+		internalClusters.averageLightsPerCluster = usedClusters == 0 ? 0.0f : float(indices.size()) / float(usedClusters);
+		internalClusters.truncatedClusters = truncated;
+		auto end = std::chrono::high_resolution_clock::now();
+		internalClusters.buildTimeMs = std::chrono::duration<float, std::milli>(end - start).count();
+	}
+
+	/*!
+	\brief Draw a tessellated object. Each triangle is a patch turned into a cubic PN triangle from its vertex normals,
+	whose edges are subdivided according to their projected length, then optionally displaced.
+	\param obj object
+	\param modelMatrix model matrix of the object
+	\param viewMatrix, projectionMatrix camera matrices
+	\param width, height dimensions of the render target
+	\param doLighting enable directional lighting
+	\param light normalized light direction
+	*/
+	static void _internalDrawTessellated(const object_internal& obj, const float modelMatrix[4][4], const float viewMatrix[4][4], const float projectionMatrix[4][4],
+		int width, int height, bool doLighting, const v3f& light)
+	{
+		const GLuint program = internalTessellationProgram;
+		const tessellation_internal& tessellation = *obj.tessellation;
+		glUseProgram(program);
+		glUniformMatrix4fv(glGetUniformLocation(program, "uProjection"), 1, GL_FALSE, &projectionMatrix[0][0]);
+		glUniformMatrix4fv(glGetUniformLocation(program, "uView"), 1, GL_FALSE, &viewMatrix[0][0]);
+		glUniformMatrix4fv(glGetUniformLocation(program, "uModel"), 1, GL_FALSE, &modelMatrix[0][0]);
+		glUniform3f(glGetUniformLocation(program, "uLightDir"), light.x, light.y, light.z);
+		glUniform1i(glGetUniformLocation(program, "uDoLighting"), int(doLighting));
+		glUniform2f(glGetUniformLocation(program, "uViewport"), float(width), float(height));
+		glUniform1f(glGetUniformLocation(program, "uPixelsPerEdge"), tessellation.pixelsPerEdge);
+		glUniform1f(glGetUniformLocation(program, "uAmplitude"), tessellation.displacementTexture != 0 ? tessellation.amplitude : 0.0f);
+		glUniform1f(glGetUniformLocation(program, "uTiling"), tessellation.tiling);
+		glUniform1i(glGetUniformLocation(program, "uDisplacement"), 0);
+		glActiveTexture(GL_TEXTURE0);
+		glBindTexture(GL_TEXTURE_2D, tessellation.displacementTexture);
+		glPatchParameteri(GL_PATCH_VERTICES, 3);
+		glBindVertexArray(obj.vao);
+		glDrawElements(GL_PATCHES, obj.triangleCount, GL_UNSIGNED_INT, 0);
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	/*!
+	\brief Render all objects of the scene with given camera matrices into the currently bound framebuffer.
+	\param viewMatrix camera view matrix
+	\param projectionMatrix camera projection matrix
+	\param width, height dimensions of the render target
+	*/
+	static void _internalRenderScene(const float viewMatrix[4][4], const float projectionMatrix[4][4], int width, int height)
+	{
+		// Precomputed uniform values
+		const float wireframeThicknessX = float(width) / internalScene.wireframeThickness;
+		const float wireframeThicknessY = float(height) / internalScene.wireframeThickness;
+
+		// Lighting and wireframe can be disabled while the camera moves
+		const bool isReduced = internalScene.dynamicResolution && internalScene.simplifyWhileMoving && internalScene.idleFrames < internalScene.idleFramesBeforeFullQuality;
+		const bool doLighting = internalScene.doLighting && !isReduced;
+		const bool drawWireframe = internalScene.drawWireframe && !isReduced;
+
+		// Point lights, binned into froxels
+		const bool hasPointLights = doLighting && std::any_of(internalLights.begin(), internalLights.end(), [](const light_internal& l) { return !l.isDeleted; });
+		if (hasPointLights)
+		{
+			_internalBuildClusters(viewMatrix, width, height);
+			glActiveTexture(GL_TEXTURE2);
+			glBindTexture(GL_TEXTURE_BUFFER, internalClusters.lightTexture);
+			glActiveTexture(GL_TEXTURE3);
+			glBindTexture(GL_TEXTURE_BUFFER, internalClusters.gridTexture);
+			glActiveTexture(GL_TEXTURE4);
+			glBindTexture(GL_TEXTURE_BUFFER, internalClusters.indexTexture);
+			glActiveTexture(GL_TEXTURE0);
+		}
+		else
+			internalClusters.lightCount = 0;
+
+		// Frustum, for objects with bounds
+		float viewProjection[4][4], frustum[6][4];
+		_internalMultiplyMatrix(viewProjection, projectionMatrix, viewMatrix);
+		_internalExtractFrustum(viewProjection, frustum);
+
+		// Render all visible objects
+		if (internalDrawListDirty)
+			_internalRebuildDrawList();
+		internalMeshletsDrawn = 0;
+		internalMeshletsTotal = 0;
+
+		// Software occlusion depth buffer, from the largest occluders
+		internalOcclusion.culledCount = 0;
+		internalOcclusion.triangles.clear();
+		if (internalOcclusion.isEnabled)
+			_internalBuildOcclusion(viewProjection, frustum, width, height);
+		v3f normalizedLight = internalNormalize(internalScene.lightDir);
+		for (int i : internalDrawList)
+		{
+			object_internal& it = internalObjects[i];
+			// PN triangles bulge by at most a fraction of their edge length, derived from the current bounds so that
+			// updated vertices are covered
+			const float margin = it.tessellation ? 0.1f * internalLength(it.boundsMax - it.boundsMin) + std::abs(it.tessellation->amplitude) : 0.0f;
+			const v3f boundsMin = it.boundsMin - v3f({ margin, margin, margin });
+			const v3f boundsMax = it.boundsMax + v3f({ margin, margin, margin });
+			if (it.hasBounds && !_internalBoxInFrustum(frustum, it.modelMatrix, boundsMin, boundsMax))
+				continue;
+			if (it.hasBounds && !it.occluder && _internalIsOccluded(viewProjection, it.modelMatrix, boundsMin, boundsMax))
+			{
+				internalOcclusion.culledCount++;
+				continue;
+			}
+
+			// Out-of-core objects are requested when visible, and replaced by their bounding box until resident
+			GLuint vao = it.vao;
+			int triangleCount = it.triangleCount;
+			float modelMatrix[4][4];
+			std::copy(&it.modelMatrix[0][0], &it.modelMatrix[0][0] + 16, &modelMatrix[0][0]);
+			if (it.streamId != -1)
+			{
+				// Frames measured by the anti-aliasing benchmark leave residency untouched
+				streamed_internal& streamed = *internalResidency.objects[it.streamId];
+				if (!internalBenchmark.isRendering)
+					streamed.lastUsedFrame = internalScene.frameIndex;
+				if (it.vao == 0)
+				{
+					if (!internalBenchmark.isRendering)
+						_internalRequestResidency(it.streamId);
+					float boxMatrix[4][4];
+					_internalComputeModelMatrix(boxMatrix, (it.boundsMin + it.boundsMax) * 0.5f, it.boundsMax - it.boundsMin);
+					_internalMultiplyMatrix(modelMatrix, it.modelMatrix, boxMatrix);
+					vao = internalResidency.placeholder.vao;
+					triangleCount = internalResidency.placeholder.triangleCount;
+				}
+			}
+
+			// Tessellated objects have their own program, and fall back to regular triangles without tessellation support
+			if (it.tessellation && internalTessellationProgram != 0 && vao == it.vao && it.chunks.empty())
+			{
+				_internalDrawTessellated(it, modelMatrix, viewMatrix, projectionMatrix, width, height, doLighting, normalizedLight);
+				continue;
+			}
+
+			// Always use the shader 0 for now.
+			GLuint shaderID = internalShaders[0];
+
+			glUseProgram(shaderID);
+			glUniformMatrix4fv(glGetUniformLocation(shaderID, "uProjection"), 1, GL_FALSE, &projectionMatrix[0][0]);
+			glUniformMatrix4fv(glGetUniformLocation(shaderID, "uView"), 1, GL_FALSE, &viewMatrix[0][0]);
+			glUniformMatrix4fv(glGetUniformLocation(shaderID, "uModel"), 1, GL_FALSE, &modelMatrix[0][0]);
+			glUniform3f(glGetUniformLocation(shaderID, "uLightDir"), normalizedLight[0], normalizedLight[1], normalizedLight[2]);
+			glUniform1i(glGetUniformLocation(shaderID, "uDoLighting"), int(doLighting));
+			glUniform1i(glGetUniformLocation(shaderID, "uDrawWireframe"), int(drawWireframe));
+			glUniform2f(glGetUniformLocation(shaderID, "uWireframeThickness"), wireframeThicknessX, wireframeThicknessY);
+			glUniform1i(glGetUniformLocation(shaderID, "uShowNormals"), int(internalScene.showNormals));
+			glUniform1i(glGetUniformLocation(shaderID, "uUseScalars"), int(it.scalarBuffer != 0 || (!it.chunks.empty() && it.chunks[0].scalarBuffer != 0)));
+			glUniform2f(glGetUniformLocation(shaderID, "uScalarRange"), it.scalarRange[0], it.scalarRange[1]);
+			glUniform1i(glGetUniformLocation(shaderID, "uColormap"), 0);
+			glActiveTexture(GL_TEXTURE0);
+			glBindTexture(GL_TEXTURE_1D, internalColormapTexture);
+			glUniform1i(glGetUniformLocation(shaderID, "uMorphTargets"), 1);
+			glUniform1i(glGetUniformLocation(shaderID, "uLights"), 2);
+			glUniform1i(glGetUniformLocation(shaderID, "uClusterGrid"), 3);
+			glUniform1i(glGetUniformLocation(shaderID, "uClusterIndices"), 4);
+			glUniform1i(glGetUniformLocation(shaderID, "uLightCount"), hasPointLights ? internalClusters.lightCount : 0);
+			glUniform2f(glGetUniformLocation(shaderID, "uViewport"), float(width), float(height));
+			glUniform2f(glGetUniformLocation(shaderID, "uCameraPlanes"), internalScene.zNear, internalScene.zFar);
+			glUniform1i(glGetUniformLocation(shaderID, "uMorphActiveCount"), it.morphActiveCount);
+			if (it.morphActiveCount > 0)
+			{
+				glUniform1i(glGetUniformLocation(shaderID, "uMorphCount"), it.morphCount);
+				glUniform1i(glGetUniformLocation(shaderID, "uMorphNormals"), int(it.morphNormals));
+				glUniform1i(glGetUniformLocation(shaderID, "uMorphVertexCount"), it.vertexCount);
+				glUniform1iv(glGetUniformLocation(shaderID, "uMorphIndices"), it.morphActiveCount, it.morphIndices);
+				glUniform1fv(glGetUniformLocation(shaderID, "uMorphWeights"), it.morphActiveCount, it.morphWeights);
+				glActiveTexture(GL_TEXTURE1);
+				glBindTexture(GL_TEXTURE_BUFFER, it.morphTexture);
+				glActiveTexture(GL_TEXTURE0);
+			}
+
+			if (!it.meshlets.empty() && vao == it.vao)
+			{
+				// Cull meshlets in parallel, then merge the surviving contiguous ranges
+				float inverseModel[4][4];
+				_internalInverseAffine(inverseModel, it.modelMatrix);
+				const v3f& eye = internalScene.eye;
+				v3f localEye;
+				for (int k = 0; k < 3; k++)
+					localEye[k] = inverseModel[0][k] * eye.x + inverseModel[1][k] * eye.y + inverseModel[2][k] * eye.z + inverseModel[3][k];
+				const int meshletCount = int(it.meshlets.size());
+				internalMeshletVisibility.resize(meshletCount);
+				_internalParallelFor(meshletCount, [&](int begin, int end)
+				{
+					for (int m = begin; m < end; m++)
+						internalMeshletVisibility[m] = _internalMeshletVisible(it.meshlets[m], frustum, it.modelMatrix, localEye, it.meshletConeCulling);
+				}, 2048);
+
+				internalDrawCounts.clear();
+				internalDrawOffsets.clear();
+				for (int m = 0; m < meshletCount; m++)
+				{
+					if (!internalMeshletVisibility[m])
+						continue;
+					const meshlet_internal& meshlet = it.meshlets[m];
+					if (m > 0 && internalMeshletVisibility[m - 1])
+						internalDrawCounts.back() += meshlet.indexCount;
+					else
+					{
+						internalDrawCounts.push_back(meshlet.indexCount);
+						internalDrawOffsets.push_back((const void*)(sizeof(int) * size_t(meshlet.indexOffset)));
+					}
+					internalMeshletsDrawn++;
+				}
+				internalMeshletsTotal += meshletCount;
+				glBindVertexArray(vao);
+				if (!internalDrawCounts.empty())
+					glMultiDrawElements(GL_TRIANGLES, &internalDrawCounts.front(), GL_UNSIGNED_INT, &internalDrawOffsets.front(), GLsizei(internalDrawCounts.size()));
+			}
+			else if (it.chunks.empty())
+			{
+				glBindVertexArray(vao);
+				glDrawElements(GL_TRIANGLES, triangleCount, GL_UNSIGNED_INT, 0);
+			}
+			for (const object_internal& chunk : it.chunks)
+			{
+				if (it.hasBounds && !_internalBoxInFrustum(frustum, it.modelMatrix, chunk.boundsMin, chunk.boundsMax))
+					continue;
+				if (it.hasBounds && !it.occluder && _internalIsOccluded(viewProjection, it.modelMatrix, chunk.boundsMin, chunk.boundsMax))
+					continue;
+				if (it.morphActiveCount > 0)
+				{
+					glUniform1i(glGetUniformLocation(shaderID, "uMorphVertexCount"), chunk.vertexCount);
+					glActiveTexture(GL_TEXTURE1);
+					glBindTexture(GL_TEXTURE_BUFFER, chunk.morphTexture);
+					glActiveTexture(GL_TEXTURE0);
+				}
+				glBindVertexArray(chunk.vao);
+				glDrawElements(GL_TRIANGLES, chunk.triangleCount, GL_UNSIGNED_INT, 0);
+			}
+		}
+
+		// Terrains, with their own program
+		_internalRenderTerrains(viewMatrix, projectionMatrix, frustum);
+
+		// Signed distance fields, ray marched inside their proxy box
+		_internalRenderSdfObjects(viewMatrix, projectionMatrix, frustum, height);
+	}
+
+	/*!
+	\brief Returns the number of samples per pixel of an anti-aliasing mode, 0 for non multisampled modes.
+	\param mode anti-aliasing mode
+	*/
+	static int _internalSampleCount(antialiasing mode)
+	{
+		return mode == antialiasing::msaa2 ? 2 : mode == antialiasing::msaa4 ? 4 : mode == antialiasing::msaa8 ? 8 : 0;
+	}
+
+	/*!
+	\brief Render the scene with the current anti-aliasing mode into an output framebuffer. Without anti-aliasing
+	and at the output resolution, the scene is drawn directly. Otherwise it is drawn offscreen, multisampled or not,
+	then resolved, post-processed and upscaled to the output.
+	\param viewMatrix camera view matrix
+	\param projectionMatrix camera projection matrix
+	\param renderWidth, renderHeight resolution of the scene pass
+	\param outputFbo output framebuffer, 0 for the window
+	\param outputWidth, outputHeight output resolution
+	*/
+	static void _internalRenderAntiAliased(const float viewMatrix[4][4], const float projectionMatrix[4][4], int renderWidth, int renderHeight,
+		GLuint outputFbo, int outputWidth, int outputHeight)
+	{
+		const antialiasing mode = internalScene.antialiasingMode;
+		if (mode == antialiasing::none && renderWidth == outputWidth && renderHeight == outputHeight)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+			glViewport(0, 0, outputWidth, outputHeight);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			_internalRenderScene(viewMatrix, projectionMatrix, renderWidth, renderHeight);
+			return;
+		}
+
+		// Scene pass, resolved into the scene target when multisampled
+		const int samples = _internalSampleCount(mode);
+		framebuffer_internal& target = samples > 0 ? internalMultisampleTarget : internalSceneTarget;
+		_internalResizeFramebuffer(target, renderWidth, renderHeight, GL_RGBA8, samples);
+		glBindFramebuffer(GL_FRAMEBUFFER, target.fbo);
+		glViewport(0, 0, renderWidth, renderHeight);
+		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+		_internalRenderScene(viewMatrix, projectionMatrix, renderWidth, renderHeight);
+		if (samples > 0)
+		{
+			_internalResizeFramebuffer(internalSceneTarget, renderWidth, renderHeight);
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, internalMultisampleTarget.fbo);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, internalSceneTarget.fbo);
+			glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, renderWidth, renderHeight, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		}
+
+		// Post-process filters, or bilinear upscaling
+		if (mode == antialiasing::fxaa)
+		{
+			glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+			glViewport(0, 0, outputWidth, outputHeight);
+			_internalDrawPostProcess(internalFxaaProgram, internalSceneTarget.color, renderWidth, renderHeight);
+		}
+		else if (mode == antialiasing::smaa)
+		{
+			_internalResizeFramebuffer(internalEdgesTarget, renderWidth, renderHeight);
+			glBindFramebuffer(GL_FRAMEBUFFER, internalEdgesTarget.fbo);
+			_internalDrawPostProcess(internalSmaaEdgesProgram, internalSceneTarget.color, renderWidth, renderHeight);
+			glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+			glViewport(0, 0, outputWidth, outputHeight);
+			glActiveTexture(GL_TEXTURE1);
+			glBindTexture(GL_TEXTURE_2D, internalEdgesTarget.color);
+			_internalDrawPostProcess(internalSmaaBlendProgram, internalSceneTarget.color, renderWidth, renderHeight);
+		}
+		else
+		{
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, internalSceneTarget.fbo);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, outputFbo);
+			glBlitFramebuffer(0, 0, renderWidth, renderHeight, 0, 0, outputWidth, outputHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+			glBindFramebuffer(GL_FRAMEBUFFER, outputFbo);
+			glViewport(0, 0, outputWidth, outputHeight);
+		}
+	}
+
+	/*!
+	\brief Advance the queued anti-aliasing benchmark by a batch of a few frames. The GPU time of the previous batch
+	is read back first, then the next batch of the current resolution and mode is rendered offscreen, at the
+	benchmark resolution. Multisampled modes with more samples than the device supports are skipped.
+	*/
+	static void _internalUpdateAntiAliasingBenchmark()
+	{
+		benchmark_internal& b = internalBenchmark;
+		if (!b.isRunning)
+			return;
+		const int sizes[2][2] = { { 1920, 1080 }, { 3840, 2160 } };
+		const int framesPerBatch = 4;
+		if (b.isQueryPending)
+		{
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(b.query, GL_QUERY_RESULT, &elapsed);
+			b.elapsedMs += double(elapsed) / 1e6;
+			b.isQueryPending = false;
+		}
+
+		// Next step once all frames of the current one are measured
+		if (b.framesLeft == 0)
+		{
+			b.results[b.step / 6][b.step % 6] = float(b.elapsedMs / double(b.frames));
+			b.step++;
+			b.framesLeft = -1;
+			b.elapsedMs = 0.0;
+		}
+		while (b.step < 12 && _internalSampleCount(antialiasing(b.step % 6)) > b.maxSamples)
+		{
+			b.results[b.step / 6][b.step % 6] = -1.0f;
+			b.step++;
+		}
+		if (b.step == 12)
+		{
+			b.isRunning = false;
+			_internalDeleteFramebuffer(b.output);
+			glDeleteQueries(1, &b.query);
+			b.query = 0;
+			setAntiAliasing(internalScene.antialiasingMode);
+			return;
+		}
+
+		const antialiasing previousMode = internalScene.antialiasingMode;
+		const int width = sizes[b.step / 6][0], height = sizes[b.step / 6][1];
+		internalScene.antialiasingMode = antialiasing(b.step % 6);
+		_internalResizeFramebuffer(b.output, width, height);
+		float viewMatrix[4][4] = { 0 }, projectionMatrix[4][4] = { 0 };
+		_internalCameraLookAt(viewMatrix);
+		_internalCameraPerspective(projectionMatrix, width, height);
+		b.isRendering = true;
+		if (b.framesLeft == -1)
+		{
+			// Warm up, so that render targets are allocated before timing
+			_internalRenderAntiAliased(viewMatrix, projectionMatrix, width, height, b.output.fbo, width, height);
+			b.framesLeft = b.frames;
+		}
+		else
+		{
+			const int batch = std::min(b.framesLeft, framesPerBatch);
+			glBeginQuery(GL_TIME_ELAPSED, b.query);
+			for (int f = 0; f < batch; f++)
+				_internalRenderAntiAliased(viewMatrix, projectionMatrix, width, height, b.output.fbo, width, height);
+			glEndQuery(GL_TIME_ELAPSED);
+			b.framesLeft -= batch;
+			b.isQueryPending = true;
+		}
+		b.isRendering = false;
+
+		internalScene.antialiasingMode = previousMode;
+		glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		glViewport(0, 0, width_internal, height_internal);
+	}
+
+	/*!
+	\brief Returns the frame that is predicted to be displayed after a given number of steps, or -1 if playback
+	ends before that.
+	\param series time series
+	\param frame current frame
+	\param stride signed number of frames advanced per step
+	\param step number of steps
+	*/
+	static int _internalPredictTimeSeriesFrame(const timeseries_internal& series, int frame, int stride, int step)
+	{
+		int f = frame + stride * step;
+		if (series.loop)
+			return ((f % series.frameCount) + series.frameCount) % series.frameCount;
+		return (f < 0 || f >= series.frameCount) ? -1 : f;
+	}
+
+	/*!
+	\brief Prefetch thread of a time series. Keeps the slots filled with the frames that follow the requested frame
+	in the playback direction, reading them from the container file. When normals cannot be computed on the GPU,
+	they are computed here and stored after the positions.
+	\param series time series
+	\param filename container file
+	*/
+	static void _internalTimeSeriesPrefetch(timeseries_internal* series, std::string filename)
+	{
+		std::ifstream in(filename, std::ios::binary);
+		std::vector<v3f> staging;
+		std::unique_lock<std::mutex> lock(series->mutex);
+		while (!series->quit)
+		{
+			// Find the first predicted frame that is not yet loaded or loading
+			int frameToLoad = -1, slotToUse = -1;
+			const int slotCount = int(series->slots.size());
+			const int start = series->requestedStart;
+			for (int i = start; i < start + slotCount && frameToLoad == -1; i++)
+			{
+				const int f = _internalPredictTimeSeriesFrame(*series, series->requestedFrame, series->requestedStride, i);
+				if (f == -1)
+					break;
+				bool isPresent = false;
+				for (const auto& slot : series->slots)
+					isPresent = isPresent || slot.frame == f;
+				if (!isPresent)
+					frameToLoad = f;
+			}
+
+			// Evict a slot holding a frame that is not predicted anymore
+			if (frameToLoad != -1)
+			{
+				for (int s = 0; s < slotCount && slotToUse == -1; s++)
+				{
+					bool isPredicted = false;
+					for (int i = start; i < start + slotCount; i++)
+						isPredicted = isPredicted || _internalPredictTimeSeriesFrame(*series, series->requestedFrame, series->requestedStride, i) == series->slots[s].frame;
+					if (series->slots[s].frame == -1 || !isPredicted)
+						slotToUse = s;
+				}
+			}
+			if (slotToUse == -1)
+			{
+				series->condition.wait(lock);
+				continue;
+			}
+
+			// Read without holding the lock
+			timeseries_slot_internal& slot = series->slots[slotToUse];
+			slot.frame = frameToLoad;
+			slot.isReady = false;
+			staging.swap(slot.data);
+			if (staging.capacity() == 0)
+				staging.swap(series->recycled);
+			lock.unlock();
+
+			const int n = series->vertexCount;
+			staging.resize(series->cpuNormals ? 2 * size_t(n) : size_t(n));
+			in.seekg(series->dataOffset + std::streamoff(sizeof(v3f)) * n * frameToLoad);
+			if (!in.read((char*)&staging.front(), sizeof(v3f) * n))
+			{
+				// The frame stays in its slot without being ready, so it is not read again, and is counted as
+				// dropped when it should be displayed
+				in.clear();
+				lock.lock();
+				if (slot.frame == frameToLoad)
+					slot.data.swap(staging);
+				continue;
+			}
+			if (series->cpuNormals)
+			{
+				std::vector<v3f> positions(staging.begin(), staging.begin() + n), normals;
+				_internalComputeNormals(positions, series->triangles, series->adjacency, normals);
+				std::copy(normals.begin(), normals.end(), staging.begin() + n);
+			}
+
+			lock.lock();
+			if (slot.frame == frameToLoad)
+			{
+				slot.data.swap(staging);
+				slot.isReady = true;
+			}
+		}
+	}
+
+	/*!
+	\brief Stop the prefetch thread of a time series and free its stream buffers.
+	\param series time series
+	*/
+	static void _internalStopTimeSeries(timeseries_internal& series)
+	{
+		{
+			std::lock_guard<std::mutex> lock(series.mutex);
+			series.quit = true;
+		}
+		series.condition.notify_one();
+		if (series.thread.joinable())
+			series.thread.join();
+		glDeleteBuffers(2, series.streamBuffers);
+	}
+
+	/*!
+	\brief Advance playback of all time series. When the frame to display has been prefetched, it is uploaded to the
+	back stream buffer, which then becomes the front buffer attached to the object. Otherwise the previous frame stays
+	on screen and a dropped frame is recorded.
+	*/
+	static void _internalUpdateTimeSeries()
+	{
+		for (auto& seriesPtr : internalTimeSeries)
+		{
+			timeseries_internal& series = *seriesPtr;
+			object_internal& obj = internalObjects[series.objectId];
+
+			// Advance time
+			const float lastFrameTime = float(series.frameCount - 1);
+			series.time += series.speed * internalScene.deltaTime;
+			if (series.loop)
+				series.time -= float(series.frameCount) * std::floor(series.time / float(series.frameCount));
+			else
+				series.time = std::max(0.0f, std::min(series.time, lastFrameTime));
+			const int target = std::min(int(series.time), series.frameCount - 1);
+
+			// Prefetch hint: playback direction and number of frames advanced per displayed frame
+			const float framesPerUpdate = series.speed * internalScene.deltaTime;
+			int stride = int(std::round(framesPerUpdate));
+			if (stride == 0)
+				stride = series.speed < 0.0f ? -1 : 1;
+
+			std::vector<v3f> data;
+			{
+				std::lock_guard<std::mutex> lock(series.mutex);
+				series.requestedFrame = target;
+				series.requestedStride = stride;
+				if (target != series.displayedFrame)
+				{
+					for (auto& slot : series.slots)
+					{
+						if (slot.frame == target && slot.isReady)
+						{
+							data.swap(slot.data);
+							slot.frame = -1;
+							slot.isReady = false;
+						}
+					}
+				}
+				series.requestedStart = target == series.displayedFrame || !data.empty() ? 1 : 0;
+			}
+			series.condition.notify_one();
+			if (target == series.displayedFrame)
+				continue;
+			if (data.empty())
+			{
+				series.droppedFrames++;
+				continue;
+			}
+
+			// Upload to the back buffer, then swap
+			const int back = 1 - series.frontBuffer;
+			const size_t size = sizeof(v3f) * series.vertexCount;
+			glBindVertexArray(obj.vao);
+			glBindBuffer(GL_ARRAY_BUFFER, series.streamBuffers[back]);
+			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(v3f) * data.size(), &data.front());
+			if (!series.cpuNormals)
+				_internalDispatchNormals(obj, series.streamBuffers[back]);
+			glBindBuffer(GL_ARRAY_BUFFER, series.streamBuffers[back]);
+			glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const void*)0);
+			glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (const void*)size);
+			series.frontBuffer = back;
+			series.displayedFrame = target;
+			internalScene.sceneVersion++;
+			{
+				std::lock_guard<std::mutex> lock(series.mutex);
+				series.recycled.swap(data);
+			}
+		}
+	}
+
+	/*
+	\brief Deletes an object from the internal hierarchy. Destroys the opengl buffers.
+	\param id object index
+	*/
+	static bool _internalDeleteObject(int id)
+	{
+		object_internal& obj = internalObjects[id];
+		if (obj.isDeleted)
+			return false;
+
+		glDeleteBuffers(1, &obj.buffers);
+		glDeleteBuffers(1, &obj.triangleBuffer);
+		if (obj.scalarBuffer != 0)
+			glDeleteBuffers(1, &obj.scalarBuffer);
+		if (obj.adjacencyBuffer != 0)
+			glDeleteBuffers(1, &obj.adjacencyBuffer);
+		if (obj.morphBuffer != 0)
+		{
+			glDeleteTextures(1, &obj.morphTexture);
+			glDeleteBuffers(1, &obj.morphBuffer);
+		}
+		obj.cpuAdjacency.clear();
+		obj.cpuTriangles.clear();
+		obj.subdivision.reset();
+		if (obj.tessellation)
+		{
+			glDeleteTextures(1, &obj.tessellation->displacementTexture);
+			obj.tessellation.reset();
+		}
+		for (object_internal& chunk : obj.chunks)
+		{
+			glDeleteBuffers(1, &chunk.buffers);
+			glDeleteBuffers(1, &chunk.triangleBuffer);
+			if (chunk.scalarBuffer != 0)
+				glDeleteBuffers(1, &chunk.scalarBuffer);
+			if (chunk.morphBuffer != 0)
+			{
+				glDeleteTextures(1, &chunk.morphTexture);
+				glDeleteBuffers(1, &chunk.morphBuffer);
+			}
+			glDeleteVertexArrays(1, &chunk.vao);
+		}
+		obj.chunks.clear();
+
+		// Out-of-core objects are never loaded again
+		if (obj.streamId != -1)
+		{
+			std::lock_guard<std::mutex> lock(internalResidency.mutex);
+			streamed_internal& streamed = *internalResidency.objects[obj.streamId];
+			if (streamed.state == residency_state::resident)
+				internalResidency.residentBytes -= streamed.bytes;
+			streamed.state = residency_state::unloaded;
+			streamed.data = object();
+			streamed.source = [](){ return object(); };
+			streamed.lastUsedFrame = -1;
+			streamed.objectId = -1;
+			obj.streamId = -1;
+		}
+
+		// Stop the ambient occlusion bake of this object, if any
+		_internalStopBake(id);
+
+		// Stop the time series streaming into this object, if any
+		for (size_t i = 0; i < internalTimeSeries.size(); i++)
+		{
+			if (internalTimeSeries[i]->objectId == id)
+			{
+				_internalStopTimeSeries(*internalTimeSeries[i]);
+				internalTimeSeries.erase(internalTimeSeries.begin() + i);
+				break;
+			}
+		}
+		glDeleteVertexArrays(1, &obj.vao);
+
+		// Children become roots, keeping their current world transform
+		_internalUpdateTransforms();
+		for (int i = 0; i < int(internalObjects.size()); i++)
+		{
+			object_internal& child = internalObjects[i];
+			if (!child.isDeleted && child.parent == id)
+			{
+				child.parent = -1;
+				std::copy(&child.modelMatrix[0][0], &child.modelMatrix[0][0] + 16, &child.localMatrix[0][0]);
+			}
+		}
+		obj.parent = -1;
+		internalHierarchy.needsRebuild = true;
+		internalDrawListDirty = true;
+
+		// Objects are not actually removed from the internal vector, but flagged as deleted.
+		// This is to ensure indices of existing objects will not change from the API point of view.
+		obj.isDeleted = true;
+
+		return true;
+	}
+
+	/*!
+	\brief Remove everything that the scene holds: objects with their time series and bakes, out-of-core records
+	and their loading thread, lights, terrains, voxel volumes and signed distance fields. Shared programs and
+	render targets are kept.
+	*/
+	static void _internalClearScene()
+	{
+		for (int i = 0; i < int(internalObjects.size()); i++)
+			_internalDeleteObject(i);
+		internalObjects.clear();
+		_internalStopResidency();
+		internalResidency.objects.clear();
+		internalResidency.requests.clear();
+		internalResidency.residentBytes = 0;
+		internalHierarchy = hierarchy_internal();
+		internalTimeSeries.clear();
+		internalLights.clear();
+		for (terrain_internal& terrain : internalTerrains)
+			glDeleteTextures(1, &terrain.heightTexture);
+		internalTerrains.clear();
+		internalVoxelVolumes.clear();
+		for (sdf_internal& sdf : internalSdfObjects)
+		{
+			glDeleteBuffers(1, &sdf.programBuffer);
+			glDeleteTextures(1, &sdf.programTexture);
+			glDeleteTextures(1, &sdf.volumeTexture);
+		}
+		internalSdfObjects.clear();
+		internalOcclusion.triangles.clear();
+		internalDrawListDirty = true;
+		internalScene.sceneVersion++;
+	}
+
+	/*!
+	\brief Map a file in memory, read only.
+	\param filename file to map
+	\param mapped mapping, to be released with _internalUnmapFile
+	\returns false if the file could not be opened or mapped.
+	*/
+	static bool _internalMapFile(const char* filename, mapped_file_internal& mapped)
+	{
+#ifdef _WIN32
+		mapped.file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (mapped.file == INVALID_HANDLE_VALUE)
+			return false;
+		LARGE_INTEGER size;
+		GetFileSizeEx(mapped.file, &size);
+		mapped.size = size_t(size.QuadPart);
+		mapped.mapping = CreateFileMappingA(mapped.file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapped.mapping != nullptr)
+			mapped.data = (const char*)MapViewOfFile(mapped.mapping, FILE_MAP_READ, 0, 0, 0);
+#else
+		mapped.file = open(filename, O_RDONLY);
+		if (mapped.file < 0)
+			return false;
+		struct stat info;
+		fstat(mapped.file, &info);
+		mapped.size = size_t(info.st_size);
+		void* data = mmap(nullptr, mapped.size, PROT_READ, MAP_PRIVATE, mapped.file, 0);
+		if (data != MAP_FAILED)
+		{
+			mapped.data = (const char*)data;
+			madvise(data, mapped.size, MADV_SEQUENTIAL);
+		}
+#endif
+		return mapped.data != nullptr;
+	}
+
+	/*!
+	\brief Release a file mapped with _internalMapFile.
+	\param mapped mapping
+	*/
+	static void _internalUnmapFile(mapped_file_internal& mapped)
+	{
+#ifdef _WIN32
+		if (mapped.data != nullptr)
+			UnmapViewOfFile(mapped.data);
+		if (mapped.mapping != nullptr)
+			CloseHandle(mapped.mapping);
+		if (mapped.file != INVALID_HANDLE_VALUE)
+			CloseHandle(mapped.file);
+#else
+		if (mapped.data != nullptr)
+			munmap((void*)mapped.data, mapped.size);
+		if (mapped.file >= 0)
+			close(mapped.file);
+#endif
+		mapped = mapped_file_internal();
+	}
+
+	/*!
+	\brief Returns the size of a snapshot blob once padded to 16 bytes.
+	\param size blob size in bytes
+	*/
+	static size_t _internalSnapshotPadding(size_t size)
+	{
+		return (size + 15) & ~size_t(15);
+	}
+
+	/*
+	\brief Returns the next free index in the internal object array.
+	*/
+	static int _internalGetNextFreeIndex()
+	{
+		for (int i = 0; i < internalObjects.size(); i++)
+		{
+			if (internalObjects[i].isDeleted)
+				return i;
+		}
+		return int(internalObjects.size());
+	}
+
+	/*!
+	\brief Insert a created object in the internal object array, reusing the slot of a deleted object if any.
+	\param internalObject object, with its buffers
+	\returns the id of the object.
+	*/
+	static int _internalInsertObject(const object_internal& internalObject)
+	{
+		int index = _internalGetNextFreeIndex();
+		if (index == internalObjects.size())
+			internalObjects.push_back(internalObject);
+		else
+			internalObjects[index] = internalObject;
+		internalHierarchy.needsRebuild = true;
+		internalDrawListDirty = true;
+		return index;
+	}
+
+
+	/*!
+	\brief Init a window sized (width, height) with a given name.
+	\param windowName name of the window on top bar
+	\param width, height window dimensions. If either is -1, then the window will
+	maximized at startup with screen resolution.
+	*/
+	void init(const char* windowName, int width, int height)
+	{
+		// Window
+		glfwInit();
+		if (width == -1 || height == -1)
+		{
+			const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
+			width = mode->width;
+			height = mode->height;
+		}
+		width_internal = width;
+		height_internal = height;
+
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MAJOR, 3);
+		glfwWindowHint(GLFW_CONTEXT_VERSION_MINOR, 3);
 		glfwWindowHint(GLFW_OPENGL_PROFILE, GLFW_OPENGL_CORE_PROFILE);
 		glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
 		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
@@ -381,405 +4726,2286 @@ namespace tinyrender
 		windowPtr = glfwCreateWindow(width, height, windowName, NULL, NULL);
 		if (windowPtr == NULL)
 		{
-			fprintf(stderr, "Error creating GLFW window - terminating");
-			glfwTerminate();
+			fprintf(stderr, "Error creating GLFW window - terminating");
+			glfwTerminate();
+			return;
+		}
+		glfwMakeContextCurrent(windowPtr);
+		glfwShowWindow(windowPtr);
+		glfwSwapInterval(1);
+		glfwSetInputMode(windowPtr, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
+		glfwSetWindowSizeCallback(windowPtr, [](GLFWwindow* win, int w, int h)
+			{
+				glViewport(0, 0, w, h);
+				width_internal = w;
+				height_internal = h;
+			});
+		glfwSetScrollCallback(windowPtr, [](GLFWwindow* win, double x, double y)
+			{
+				_internalCameraMove(0.0f, 0.0f, float(y) * internalScene.mouseScrollingSpeed, 0.0f, 0.0f);
+			});
+
+		// OpenGL
+		glewInit();
+		glEnable(GL_DEPTH_TEST);
+		internalScene.hasComputeShaders = GLEW_VERSION_4_3 != 0;
+		internalScene.hasTessellation = GLEW_VERSION_4_0 != 0;
+		GLenum err = glGetError();
+		if (err != GL_NO_ERROR)
+		{
+			fprintf(stderr, "Error initializing opengl - terminating");
+			glfwTerminate();
+			return;
+		}
+
+		// Shaders
+		const GLchar* vertexShaderSource =
+			"#version 330\n"
+			"layout (location = 0) in vec3 vertex;\n"
+			"layout (location = 1) in vec3 normal;\n"
+			"layout (location = 2) in vec3 color;\n"
+			"layout (location = 3) in float scalar;\n"
+			"uniform mat4 uProjection;\n"
+			"uniform mat4 uView;\n"
+			"uniform mat4 uModel;\n"
+			"uniform int uUseScalars;\n"
+			"uniform vec2 uScalarRange;\n"
+			"uniform sampler1D uColormap;\n"
+			"uniform int uMorphActiveCount;\n"
+			"uniform int uMorphCount;\n"
+			"uniform int uMorphNormals;\n"
+			"uniform int uMorphVertexCount;\n"
+			"uniform int uMorphIndices[8];\n"
+			"uniform float uMorphWeights[8];\n"
+			"uniform samplerBuffer uMorphTargets;\n"
+			"out vec3 geomPos;\n"
+			"out vec3 geomNormal;\n"
+			"out vec3 geomColor;\n"
+			"out vec3 geomViewPos;\n"
+			"void main()\n"
+			"{\n"
+			"	 vec3 p = vertex;\n"
+			"	 vec3 n = normal;\n"
+			"	 for (int i = 0; i < uMorphActiveCount; i++) {\n"
+			"		int k = uMorphIndices[i];\n"
+			"		p += uMorphWeights[i] * texelFetch(uMorphTargets, k * uMorphVertexCount + gl_VertexID).xyz;\n"
+			"		if (uMorphNormals == 1)\n"
+			"			n += uMorphWeights[i] * texelFetch(uMorphTargets, (uMorphCount + k) * uMorphVertexCount + gl_VertexID).xyz;\n"
+			"	 }\n"
+			"	 geomPos = p;\n"
+			"	 geomViewPos = (uView * uModel * vec4(p, 1.0f)).xyz;\n"
+			"    gl_Position = uProjection * vec4(geomViewPos, 1.0f);\n"
+			"	 geomNormal = normalize(n);\n"
+			"    geomColor = color;\n"
+			"    if (uUseScalars == 1) {\n"
+			"		float t = clamp((scalar - uScalarRange.x) / (uScalarRange.y - uScalarRange.x), 0.0, 1.0);\n"
+			"		float n = float(textureSize(uColormap, 0));\n"
+			"		geomColor = texture(uColormap, (t * (n - 1.0) + 0.5) / n).rgb;\n"
+			"    }\n"
+			"}\n";
+		const GLchar* geometryShaderSource =
+			"#version 330\n"
+			"layout(triangles) in;\n"
+			"layout(triangle_strip, max_vertices = 3) out;\n"
+			"in vec3 geomPos[];\n"
+			"in vec3 geomNormal[];\n"
+			"in vec3 geomColor[];\n"
+			"in vec3 geomViewPos[];\n"
+			"uniform vec2 uWireframeThickness;\n"
+			"out vec3 fragPos;\n"
+			"out vec3 fragNormal;\n"
+			"out vec3 fragColor;\n"
+			"out vec3 fragViewPos;\n"
+			"out vec3 dist;\n"
+			"void main()\n"
+			"{\n"
+			"	vec2 p0 = uWireframeThickness * gl_in[0].gl_Position.xy / gl_in[0].gl_Position.w;\n"
+			"	vec2 p1 = uWireframeThickness * gl_in[1].gl_Position.xy / gl_in[1].gl_Position.w;\n"
+			"	vec2 p2 = uWireframeThickness * gl_in[2].gl_Position.xy / gl_in[2].gl_Position.w;\n"
+			"	vec2 v0 = p2 - p1;\n"
+			"	vec2 v1 = p2 - p0;;\n"
+			"	vec2 v2 = p1 - p0;;\n"
+			"	float area = abs(v1.x*v2.y - v1.y * v2.x);\n"
+			"	dist = vec3(area / length(v0), 0, 0);\n"
+			"	gl_Position = gl_in[0].gl_Position;\n"
+			"	fragPos = geomPos[0]; fragColor = geomColor[0];  fragNormal = geomNormal[0]; fragViewPos = geomViewPos[0];\n"
+			"	EmitVertex();\n"
+			"	dist = vec3(0, area / length(v1), 0);\n"
+			"	gl_Position = gl_in[1].gl_Position;\n"
+			"	fragPos = geomPos[1]; fragColor = geomColor[1];  fragNormal = geomNormal[1]; fragViewPos = geomViewPos[1];\n"
+			"	EmitVertex();\n"
+			"	dist = vec3(0, 0, area / length(v2));\n"
+			"	gl_Position = gl_in[2].gl_Position;\n"
+			"	fragPos = geomPos[2]; fragColor = geomColor[2];  fragNormal = geomNormal[2]; fragViewPos = geomViewPos[2];\n"
+			"	EmitVertex();\n"
+			"	EndPrimitive();\n"
+			"}\n";
+		const GLchar* fragmentShaderSource =
+			"#version 330\n"
+			"in vec3 fragPos;\n"
+			"in vec3 fragNormal;\n"
+			"in vec3 fragColor;\n"
+			"in vec3 fragViewPos;\n"
+			"in vec3 dist;\n"
+			"uniform vec3 uLightDir;\n"
+			"uniform int uDoLighting;\n"
+			"uniform int uDrawWireframe;\n"
+			"uniform int uShowNormals;\n"
+			"uniform mat4 uView;\n"
+			"uniform int uLightCount;\n"
+			"uniform vec2 uViewport;\n"
+			"uniform vec2 uCameraPlanes;\n"
+			"uniform samplerBuffer uLights;\n"
+			"uniform usamplerBuffer uClusterGrid;\n"
+			"uniform usamplerBuffer uClusterIndices;\n"
+			"out vec4 outFragmentColor;\n"
+			"vec3 pointLights(vec3 n)\n"
+			"{\n"
+			"	 vec3 viewNormal = normalize(mat3(uView) * n);\n"
+			"	 float depth = -fragViewPos.z;\n"
+			"	 int k = int(log(depth / uCameraPlanes.x) / log(uCameraPlanes.y / uCameraPlanes.x) * 24.0);\n"
+			"	 ivec2 tile = ivec2(gl_FragCoord.xy / uViewport * vec2(16.0, 9.0));\n"
+			"	 int cluster = (clamp(k, 0, 23) * 9 + clamp(tile.y, 0, 8)) * 16 + clamp(tile.x, 0, 15);\n"
+			"	 uvec2 range = texelFetch(uClusterGrid, cluster).xy;\n"
+			"	 vec3 sum = vec3(0.0);\n"
+			"	 for (uint i = 0u; i < range.y; i++) {\n"
+			"		int l = int(texelFetch(uClusterIndices, int(range.x + i)).x);\n"
+			"		vec4 light = texelFetch(uLights, 2 * l);\n"
+			"		vec3 L = light.xyz - fragViewPos;\n"
+			"		float d2 = dot(L, L);\n"
+			"		float falloff = clamp(1.0 - d2 * d2 / (light.w * light.w * light.w * light.w), 0.0, 1.0);\n"
+			"		sum += texelFetch(uLights, 2 * l + 1).rgb * max(dot(viewNormal, L * inversesqrt(d2)), 0.0) * falloff * falloff / (1.0 + d2);\n"
+			"	 }\n"
+			"	 return sum;\n"
+			"}\n"
+			"void main()\n"
+			"{\n"
+			"	 vec3 d = vec3(uDoLighting == 1 ? 0.5 * (1.0 + dot(fragNormal, uLightDir)) : 1.0f);\n"
+			"	 if (uDoLighting == 1 && uLightCount > 0)\n"
+			"		d += pointLights(fragNormal);\n"
+			"	 vec3 col = fragColor;\n"
+			"	 if (uShowNormals == 1) {\n"
+			"		col = vec3(0.2*(vec3(3.0,3.0,3.0)+2.0*fragNormal));\n"
+			"		d = vec3(1.f)\n;"
+			"	 }\n"
+			"	 float w = min(dist[0], min(dist[1], dist[2]));\n"
+			"	 float I = exp2(-1 * w * w);\n"
+			"	 if (uDrawWireframe == 1)\n"
+			"		col = I * vec3(0.1) + (1.0 - I) * col;\n"
+			"	 outFragmentColor = vec4(col * d, 1.0); \n"
+			"}\n";
+		GLuint g_ShaderHandle = 0, g_VertHandle = 0, g_FragHandle = 0, g_GeomHandle = 0;
+		g_VertHandle = glCreateShader(GL_VERTEX_SHADER);
+		glShaderSource(g_VertHandle, 1, &vertexShaderSource, NULL);
+		glCompileShader(g_VertHandle);
+		if (!_internalCheckShader(g_VertHandle, "vertex shader"))
+		{
+			fprintf(stderr, "Error initializing vertex shader - terminating");
+			return;
+		}
+
+		g_GeomHandle = glCreateShader(GL_GEOMETRY_SHADER);
+		glShaderSource(g_GeomHandle, 1, &geometryShaderSource, NULL);
+		glCompileShader(g_GeomHandle);
+		if (!_internalCheckShader(g_GeomHandle, "geometry shader"))
+		{
+			fprintf(stderr, "Error initializing geometry shader - terminating");
+			return;
+		}
+
+		g_FragHandle = glCreateShader(GL_FRAGMENT_SHADER);
+		glShaderSource(g_FragHandle, 1, &fragmentShaderSource, NULL);
+		glCompileShader(g_FragHandle);
+		if (!_internalCheckShader(g_FragHandle, "fragment shader"))
+		{
+			fprintf(stderr, "Error initializing fragment shader - terminating");
+			return;
+		}
+
+		g_ShaderHandle = glCreateProgram();
+		glAttachShader(g_ShaderHandle, g_VertHandle);
+		glAttachShader(g_ShaderHandle, g_GeomHandle);
+		glAttachShader(g_ShaderHandle, g_FragHandle);
+		glLinkProgram(g_ShaderHandle);
+		internalShaders.push_back(g_ShaderHandle);
+
+		// Normal recomputation, only available with compute shaders
+		if (internalScene.hasComputeShaders)
+		{
+			const GLchar* normalShaderSource =
+				"#version 430\n"
+				"layout(local_size_x = 64) in;\n"
+				"layout(std430, binding = 0) buffer Vertices { float data[]; };\n"
+				"layout(std430, binding = 1) readonly buffer Triangles { int triangles[]; };\n"
+				"layout(std430, binding = 2) readonly buffer Adjacency { int adjacency[]; };\n"
+				"uniform int uVertexCount;\n"
+				"vec3 position(int i) { return vec3(data[3 * i], data[3 * i + 1], data[3 * i + 2]); }\n"
+				"void main()\n"
+				"{\n"
+				"	int v = int(gl_GlobalInvocationID.x);\n"
+				"	if (v >= uVertexCount)\n"
+				"		return;\n"
+				"	vec3 n = vec3(0.0);\n"
+				"	for (int k = adjacency[v]; k < adjacency[v + 1]; k++) {\n"
+				"		int f = adjacency[uVertexCount + 1 + k];\n"
+				"		vec3 a = position(triangles[3 * f + 0]);\n"
+				"		vec3 b = position(triangles[3 * f + 1]);\n"
+				"		vec3 c = position(triangles[3 * f + 2]);\n"
+				"		n += cross(b - a, c - a);\n"
+				"	}\n"
+				"	n = dot(n, n) > 0.0 ? normalize(n) : vec3(0.0, 1.0, 0.0);\n"
+				"	int o = 3 * (uVertexCount + v);\n"
+				"	data[o] = n.x; data[o + 1] = n.y; data[o + 2] = n.z;\n"
+				"}\n";
+			GLuint normalHandle = _internalCompileShader(GL_COMPUTE_SHADER, normalShaderSource, "normal compute shader");
+			if (normalHandle != 0)
+			{
+				internalNormalProgram = glCreateProgram();
+				glAttachShader(internalNormalProgram, normalHandle);
+				glLinkProgram(internalNormalProgram);
+			}
+			else
+				internalScene.hasComputeShaders = false;
+		}
+
+		// Default colormap for scalar fields (viridis-like)
+		_internalUploadColormap({
+			{ 0.267f, 0.005f, 0.329f },
+			{ 0.229f, 0.322f, 0.546f },
+			{ 0.128f, 0.567f, 0.551f },
+			{ 0.369f, 0.789f, 0.383f },
+			{ 0.993f, 0.906f, 0.144f }
+		});
+
+		// GPU timers
+		glGenQueries(2, internalScene.timerQueries);
+
+		// Fullscreen pass, copying a texture
+		const GLchar* blitVertexShaderSource =
+			"#version 330\n"
+			"out vec2 uv;\n"
+			"void main()\n"
+			"{\n"
+			"	uv = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+			"	gl_Position = vec4(uv * 2.0 - 1.0, 0.0, 1.0);\n"
+			"}\n";
+		const GLchar* blitFragmentShaderSource =
+			"#version 330\n"
+			"in vec2 uv;\n"
+			"uniform sampler2D uTexture;\n"
+			"out vec4 outFragmentColor;\n"
+			"void main()\n"
+			"{\n"
+			"	outFragmentColor = texture(uTexture, uv);\n"
+			"}\n";
+		GLuint blitVertHandle = _internalCompileShader(GL_VERTEX_SHADER, blitVertexShaderSource, "blit vertex shader");
+		GLuint blitFragHandle = _internalCompileShader(GL_FRAGMENT_SHADER, blitFragmentShaderSource, "blit fragment shader");
+		internalBlitProgram = glCreateProgram();
+		glAttachShader(internalBlitProgram, blitVertHandle);
+		glAttachShader(internalBlitProgram, blitFragHandle);
+		glLinkProgram(internalBlitProgram);
+		glGenVertexArrays(1, &internalFullscreenVao);
+
+		// Terrain: shared grid patches displaced by a height texture, morphing between levels of detail
+		const GLchar* terrainVertexShaderSource =
+			"#version 330\n"
+			"layout(location = 0) in vec2 inGrid;\n"
+			"uniform mat4 uProjection;\n"
+			"uniform mat4 uView;\n"
+			"uniform vec4 uNode;\n"
+			"uniform vec2 uMorph;\n"
+			"uniform vec3 uEye;\n"
+			"uniform float uGridResolution;\n"
+			"uniform vec3 uTerrainOrigin;\n"
+			"uniform vec3 uTerrainSize;\n"
+			"uniform sampler2D uHeightmap;\n"
+			"out vec3 fragNormal;\n"
+			"float height(vec2 p)\n"
+			"{\n"
+			"	vec2 uv = (p / uTerrainSize.x * (uTerrainSize.z - 1.0) + 0.5) / uTerrainSize.z;\n"
+			"	return textureLod(uHeightmap, uv, 0.0).r * uTerrainSize.y;\n"
+			"}\n"
+			"void main()\n"
+			"{\n"
+			"	vec2 p = uNode.xy + inGrid * uNode.z;\n"
+			"	float k = clamp((distance(uTerrainOrigin + vec3(p.x, height(p), p.y), uEye) - uMorph.x) / (uMorph.y - uMorph.x), 0.0, 1.0);\n"
+			"	vec2 grid = inGrid - fract(inGrid * uGridResolution * 0.5) * 2.0 / uGridResolution * k;\n"
+			"	p = uNode.xy + grid * uNode.z;\n"
+			"	float e = uTerrainSize.x / (uTerrainSize.z - 1.0);\n"
+			"	fragNormal = normalize(vec3(height(p - vec2(e, 0.0)) - height(p + vec2(e, 0.0)), 2.0 * e, height(p - vec2(0.0, e)) - height(p + vec2(0.0, e))));\n"
+			"	gl_Position = uProjection * uView * vec4(uTerrainOrigin + vec3(p.x, height(p), p.y), 1.0);\n"
+			"}\n";
+		const GLchar* terrainFragmentShaderSource =
+			"#version 330\n"
+			"in vec3 fragNormal;\n"
+			"uniform vec3 uLightDir;\n"
+			"uniform int uDoLighting;\n"
+			"out vec4 outFragmentColor;\n"
+			"void main()\n"
+			"{\n"
+			"	float d = uDoLighting == 1 ? 0.5 * (1.0 + dot(normalize(fragNormal), uLightDir)) : 1.0;\n"
+			"	outFragmentColor = vec4(vec3(0.7) * d, 1.0);\n"
+			"}\n";
+		GLuint terrainVertHandle = _internalCompileShader(GL_VERTEX_SHADER, terrainVertexShaderSource, "terrain vertex shader");
+		GLuint terrainFragHandle = _internalCompileShader(GL_FRAGMENT_SHADER, terrainFragmentShaderSource, "terrain fragment shader");
+		internalTerrainProgram = glCreateProgram();
+		glAttachShader(internalTerrainProgram, terrainVertHandle);
+		glAttachShader(internalTerrainProgram, terrainFragHandle);
+		glLinkProgram(internalTerrainProgram);
+
+		// Tessellation of PN triangles, with edge factors from their projected length, only available with GL 4.0
+		if (internalScene.hasTessellation)
+		{
+			const GLchar* tessVertexShaderSource =
+				"#version 400\n"
+				"layout(location = 0) in vec3 vertex;\n"
+				"layout(location = 1) in vec3 normal;\n"
+				"layout(location = 2) in vec3 color;\n"
+				"out vec3 vertPos;\n"
+				"out vec3 vertNormal;\n"
+				"out vec3 vertColor;\n"
+				"void main()\n"
+				"{\n"
+				"	vertPos = vertex;\n"
+				"	vertNormal = normalize(normal);\n"
+				"	vertColor = color;\n"
+				"}\n";
+			const GLchar* tessControlShaderSource =
+				"#version 400\n"
+				"layout(vertices = 3) out;\n"
+				"in vec3 vertPos[];\n"
+				"in vec3 vertNormal[];\n"
+				"in vec3 vertColor[];\n"
+				"out vec3 ctrlPos[];\n"
+				"out vec3 ctrlNormal[];\n"
+				"out vec3 ctrlColor[];\n"
+				"uniform mat4 uProjection;\n"
+				"uniform mat4 uView;\n"
+				"uniform mat4 uModel;\n"
+				"uniform vec2 uViewport;\n"
+				"uniform float uPixelsPerEdge;\n"
+				"// Projected diameter of the sphere around an edge, which does not depend on the patch, so shared edges match\n"
+				"float edgeLevel(vec3 a, vec3 b)\n"
+				"{\n"
+				"	vec3 wa = (uModel * vec4(a, 1.0)).xyz;\n"
+				"	vec3 wb = (uModel * vec4(b, 1.0)).xyz;\n"
+				"	float depth = max(-(uView * vec4(0.5 * (wa + wb), 1.0)).z, 1e-3);\n"
+				"	float pixels = distance(wa, wb) * uProjection[1][1] * 0.5 * uViewport.y / depth;\n"
+				"	return clamp(pixels / uPixelsPerEdge, 1.0, 64.0);\n"
+				"}\n"
+				"void main()\n"
+				"{\n"
+				"	ctrlPos[gl_InvocationID] = vertPos[gl_InvocationID];\n"
+				"	ctrlNormal[gl_InvocationID] = vertNormal[gl_InvocationID];\n"
+				"	ctrlColor[gl_InvocationID] = vertColor[gl_InvocationID];\n"
+				"	if (gl_InvocationID == 0) {\n"
+				"		gl_TessLevelOuter[0] = edgeLevel(vertPos[1], vertPos[2]);\n"
+				"		gl_TessLevelOuter[1] = edgeLevel(vertPos[2], vertPos[0]);\n"
+				"		gl_TessLevelOuter[2] = edgeLevel(vertPos[0], vertPos[1]);\n"
+				"		gl_TessLevelInner[0] = max(gl_TessLevelOuter[0], max(gl_TessLevelOuter[1], gl_TessLevelOuter[2]));\n"
+				"	}\n"
+				"}\n";
+			const GLchar* tessEvaluationShaderSource =
+				"#version 400\n"
+				"layout(triangles, fractional_odd_spacing, ccw) in;\n"
+				"in vec3 ctrlPos[];\n"
+				"in vec3 ctrlNormal[];\n"
+				"in vec3 ctrlColor[];\n"
+				"out vec3 fragPos;\n"
+				"out vec3 fragNormal;\n"
+				"out vec3 fragColor;\n"
+				"uniform mat4 uProjection;\n"
+				"uniform mat4 uView;\n"
+				"uniform mat4 uModel;\n"
+				"uniform sampler2D uDisplacement;\n"
+				"uniform float uAmplitude;\n"
+				"uniform float uTiling;\n"
+				"vec3 edgePoint(int i, int j) { return (2.0 * ctrlPos[i] + ctrlPos[j] - dot(ctrlPos[j] - ctrlPos[i], ctrlNormal[i]) * ctrlNormal[i]) / 3.0; }\n"
+				"vec3 edgeNormal(int i, int j)\n"
+				"{\n"
+				"	vec3 e = ctrlPos[j] - ctrlPos[i];\n"
+				"	float v = 2.0 * dot(e, ctrlNormal[i] + ctrlNormal[j]) / max(dot(e, e), 1e-12);\n"
+				"	return normalize(ctrlNormal[i] + ctrlNormal[j] - v * e);\n"
+				"}\n"
+				"float height(vec3 p, vec3 n)\n"
+				"{\n"
+				"	vec3 w = pow(abs(n), vec3(4.0));\n"
+				"	w /= w.x + w.y + w.z;\n"
+				"	return w.x * textureLod(uDisplacement, p.yz * uTiling, 0.0).r + w.y * textureLod(uDisplacement, p.xz * uTiling, 0.0).r + w.z * textureLod(uDisplacement, p.xy * uTiling, 0.0).r;\n"
+				"}\n"
+				"void main()\n"
+				"{\n"
+				"	float u = gl_TessCoord.x, v = gl_TessCoord.y, w = gl_TessCoord.z;\n"
+				"	vec3 b210 = edgePoint(0, 1), b120 = edgePoint(1, 0), b021 = edgePoint(1, 2);\n"
+				"	vec3 b012 = edgePoint(2, 1), b102 = edgePoint(2, 0), b201 = edgePoint(0, 2);\n"
+				"	vec3 e = (b210 + b120 + b021 + b012 + b102 + b201) / 6.0;\n"
+				"	vec3 b111 = e + 0.5 * (e - (ctrlPos[0] + ctrlPos[1] + ctrlPos[2]) / 3.0);\n"
+				"	vec3 p = ctrlPos[0] * u * u * u + ctrlPos[1] * v * v * v + ctrlPos[2] * w * w * w\n"
+				"		+ 3.0 * (b210 * u * u * v + b120 * u * v * v + b201 * u * u * w + b021 * v * v * w + b102 * u * w * w + b012 * v * w * w)\n"
+				"		+ 6.0 * b111 * u * v * w;\n"
+				"	vec3 n = normalize(ctrlNormal[0] * u * u + ctrlNormal[1] * v * v + ctrlNormal[2] * w * w\n"
+				"		+ edgeNormal(0, 1) * u * v + edgeNormal(1, 2) * v * w + edgeNormal(2, 0) * w * u);\n"
+				"	if (uAmplitude != 0.0)\n"
+				"		p += n * uAmplitude * height(p, n);\n"
+				"	fragPos = p;\n"
+				"	fragNormal = n;\n"
+				"	fragColor = ctrlColor[0] * u + ctrlColor[1] * v + ctrlColor[2] * w;\n"
+				"	gl_Position = uProjection * uView * uModel * vec4(p, 1.0);\n"
+				"}\n";
+			const GLchar* tessFragmentShaderSource =
+				"#version 400\n"
+				"in vec3 fragPos;\n"
+				"in vec3 fragNormal;\n"
+				"in vec3 fragColor;\n"
+				"uniform vec3 uLightDir;\n"
+				"uniform int uDoLighting;\n"
+				"uniform float uAmplitude;\n"
+				"out vec4 outFragmentColor;\n"
+				"void main()\n"
+				"{\n"
+				"	// Displaced surfaces are shaded with the normal of the tessellated triangles\n"
+				"	vec3 n = uAmplitude != 0.0 ? normalize(cross(dFdx(fragPos), dFdy(fragPos))) : normalize(fragNormal);\n"
+				"	float d = uDoLighting == 1 ? 0.5 * (1.0 + dot(n, uLightDir)) : 1.0;\n"
+				"	outFragmentColor = vec4(fragColor * d, 1.0);\n"
+				"}\n";
+			GLuint tessVertHandle = _internalCompileShader(GL_VERTEX_SHADER, tessVertexShaderSource, "tessellation vertex shader");
+			GLuint tessControlHandle = _internalCompileShader(GL_TESS_CONTROL_SHADER, tessControlShaderSource, "tessellation control shader");
+			GLuint tessEvaluationHandle = _internalCompileShader(GL_TESS_EVALUATION_SHADER, tessEvaluationShaderSource, "tessellation evaluation shader");
+			GLuint tessFragHandle = _internalCompileShader(GL_FRAGMENT_SHADER, tessFragmentShaderSource, "tessellation fragment shader");
+			if (tessVertHandle != 0 && tessControlHandle != 0 && tessEvaluationHandle != 0 && tessFragHandle != 0)
+			{
+				internalTessellationProgram = glCreateProgram();
+				glAttachShader(internalTessellationProgram, tessVertHandle);
+				glAttachShader(internalTessellationProgram, tessControlHandle);
+				glAttachShader(internalTessellationProgram, tessEvaluationHandle);
+				glAttachShader(internalTessellationProgram, tessFragHandle);
+				glLinkProgram(internalTessellationProgram);
+			}
+			else
+				internalScene.hasTessellation = false;
+		}
+
+		// Signed distance fields: sphere tracing of a postfix CSG program or of a sampled volume, inside a proxy box
+		const GLchar* sdfVertexShaderSource =
+			"#version 330\n"
+			"layout(location = 0) in vec3 inCorner;\n"
+			"uniform mat4 uProjection;\n"
+			"uniform mat4 uView;\n"
+			"uniform mat4 uModel;\n"
+			"uniform vec3 uBoundsMin;\n"
+			"uniform vec3 uBoundsMax;\n"
+			"out vec3 fragLocalPos;\n"
+			"void main()\n"
+			"{\n"
+			"	fragLocalPos = uBoundsMin + inCorner * (uBoundsMax - uBoundsMin);\n"
+			"	gl_Position = uProjection * uView * uModel * vec4(fragLocalPos, 1.0);\n"
+			"}\n";
+		const GLchar* sdfFragmentShaderSource =
+			"#version 330\n"
+			"in vec3 fragLocalPos;\n"
+			"uniform mat4 uProjection;\n"
+			"uniform mat4 uView;\n"
+			"uniform mat4 uModel;\n"
+			"uniform vec3 uLocalEye;\n"
+			"uniform vec3 uBoundsMin;\n"
+			"uniform vec3 uBoundsMax;\n"
+			"uniform vec3 uColor;\n"
+			"uniform float uPixelRadius;\n"
+			"uniform int uInstructionCount;\n"
+			"uniform samplerBuffer uProgram;\n"
+			"uniform sampler3D uVolume;\n"
+			"uniform float uResolution;\n"
+			"uniform vec3 uLightDir;\n"
+			"uniform int uDoLighting;\n"
+			"out vec4 outFragmentColor;\n"
+			"vec4 field(vec3 p)\n"
+			"{\n"
+			"	if (uInstructionCount == 0) {\n"
+			"		// Samples are at texel centers: the first and last ones lie on the bounds\n"
+			"		vec3 uv = (p - uBoundsMin) / (uBoundsMax - uBoundsMin);\n"
+			"		return vec4(texture(uVolume, (uv * (uResolution - 1.0) + 0.5) / uResolution).r, uColor);\n"
+			"	}\n"
+			"	vec4 stack[16];\n"
+			"	int size = 0;\n"
+			"	for (int i = 0; i < uInstructionCount; i++) {\n"
+			"		vec4 a = texelFetch(uProgram, 4 * i);\n"
+			"		int op = int(a.x);\n"
+			"		if (op < 4) {\n"
+			"			vec3 q = p - texelFetch(uProgram, 4 * i + 1).xyz;\n"
+			"			vec3 s = texelFetch(uProgram, 4 * i + 2).xyz;\n"
+			"			float d;\n"
+			"			if (op == 0) d = length(q) - s.x;\n"
+			"			else if (op == 1) { vec3 b = abs(q) - s; d = length(max(b, 0.0)) + min(max(b.x, max(b.y, b.z)), 0.0); }\n"
+			"			else if (op == 2) d = length(vec2(length(q.xz) - s.x, q.y)) - s.y;\n"
+			"			else { vec2 w = abs(vec2(length(q.xz), q.y)) - s.xy; d = min(max(w.x, w.y), 0.0) + length(max(w, 0.0)); }\n"
+			"			stack[size++] = vec4(d, texelFetch(uProgram, 4 * i + 3).xyz);\n"
+			"		} else {\n"
+			"			vec4 r = stack[--size];\n"
+			"			vec4 l = stack[--size];\n"
+			"			float k = max(a.y, 1e-6);\n"
+			"			if (op == 4) { float h = clamp(0.5 + 0.5 * (r.x - l.x) / k, 0.0, 1.0); stack[size++] = vec4(mix(r.x, l.x, h) - k * h * (1.0 - h), mix(r.yzw, l.yzw, h)); }\n"
+			"			else if (op == 5) { float h = clamp(0.5 - 0.5 * (r.x + l.x) / k, 0.0, 1.0); stack[size++] = vec4(mix(l.x, -r.x, h) + k * h * (1.0 - h), l.yzw); }\n"
+			"			else { float h = clamp(0.5 - 0.5 * (r.x - l.x) / k, 0.0, 1.0); stack[size++] = vec4(mix(r.x, l.x, h) + k * h * (1.0 - h), mix(r.yzw, l.yzw, h)); }\n"
+			"		}\n"
+			"	}\n"
+			"	return stack[0];\n"
+			"}\n"
+			"void main()\n"
+			"{\n"
+			"	vec3 ro = uLocalEye;\n"
+			"	vec3 rd = normalize(fragLocalPos - ro);\n"
+			"	vec3 t0 = (uBoundsMin - ro) / rd, t1 = (uBoundsMax - ro) / rd;\n"
+			"	vec3 tMin = min(t0, t1);\n"
+			"	float t = max(max(max(tMin.x, tMin.y), tMin.z), 0.0);\n"
+			"	float tFar = distance(ro, fragLocalPos);\n"
+			"	vec4 f = vec4(1.0);\n"
+			"	bool isHit = false;\n"
+			"	for (int i = 0; i < 128 && t <= tFar; i++) {\n"
+			"		f = field(ro + rd * t);\n"
+			"		// Cone tracing: stop once the distance is below the footprint of the pixel cone\n"
+			"		if (f.x < uPixelRadius * t) { isHit = true; break; }\n"
+			"		t += f.x;\n"
+			"	}\n"
+			"	if (!isHit)\n"
+			"		discard;\n"
+			"	vec3 p = ro + rd * t;\n"
+			"	float e = max(uPixelRadius * t, 1e-4);\n"
+			"	vec2 k = vec2(1.0, -1.0);\n"
+			"	vec3 n = k.xyy * field(p + k.xyy * e).x + k.yyx * field(p + k.yyx * e).x + k.yxy * field(p + k.yxy * e).x + k.xxx * field(p + k.xxx * e).x;\n"
+			"	n = normalize(transpose(inverse(mat3(uModel))) * n);\n"
+			"	float d = uDoLighting == 1 ? 0.5 * (1.0 + dot(n, uLightDir)) : 1.0;\n"
+			"	outFragmentColor = vec4(f.yzw * d, 1.0);\n"
+			"	vec4 clip = uProjection * uView * uModel * vec4(p, 1.0);\n"
+			"	gl_FragDepth = 0.5 * clip.z / clip.w + 0.5;\n"
+			"}\n";
+		GLuint sdfVertHandle = _internalCompileShader(GL_VERTEX_SHADER, sdfVertexShaderSource, "sdf vertex shader");
+		GLuint sdfFragHandle = _internalCompileShader(GL_FRAGMENT_SHADER, sdfFragmentShaderSource, "sdf fragment shader");
+		internalSdfProgram = glCreateProgram();
+		glAttachShader(internalSdfProgram, sdfVertHandle);
+		glAttachShader(internalSdfProgram, sdfFragHandle);
+		glLinkProgram(internalSdfProgram);
+
+		// Post-process anti-aliasing: FXAA, and a morphological filter in the spirit of SMAA
+		const GLchar* fxaaFragmentShaderSource =
+			"#version 330\n"
+			"in vec2 uv;\n"
+			"uniform sampler2D uTexture;\n"
+			"uniform vec2 uTexelSize;\n"
+			"out vec4 outFragmentColor;\n"
+			"float luma(vec3 c) { return dot(c, vec3(0.299, 0.587, 0.114)); }\n"
+			"void main()\n"
+			"{\n"
+			"	vec3 rgbNW = texture(uTexture, uv + vec2(-1.0, -1.0) * uTexelSize).rgb;\n"
+			"	vec3 rgbNE = texture(uTexture, uv + vec2(1.0, -1.0) * uTexelSize).rgb;\n"
+			"	vec3 rgbSW = texture(uTexture, uv + vec2(-1.0, 1.0) * uTexelSize).rgb;\n"
+			"	vec3 rgbSE = texture(uTexture, uv + vec2(1.0, 1.0) * uTexelSize).rgb;\n"
+			"	vec3 rgbM = texture(uTexture, uv).rgb;\n"
+			"	float lumaNW = luma(rgbNW), lumaNE = luma(rgbNE), lumaSW = luma(rgbSW), lumaSE = luma(rgbSE), lumaM = luma(rgbM);\n"
+			"	float lumaMin = min(lumaM, min(min(lumaNW, lumaNE), min(lumaSW, lumaSE)));\n"
+			"	float lumaMax = max(lumaM, max(max(lumaNW, lumaNE), max(lumaSW, lumaSE)));\n"
+			"	vec2 dir = vec2(-((lumaNW + lumaNE) - (lumaSW + lumaSE)), (lumaNW + lumaSW) - (lumaNE + lumaSE));\n"
+			"	float dirReduce = max((lumaNW + lumaNE + lumaSW + lumaSE) * 0.03125, 1.0 / 128.0);\n"
+			"	float rcpDirMin = 1.0 / (min(abs(dir.x), abs(dir.y)) + dirReduce);\n"
+			"	dir = clamp(dir * rcpDirMin, vec2(-8.0), vec2(8.0)) * uTexelSize;\n"
+			"	vec3 rgbA = 0.5 * (texture(uTexture, uv + dir * (1.0 / 3.0 - 0.5)).rgb + texture(uTexture, uv + dir * (2.0 / 3.0 - 0.5)).rgb);\n"
+			"	vec3 rgbB = rgbA * 0.5 + 0.25 * (texture(uTexture, uv - dir * 0.5).rgb + texture(uTexture, uv + dir * 0.5).rgb);\n"
+			"	float lumaB = luma(rgbB);\n"
+			"	outFragmentColor = vec4((lumaB < lumaMin || lumaB > lumaMax) ? rgbA : rgbB, 1.0);\n"
+			"}\n";
+		const GLchar* smaaEdgesFragmentShaderSource =
+			"#version 330\n"
+			"in vec2 uv;\n"
+			"uniform sampler2D uTexture;\n"
+			"uniform vec2 uTexelSize;\n"
+			"out vec4 outFragmentColor;\n"
+			"float luma(vec3 c) { return dot(c, vec3(0.299, 0.587, 0.114)); }\n"
+			"void main()\n"
+			"{\n"
+			"	float l = luma(texture(uTexture, uv).rgb);\n"
+			"	float left = luma(texture(uTexture, uv - vec2(uTexelSize.x, 0.0)).rgb);\n"
+			"	float bottom = luma(texture(uTexture, uv - vec2(0.0, uTexelSize.y)).rgb);\n"
+			"	outFragmentColor = vec4(step(0.1, abs(l - left)), step(0.1, abs(l - bottom)), 0.0, 1.0);\n"
+			"}\n";
+		const GLchar* smaaBlendFragmentShaderSource =
+			"#version 330\n"
+			"in vec2 uv;\n"
+			"uniform sampler2D uTexture;\n"
+			"uniform sampler2D uEdges;\n"
+			"uniform vec2 uTexelSize;\n"
+			"out vec4 outFragmentColor;\n"
+			"float edgeAt(vec2 p, int c) { return texture(uEdges, p)[c]; }\n"
+			"// Blend weight across an edge, from the distance to both ends of the edge line (triangle coverage)\n"
+			"float weight(vec2 p, vec2 along, int c)\n"
+			"{\n"
+			"	float d0 = 0.0, d1 = 0.0;\n"
+			"	for (int i = 1; i <= 8; i++) { if (edgeAt(p - along * float(i), c) < 0.5) break; d0 += 1.0; }\n"
+			"	for (int i = 1; i <= 8; i++) { if (edgeAt(p + along * float(i), c) < 0.5) break; d1 += 1.0; }\n"
+			"	float len = d0 + d1 + 1.0;\n"
+			"	return len < 2.0 ? 0.0 : 0.5 * max(0.0, 1.0 - 2.0 * (min(d0, d1) + 0.5) / len);\n"
+			"}\n"
+			"void main()\n"
+			"{\n"
+			"	vec2 dx = vec2(uTexelSize.x, 0.0), dy = vec2(0.0, uTexelSize.y);\n"
+			"	vec3 c = texture(uTexture, uv).rgb;\n"
+			"	vec3 sum = c;\n"
+			"	float total = 1.0;\n"
+			"	if (edgeAt(uv, 0) > 0.5) { float w = weight(uv, dy, 0); sum += w * texture(uTexture, uv - dx).rgb; total += w; }\n"
+			"	if (edgeAt(uv + dx, 0) > 0.5) { float w = weight(uv + dx, dy, 0); sum += w * texture(uTexture, uv + dx).rgb; total += w; }\n"
+			"	if (edgeAt(uv, 1) > 0.5) { float w = weight(uv, dx, 1); sum += w * texture(uTexture, uv - dy).rgb; total += w; }\n"
+			"	if (edgeAt(uv + dy, 1) > 0.5) { float w = weight(uv + dy, dx, 1); sum += w * texture(uTexture, uv + dy).rgb; total += w; }\n"
+			"	outFragmentColor = vec4(sum / total, 1.0);\n"
+			"}\n";
+		GLuint* postPrograms[3] = { &internalFxaaProgram, &internalSmaaEdgesProgram, &internalSmaaBlendProgram };
+		const GLchar* postSources[3] = { fxaaFragmentShaderSource, smaaEdgesFragmentShaderSource, smaaBlendFragmentShaderSource };
+		for (int i = 0; i < 3; i++)
+		{
+			GLuint fragHandle = _internalCompileShader(GL_FRAGMENT_SHADER, postSources[i], "post-process fragment shader");
+			*postPrograms[i] = glCreateProgram();
+			glAttachShader(*postPrograms[i], blitVertHandle);
+			glAttachShader(*postPrograms[i], fragHandle);
+			glLinkProgram(*postPrograms[i]);
+		}
+
+		// Imgui
+		IMGUI_CHECKVERSION();
+		ImGui::CreateContext();
+		ImGui_ImplGlfw_InitForOpenGL(windowPtr, true);
+		ImGui_ImplOpenGL3_Init("#version 330");
+	}
+
+	/*!
+	\brief Returns true of the user closed the window or pressed escape, and false otherwise.
+	*/
+	bool shouldQuit()
+	{
+		return glfwWindowShouldClose(windowPtr) || glfwGetKey(windowPtr, GLFW_KEY_ESCAPE);
+	}
+
+	/*
+	\brief Check if a given key has been pressed in the last frame.
+	\param key the key
+	*/
+	bool getKey(int key)
+	{
+		return bool(glfwGetKey(windowPtr, key));
+	}
+
+	/*!
+	\brief Returns the current delta time between two frames.
+	*/
+	float deltaTime()
+	{
+		return internalScene.deltaTime;
+	}
+
+	/*!
+	\brief Returns the elapsed time since window initialiazation.
+	*/
+	float globalTime()
+	{
+		return float(glfwGetTime());
+	}
+
+	/*
+	\brief Update function. Applies camera movements.
+	*/
+	void update()
+	{
+		float currentFrame = float(glfwGetTime());
+		internalScene.deltaTime = currentFrame - internalScene.lastFrame;
+		internalScene.lastFrame = currentFrame;
+
+		// Keyboard
+		float x = 0.0f, y = 0.0f, z = 0.0f, xPlane = 0.0f, yPlane = 0.0f;
+		if (glfwGetKey(windowPtr, GLFW_KEY_LEFT))
+			x -= 0.1f;
+		if (glfwGetKey(windowPtr, GLFW_KEY_RIGHT))
+			x += 0.1f;
+		if (glfwGetKey(windowPtr, GLFW_KEY_UP))
+			y += 0.1f;
+		if (glfwGetKey(windowPtr, GLFW_KEY_DOWN))
+			y -= 0.1f;
+		if (glfwGetKey(windowPtr, GLFW_KEY_PAGE_UP))
+			z += 0.1f;
+		if (glfwGetKey(windowPtr, GLFW_KEY_PAGE_DOWN))
+			z -= 0.1f;
+
+		// Mouse
+		double xpos, ypos;
+		glfwGetCursorPos(windowPtr, &xpos, &ypos);
+		int state = glfwGetMouseButton(windowPtr, GLFW_MOUSE_BUTTON_LEFT);
+		if (state == GLFW_PRESS && !internalScene.isMouseOverGui)
+		{
+			float xoffset = float(xpos) - internalScene.mouseLastX;
+
+			// Reversed since y-coordinates go from bottom to top
+			float yoffset = internalScene.mouseLastY - float(ypos);
+			x += (xoffset * internalScene.mouseSensitivity);
+			y += (yoffset * internalScene.mouseSensitivity);
+		}
+		state = glfwGetMouseButton(windowPtr, GLFW_MOUSE_BUTTON_MIDDLE);
+		if (state == GLFW_PRESS && !internalScene.isMouseOverGui)
+		{
+			float xoffset = float(xpos) - internalScene.mouseLastX;
+			float yoffset = float(ypos) - internalScene.mouseLastY;
+			xPlane += (xoffset * internalScene.mouseSensitivity);
+			yPlane += (yoffset * internalScene.mouseSensitivity);
+		}
+
+		// Scale speed based on distance to the look at point
+		float scale = internalLength(internalScene.at - internalScene.eye);
+		scale = scale > 100.0f ? 100.0f : scale;
+		x *= scale * internalScene.camSpeed * 0.55f;
+		y *= scale * internalScene.camSpeed * 0.55f;
+		z *= scale * internalScene.camSpeed * 0.025f;
+		xPlane *= scale * internalScene.camSpeed;
+		yPlane *= scale * internalScene.camSpeed;
+
+		// Apply everything
+		_internalCameraMove(x, y, z, xPlane, yPlane);
+
+		// Store last mouse pos
+		internalScene.mouseLastX = float(xpos);
+		internalScene.mouseLastY = float(ypos);
+
+		// Idle frame counter for the frame budget controller
+		internalScene.idleFrames = internalScene.cameraMoved ? 0 : internalScene.idleFrames + 1;
+		internalScene.cameraMoved = false;
+
+		// Streamed animations
+		_internalUpdateTimeSeries();
+
+		// Out-of-core objects
+		_internalUpdateResidency();
+
+		// Ambient occlusion bakes
+		_internalUpdateBakes();
+
+		// Edited voxel chunks
+		_internalUpdateVoxelVolumes();
+
+		// Queued anti-aliasing benchmark
+		_internalUpdateAntiAliasingBenchmark();
+	}
+
+	/*!
+	\brief Performs rendering and swap window buffers.
+	*/
+	void render()
+	{
+		// World transforms of the scene graph
+		_internalUpdateTransforms();
+
+		// Render resolution: lower than the window when the frame budget is exceeded
+		int renderWidth = width_internal, renderHeight = height_internal;
+		if (internalScene.dynamicResolution && internalScene.resolutionScale < 1.0f)
+		{
+			renderWidth = std::max(1, int(float(width_internal) * internalScene.resolutionScale));
+			renderHeight = std::max(1, int(float(height_internal) * internalScene.resolutionScale));
+		}
+		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
+
+		// Camera matrices
+		float viewMatrix[4][4] = { 0 }, projectionMatrix[4][4] = { 0 };
+		_internalCameraLookAt(viewMatrix);
+		_internalCameraPerspective(projectionMatrix, width_internal, height_internal);
+
+		// Progressive accumulation: when nothing changed, jittered samples are averaged into a history buffer
+		const bool isStatic = _internalIsStaticFrame();
+		const bool accumulate = internalAccumulation.isEnabled && isStatic && renderWidth == width_internal && renderHeight == height_internal;
+		if (!accumulate)
+			internalAccumulation.sampleCount = 0;
+
+		// Render all objects, timed on the GPU
+		const int query = internalScene.frameIndex % 2;
+		glBeginQuery(GL_TIME_ELAPSED, internalScene.timerQueries[query]);
+		if (accumulate && internalAccumulation.sampleCount < internalAccumulation.maxSamples)
+		{
+			// The first sample is not jittered, so that the image is unchanged when accumulation starts
+			const int n = internalAccumulation.sampleCount;
+			const float jitterX = n == 0 ? 0.0f : _internalHalton(n, 2) - 0.5f;
+			const float jitterY = n == 0 ? 0.0f : _internalHalton(n, 3) - 0.5f;
+			_internalCameraPerspective(projectionMatrix, width_internal, height_internal, jitterX, jitterY);
+
+			_internalResizeFramebuffer(internalSceneTarget, width_internal, height_internal);
+			glBindFramebuffer(GL_FRAMEBUFFER, internalSceneTarget.fbo);
+			glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+			_internalRenderScene(viewMatrix, projectionMatrix, width_internal, height_internal);
+
+			// Running average: history = history + (sample - history) / (n + 1)
+			_internalResizeFramebuffer(internalAccumulation.history, width_internal, height_internal, GL_RGBA32F);
+			glBindFramebuffer(GL_FRAMEBUFFER, internalAccumulation.history.fbo);
+			glEnable(GL_BLEND);
+			glBlendColor(0.0f, 0.0f, 0.0f, 1.0f / float(n + 1));
+			glBlendFunc(GL_CONSTANT_ALPHA, GL_ONE_MINUS_CONSTANT_ALPHA);
+			_internalDrawFullscreen(internalSceneTarget.color);
+			glDisable(GL_BLEND);
+			internalAccumulation.sampleCount++;
+		}
+		else if (!accumulate)
+			_internalRenderAntiAliased(viewMatrix, projectionMatrix, renderWidth, renderHeight, 0, width_internal, height_internal);
+		glEndQuery(GL_TIME_ELAPSED);
+
+		// Converged samples are simply copied to the screen
+		if (accumulate)
+		{
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, internalAccumulation.history.fbo);
+			glBindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+			glBlitFramebuffer(0, 0, width_internal, height_internal, 0, 0, width_internal, height_internal, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+			glBindFramebuffer(GL_FRAMEBUFFER, 0);
+		}
+
+		// Read the timer of the previous frame, and adapt the resolution to the frame budget
+		GLint isAvailable = 0;
+		if (internalScene.frameIndex > 0)
+			glGetQueryObjectiv(internalScene.timerQueries[1 - query], GL_QUERY_RESULT_AVAILABLE, &isAvailable);
+		if (isAvailable)
+		{
+			GLuint64 elapsed = 0;
+			glGetQueryObjectui64v(internalScene.timerQueries[1 - query], GL_QUERY_RESULT, &elapsed);
+			internalScene.gpuFrameTime = float(double(elapsed) / 1e6);
+		}
+		internalScene.frameIndex++;
+		_internalUpdateResolutionScale();
+
+		// Prepare imgui frame for later
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui_ImplGlfw_NewFrame();
+		ImGui::NewFrame();
+
+		// Internal imgui
+		{
+			ImGui::Begin("Rendering");
+			internalScene.isMouseOverGui = ImGui::IsWindowHovered() || ImGui::IsAnyItemHovered();
+			if (ImGui::Checkbox("Lighting", &internalScene.doLighting))
+				setDoLighting(internalScene.doLighting);
+			if (ImGui::Checkbox("Wireframe", &internalScene.drawWireframe))
+				setDrawWireframe(internalScene.drawWireframe);
+			if (ImGui::SliderFloat("Wireframe thickness", &internalScene.wireframeThickness, 1.0f, 2.0f))
+				setWireframeThickness(internalScene.wireframeThickness);
+			if (ImGui::Checkbox("Show Normals", &internalScene.showNormals))
+				setShowNormals(internalScene.showNormals);
+			if (ImGui::Checkbox("Dynamic resolution", &internalScene.dynamicResolution))
+				internalScene.resolutionScale = 1.0f;
+			if (internalScene.dynamicResolution)
+			{
+				ImGui::SliderFloat("Frame budget (ms)", &internalScene.frameBudget, 2.0f, 50.0f);
+				ImGui::Checkbox("Simplify while moving", &internalScene.simplifyWhileMoving);
+			}
+			const char* antialiasingNames[] = { "None", "FXAA", "SMAA", "MSAA 2x", "MSAA 4x", "MSAA 8x" };
+			int antialiasingIndex = int(internalScene.antialiasingMode);
+			if (ImGui::Combo("Anti-aliasing", &antialiasingIndex, antialiasingNames, 6))
+				setAntiAliasing(antialiasing(antialiasingIndex));
+			if (internalBenchmark.isRunning)
+				ImGui::Text("Benchmarking anti-aliasing: %d/12", internalBenchmark.step);
+			else if (ImGui::Button("Benchmark anti-aliasing"))
+				benchmarkAntiAliasing(60);
+			if (internalBenchmark.results[0][0] > 0.0f)
+			{
+				for (int m = 0; m < 6; m++)
+				{
+					if (internalBenchmark.results[0][m] < 0.0f)
+						ImGui::Text("%-8s skipped, not supported", antialiasingNames[m]);
+					else
+						ImGui::Text("%-8s 1080p %6.3f ms, 4K %6.3f ms", antialiasingNames[m], internalBenchmark.results[0][m], internalBenchmark.results[1][m]);
+				}
+			}
+			ImGui::Checkbox("Progressive anti-aliasing", &internalAccumulation.isEnabled);
+			if (internalAccumulation.isEnabled)
+				ImGui::Text("%d/%d samples", internalAccumulation.sampleCount, internalAccumulation.maxSamples);
+			ImGui::Text("Light direction");
+			ImGui::DragFloat("x", &internalScene.lightDir.x, 0.1f, -1.0f, 1.0f);
+			ImGui::DragFloat("y", &internalScene.lightDir.y, 0.1f, -1.0f, 1.0f);
+			ImGui::DragFloat("z", &internalScene.lightDir.z, 0.1f, -1.0f, 1.0f);
+
+			ImGui::Separator();
+			ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / float(ImGui::GetIO().Framerate), float(ImGui::GetIO().Framerate));
+			ImGui::Text("%.3f ms GPU, %d%% resolution", internalScene.gpuFrameTime, int(100.0f * internalScene.resolutionScale));
+			if (internalClusters.lightCount > 0)
+			{
+				ImGui::Text("%d point lights: %.3f ms binning", internalClusters.lightCount, internalClusters.buildTimeMs);
+				ImGui::Text("Lights per cluster: %.1f avg, %d max, %d truncated", internalClusters.averageLightsPerCluster, internalClusters.maxLightsPerCluster, internalClusters.truncatedClusters);
+			}
+			ImGui::Checkbox("Occlusion culling", &internalOcclusion.isEnabled);
+			if (internalOcclusion.isEnabled)
+				ImGui::Text("%d occluders: %.3f ms, %d objects culled", internalOcclusion.occluderCount, internalOcclusion.buildTimeMs, internalOcclusion.culledCount);
+			for (int t = 0; t < int(internalTerrains.size()); t++)
+			{
+				if (!internalTerrains[t].isDeleted)
+					ImGui::Text("Terrain %d: %d nodes, %d triangles", t, internalTerrains[t].nodesDrawn, internalTerrains[t].trianglesDrawn);
+			}
+			if (internalMeshletsTotal > 0)
+				ImGui::Text("Meshlets: %d/%d drawn", internalMeshletsDrawn, internalMeshletsTotal);
+			if (!internalResidency.objects.empty())
+				ImGui::Text("Out-of-core: %.1f/%.1f MB resident, %d evictions", float(internalResidency.residentBytes) / 1048576.0f, float(internalResidency.budget) / 1048576.0f, internalResidency.evictions);
+			for (const auto& series : internalTimeSeries)
+				ImGui::Text("Time series %d: frame %d/%d, %d dropped", series->objectId, series->displayedFrame, series->frameCount, series->droppedFrames);
+			for (int v = 0; v < int(internalVoxelVolumes.size()); v++)
+			{
+				if (!internalVoxelVolumes[v].isDeleted)
+					ImGui::Text("Voxel volume %d: %d chunks remeshed in %.2f ms", v, internalVoxelVolumes[v].remeshedChunks, internalVoxelVolumes[v].remeshTimeMs);
+			}
+			for (const auto& bake : internalBakes)
+			{
+				// The ray count is written by the worker thread
+				int rayCount = 0;
+				{
+					std::lock_guard<std::mutex> lock(bake->mutex);
+					rayCount = bake->rayCount;
+				}
+				ImGui::Text("Ambient occlusion %d: %d/%d rays", bake->objectId, rayCount, bake->rays);
+			}
+
+			ImGui::End();
+		}
+	}
+
+	/*!
+	\brief End the current frame. Must be called after update, render, and
+	custom dear imgui calls.
+	*/
+	void swap()
+	{
+		ImGui::EndFrame();
+		ImGui::Render();
+		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+
+		glfwSwapBuffers(windowPtr);
+		glfwPollEvents();
+	}
+
+	/*!
+	\brief Free allocated data and terminate window context.
+	*/
+	void terminate()
+	{
+		_internalClearScene();
+		glDeleteBuffers(1, &internalResidency.placeholder.buffers);
+		glDeleteBuffers(1, &internalResidency.placeholder.triangleBuffer);
+		glDeleteVertexArrays(1, &internalResidency.placeholder.vao);
+		internalResidency.placeholder = object_internal();
+		if (internalClusters.lightBuffer != 0)
+		{
+			GLuint buffers[3] = { internalClusters.lightBuffer, internalClusters.gridBuffer, internalClusters.indexBuffer };
+			GLuint textures[3] = { internalClusters.lightTexture, internalClusters.gridTexture, internalClusters.indexTexture };
+			glDeleteBuffers(3, buffers);
+			glDeleteTextures(3, textures);
+		}
+		internalClusters = clusters_internal();
+		_internalDeleteFramebuffer(internalSceneTarget);
+		_internalDeleteFramebuffer(internalAccumulation.history);
+		glDeleteProgram(internalBlitProgram);
+		glDeleteProgram(internalFxaaProgram);
+		glDeleteProgram(internalSmaaEdgesProgram);
+		glDeleteProgram(internalSmaaBlendProgram);
+		_internalDeleteFramebuffer(internalMultisampleTarget);
+		_internalDeleteFramebuffer(internalEdgesTarget);
+		_internalDeleteFramebuffer(internalBenchmark.output);
+		if (internalBenchmark.query != 0)
+			glDeleteQueries(1, &internalBenchmark.query);
+		internalBenchmark = benchmark_internal();
+		glDeleteVertexArrays(1, &internalFullscreenVao);
+		glDeleteQueries(2, internalScene.timerQueries);
+		glDeleteTextures(1, &internalColormapTexture);
+		internalColormapTexture = 0;
+		if (internalNormalProgram != 0)
+			glDeleteProgram(internalNormalProgram);
+		internalNormalProgram = 0;
+		glDeleteBuffers(1, &internalTerrainPatch.vertexBuffer);
+		glDeleteBuffers(1, &internalTerrainPatch.indexBuffer);
+		glDeleteVertexArrays(1, &internalTerrainPatch.vao);
+		internalTerrainPatch = terrain_patch_internal();
+		glDeleteProgram(internalTerrainProgram);
+		glDeleteBuffers(2, internalSdfBoxBuffers);
+		glDeleteVertexArrays(1, &internalSdfBoxVao);
+		internalSdfBoxVao = 0;
+		glDeleteProgram(internalSdfProgram);
+		if (internalTessellationProgram != 0)
+			glDeleteProgram(internalTessellationProgram);
+		internalTessellationProgram = 0;
+		glfwTerminate();
+	}
+
+
+	/*!
+	\brief Add an object to the internal hierarchy. The object must be initialized in a specific way.
+	Vertex and normal arrays should be of the same size, and the triangle array refers to both vertex and normal indices.
+	Colors are optionals and will be set to grey by default.
+	\param object new object with properly initialized vectors.
+	\returns the id of the object in the hierarchy.
+	*/
+	int addObject(const object& obj)
+	{
+		internalScene.sceneVersion++;
+		object_internal internalObject = obj.triangles.size() / 3 > size_t(internalMaxChunkTriangles) ? _internalCreateSplitObject(obj) : _internalCreateObject(obj);
+		return _internalInsertObject(internalObject);
+	}
+
+	/*!
+	\brief Add a subdivision surface. Stencil tables are computed once from the topology of the control cage, so
+	that moving control vertices with updateVertices or updateObject only costs a parallel sparse matrix-vector
+	product per level.
+	\param cage control cage
+	\param levels number of subdivision levels
+	\param scheme Loop or Catmull-Clark subdivision
+	\returns the id of the refined object.
+	*/
+	int addSubdivisionSurface(const object& cage, int levels, subdivision scheme)
+	{
+		std::shared_ptr<subdivision_internal> s = std::make_shared<subdivision_internal>();
+		_internalBuildSubdivision(cage.triangles, int(cage.vertices.size()), std::max(0, levels), scheme, *s);
+		object refined;
+		_internalRefineObject(*s, cage, refined);
+		const int id = addObject(refined);
+		internalObjects[id].subdivision = s;
+		return id;
+	}
+
+	/*!
+	\brief Bake ambient occlusion into the vertex colors of an object. Rays are cast over the hemisphere of each vertex
+	against a bounding volume hierarchy of the visible objects of the scene, in the background and on all cores. The
+	colors are refined progressively, being updated after each pass of a few rays, and multiply the current colors of the
+	object. Objects and transforms changed afterwards are not taken into account.
+	\param id object id
+	\param rays number of rays per vertex
+	\param radius maximum distance of occluders, or a negative value for half the diagonal of the object
+	*/
+	void bakeAmbientOcclusion(int id, int rays, float radius)
+	{
+		assert(id < int(internalObjects.size()));
+		object_internal& target = internalObjects[id];
+		if (target.isDeleted || target.vao == 0 || !target.chunks.empty())
+		{
+			fprintf(stderr, "Cannot bake ambient occlusion of object %d: only regular objects are supported\n", id);
+			return;
+		}
+		_internalStopBake(id);
+		_internalUpdateTransforms();
+
+		// Vertices, normals and colors of the object, in world space
+		const int vertexCount = target.vertexCount;
+		std::vector<v3f> data(3 * size_t(vertexCount));
+		glBindBuffer(GL_COPY_READ_BUFFER, target.buffers);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(v3f) * data.size(), &data.front());
+		float inverse[4][4];
+		_internalInverseAffine(inverse, target.modelMatrix);
+		const float(*m)[4] = target.modelMatrix;
+		std::vector<v3f> points(vertexCount), normals(vertexCount);
+		for (int v = 0; v < vertexCount; v++)
+		{
+			const v3f& p = data[v];
+			const v3f& n = data[vertexCount + v];
+			points[v] = { m[0][0] * p.x + m[1][0] * p.y + m[2][0] * p.z + m[3][0], m[0][1] * p.x + m[1][1] * p.y + m[2][1] * p.z + m[3][1], m[0][2] * p.x + m[1][2] * p.y + m[2][2] * p.z + m[3][2] };
+			const v3f worldNormal = { inverse[0][0] * n.x + inverse[0][1] * n.y + inverse[0][2] * n.z, inverse[1][0] * n.x + inverse[1][1] * n.y + inverse[1][2] * n.z, inverse[2][0] * n.x + inverse[2][1] * n.y + inverse[2][2] * n.z };
+			normals[v] = internalLength2(worldNormal) > 0.0f ? internalNormalize(worldNormal) : v3f({ 0, 1, 0 });
+		}
+		if (radius < 0.0f)
+		{
+			v3f boundsMin, boundsMax;
+			_internalComputeBounds(points, boundsMin, boundsMax);
+			radius = 0.5f * internalLength(boundsMax - boundsMin);
+		}
+
+		// Triangles of the visible objects, in world space
+		std::vector<v3f> sceneTriangles;
+		for (const object_internal& obj : internalObjects)
+		{
+			if (obj.isDeleted || !obj.isVisible)
+				continue;
+			const float(*model)[4] = obj.modelMatrix;
+			auto gather = [&sceneTriangles, model](const object_internal& part)
+			{
+				if (part.vao == 0 || part.triangleCount == 0)
+					return;
+				std::vector<v3f> vertices(part.vertexCount);
+				std::vector<int> triangles;
+				glBindBuffer(GL_COPY_READ_BUFFER, part.buffers);
+				glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(v3f) * vertices.size(), &vertices.front());
+				_internalReadTriangles(part, triangles);
+				for (v3f& p : vertices)
+					p = { model[0][0] * p.x + model[1][0] * p.y + model[2][0] * p.z + model[3][0], model[0][1] * p.x + model[1][1] * p.y + model[2][1] * p.z + model[3][1], model[0][2] * p.x + model[1][2] * p.y + model[2][2] * p.z + model[3][2] };
+				for (int i : triangles)
+					sceneTriangles.push_back(vertices[i]);
+			};
+			gather(obj);
+			for (const object_internal& chunk : obj.chunks)
+				gather(chunk);
+		}
+
+		internalBakes.push_back(std::unique_ptr<bake_internal>(new bake_internal()));
+		bake_internal& bake = *internalBakes.back();
+		bake.objectId = id;
+		bake.rays = std::max(1, rays);
+		bake.baseColors.assign(data.begin() + 2 * size_t(vertexCount), data.end());
+		bake.thread = std::thread([&bake, points = std::move(points), normals = std::move(normals), sceneTriangles = std::move(sceneTriangles), radius]()
+			{
+				_internalBakeAmbientOcclusion(bake, points, normals, sceneTriangles, radius);
+			});
+	}
+
+	/*!
+	\brief Add a group to the scene graph: a node without geometry, used to transform all its children at once.
+	\param position, scale local transform of the group
+	\returns the id of the group, used as any other object id.
+	*/
+	int addGroup(const v3f& position, const v3f& scale)
+	{
+		internalScene.sceneVersion++;
+		object_internal group;
+		_internalComputeModelMatrix(group.localMatrix, position, scale);
+		_internalComputeModelMatrix(group.modelMatrix, position, scale);
+		int index = _internalGetNextFreeIndex();
+		if (index == int(internalObjects.size()))
+			internalObjects.push_back(group);
+		else
+			internalObjects[index] = group;
+		internalHierarchy.needsRebuild = true;
+		internalDrawListDirty = true;
+		return index;
+	}
+
+	/*!
+	\brief Attach an object to a parent in the scene graph. Its position and scale become relative to the parent.
+	\param id object id
+	\param parentId parent object or group id, -1 to make the object a root
+	\returns false if the parent is invalid or would create a cycle, true otherwise.
+	*/
+	bool setParent(int id, int parentId)
+	{
+		assert(id < int(internalObjects.size()));
+		if (parentId >= int(internalObjects.size()) || (parentId >= 0 && internalObjects[parentId].isDeleted))
+		{
+			fprintf(stderr, "Invalid parent %d for object %d\n", parentId, id);
+			return false;
+		}
+		for (int p = parentId; p >= 0; p = internalObjects[p].parent)
+		{
+			if (p == id)
+			{
+				fprintf(stderr, "Parenting object %d to %d would create a cycle\n", id, parentId);
+				return false;
+			}
+		}
+		internalScene.sceneVersion++;
+		internalObjects[id].parent = parentId;
+		internalHierarchy.needsRebuild = true;
+		internalDrawListDirty = true;
+		return true;
+	}
+
+	/*!
+	\brief Add an out-of-core object, whose data is provided by a source function called on a loading thread when the
+	object becomes visible. Its bounding box is drawn until the data is uploaded, and its buffers are evicted in least
+	recently used order when the memory budget is exceeded, see setResidencyBudget.
+	\param source function returning the object data, from memory or disk. Called from another thread, and possibly
+	several times if the object is evicted.
+	\param boundsMin, boundsMax bounding box of the object vertices
+	\param position, scale transform of the object
+	\returns the id of the object in the hierarchy.
+	*/
+	int addStreamedObject(const std::function<object()>& source, const v3f& boundsMin, const v3f& boundsMax, const v3f& position, const v3f& scale)
+	{
+		internalScene.sceneVersion++;
+		if (internalResidency.placeholder.vao == 0)
+			_internalCreatePlaceholder();
+		if (!internalResidency.thread.joinable())
+		{
+			internalResidency.quit = false;
+			internalResidency.thread = std::thread(_internalResidencyLoader);
+		}
+
+		object_internal obj;
+		_internalComputeModelMatrix(obj.localMatrix, position, scale);
+		_internalComputeModelMatrix(obj.modelMatrix, position, scale);
+		obj.boundsMin = boundsMin;
+		obj.boundsMax = boundsMax;
+		obj.hasBounds = true;
+		int index = _internalGetNextFreeIndex();
+		if (index == int(internalObjects.size()))
+			internalObjects.push_back(obj);
+		else
+			internalObjects[index] = obj;
+
+		std::unique_ptr<streamed_internal> streamed(new streamed_internal());
+		streamed->objectId = index;
+		streamed->source = source;
+		std::lock_guard<std::mutex> lock(internalResidency.mutex);
+		internalObjects[index].streamId = int(internalResidency.objects.size());
+		internalResidency.objects.push_back(std::move(streamed));
+		internalHierarchy.needsRebuild = true;
+		internalDrawListDirty = true;
+		return index;
+	}
+
+	/*!
+	\brief Set the GPU memory budget of out-of-core objects, and the amount of data uploaded per frame.
+	\param bytes memory budget, 1 GB by default
+	\param uploadBytesPerFrame upload limit per frame, 64 MB by default. At least one object is uploaded per frame.
+	*/
+	void setResidencyBudget(size_t bytes, size_t uploadBytesPerFrame)
+	{
+		std::lock_guard<std::mutex> lock(internalResidency.mutex);
+		internalResidency.budget = bytes;
+		internalResidency.uploadBytesPerFrame = uploadBytesPerFrame;
+	}
+
+	/*!
+	\brief Returns true if an object has its data on the GPU. Always true for regular objects.
+	\param id object id
+	*/
+	bool isResident(int id)
+	{
+		assert(id < int(internalObjects.size()));
+		return internalObjects[id].vao != 0;
+	}
+
+	/*!
+	\brief Add a terrain rendered with continuous distance-dependent levels of detail (CDLOD). The terrain is a
+	quadtree of nodes that all draw the same grid patch, displaced in the vertex shader by a height texture. Nodes are
+	refined near the camera and vertices morph smoothly between levels, so the number of triangles drawn per frame
+	depends on the level of detail distance, not on the terrain size.
+	\param heights height samples, row major, of size resolution * resolution
+	\param resolution number of samples per side, of the form 32 * 2^k + 1
+	\param size extents of the terrain, centered on its position
+	\param heightScale factor applied to the height samples
+	\param position center of the terrain
+	\returns the terrain id, or -1 if the resolution is invalid.
+	*/
+	int addTerrain(const std::vector<float>& heights, int resolution, float size, float heightScale, const v3f& position)
+	{
+		const int n = internalTerrainPatchResolution;
+		int levelCount = 1;
+		while ((n << (levelCount - 1)) < resolution - 1)
+			levelCount++;
+		if ((n << (levelCount - 1)) != resolution - 1 || heights.size() != size_t(resolution) * resolution)
+		{
+			fprintf(stderr, "Terrain resolution must be of the form %d * 2^k + 1, with resolution^2 heights\n", n);
+			return -1;
+		}
+		internalScene.sceneVersion++;
+		if (internalTerrainPatch.vao == 0)
+			_internalCreateTerrainPatch();
+
+		terrain_internal terrain;
+		terrain.heights = heights;
+		terrain.resolution = resolution;
+		terrain.size = size;
+		terrain.heightScale = heightScale;
+		terrain.position = position;
+		terrain.levelCount = levelCount;
+		terrain.lodDistance = 2.0f * size / float(1 << (levelCount - 1));
+		terrain.minMax.resize(levelCount);
+		for (int level = 0; level < levelCount; level++)
+		{
+			const int nodeCount = 1 << (levelCount - 1 - level);
+			terrain.minMax[level].resize(2 * size_t(nodeCount) * nodeCount);
+		}
+		_internalUpdateTerrainBounds(terrain, 0, 0, resolution - 1, resolution - 1);
+
+		glGenTextures(1, &terrain.heightTexture);
+		glBindTexture(GL_TEXTURE_2D, terrain.heightTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, resolution, resolution, 0, GL_RED, GL_FLOAT, &heights.front());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_2D, 0);
+
+		for (int i = 0; i < int(internalTerrains.size()); i++)
+		{
+			if (internalTerrains[i].isDeleted)
+			{
+				internalTerrains[i] = terrain;
+				return i;
+			}
+		}
+		internalTerrains.push_back(terrain);
+		return int(internalTerrains.size()) - 1;
+	}
+
+	/*!
+	\brief Update a rectangular tile of the heights of a terrain, for instance when streaming heights from disk.
+	Only the tile is uploaded, and only the bounds of the quadtree nodes covering it are recomputed.
+	\param id terrain id
+	\param x, y first sample of the tile
+	\param width, height tile dimensions, in samples
+	\param heights tile heights, row major
+	*/
+	void updateTerrainTile(int id, int x, int y, int width, int height, const std::vector<float>& heights)
+	{
+		assert(id < int(internalTerrains.size()));
+		terrain_internal& terrain = internalTerrains[id];
+		assert(x >= 0 && y >= 0 && x + width <= terrain.resolution && y + height <= terrain.resolution);
+		assert(heights.size() == size_t(width) * height);
+		internalScene.sceneVersion++;
+		for (int j = 0; j < height; j++)
+			std::copy(heights.begin() + size_t(j) * width, heights.begin() + size_t(j + 1) * width, terrain.heights.begin() + size_t(y + j) * terrain.resolution + x);
+		_internalUpdateTerrainBounds(terrain, x, y, x + width - 1, y + height - 1);
+
+		glBindTexture(GL_TEXTURE_2D, terrain.heightTexture);
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, x, y, width, height, GL_RED, GL_FLOAT, &heights.front());
+		glBindTexture(GL_TEXTURE_2D, 0);
+	}
+
+	/*!
+	\brief Set the distance up to which the finest level of detail of a terrain is used. Each coarser level doubles
+	the distance of the previous one. Smaller distances draw fewer triangles.
+	\param id terrain id
+	\param distance level of detail distance
+	*/
+	void setTerrainLodDistance(int id, float distance)
+	{
+		assert(id < int(internalTerrains.size()));
+		internalScene.sceneVersion++;
+		internalTerrains[id].lodDistance = std::max(distance, 1e-3f);
+	}
+
+	/*!
+	\brief Removes a terrain given its id.
+	\param id terrain id
+	\returns true if removal is successful, false otherwise.
+	*/
+	bool removeTerrain(int id)
+	{
+		assert(id < int(internalTerrains.size()));
+		terrain_internal& terrain = internalTerrains[id];
+		if (terrain.isDeleted)
+			return false;
+		internalScene.sceneVersion++;
+		glDeleteTextures(1, &terrain.heightTexture);
+		terrain = terrain_internal();
+		terrain.isDeleted = true;
+		return true;
+	}
+
+	/*!
+	\brief Add a signed distance field object defined by a CSG graph of primitives and smooth boolean operators. The
+	graph is compiled to a small postfix program evaluated with a stack in the fragment shader, and sphere traced
+	inside a proxy box, writing the depth of the surface so that it composites with meshes. No polygonization is done.
+	\param nodes node graph, whose root is the last node. Operands are given by node indices.
+	\param position, scale transform of the object. The scale should be uniform, distances being measured in object space.
+	\returns the object id, or -1 if the graph is invalid.
+	*/
+	int addSdfObject(const std::vector<csgnode>& nodes, const v3f& position, const v3f& scale)
+	{
+		sdf_internal sdf;
+		if (!_internalUploadCsg(sdf, nodes))
+			return -1;
+		internalScene.sceneVersion++;
+		if (internalSdfBoxVao == 0)
+			_internalCreateSdfBox();
+		_internalComputeModelMatrix(sdf.modelMatrix, position, scale);
+		for (int i = 0; i < int(internalSdfObjects.size()); i++)
+		{
+			if (internalSdfObjects[i].isDeleted)
+			{
+				internalSdfObjects[i] = sdf;
+				return i;
+			}
+		}
+		internalSdfObjects.push_back(sdf);
+		return int(internalSdfObjects.size()) - 1;
+	}
+
+	/*!
+	\brief Add a signed distance field object sampled on a regular grid, stored in a 3D texture and sphere traced in
+	the fragment shader.
+	\param distances signed distances, in object space units, x-major, of size resolution^3
+	\param resolution number of samples per axis
+	\param boundsMin, boundsMax box covered by the samples, also used as proxy box
+	\param color surface color
+	\returns the object id, or -1 if the sample count is invalid.
+	*/
+	int addSdfObject(const std::vector<float>& distances, int resolution, const v3f& boundsMin, const v3f& boundsMax, const v3f& color)
+	{
+		if (resolution < 2 || distances.size() != size_t(resolution) * resolution * resolution)
+		{
+			fprintf(stderr, "Sampled distance field must have resolution^3 samples, with a resolution of at least 2\n");
+			return -1;
+		}
+		internalScene.sceneVersion++;
+		if (internalSdfBoxVao == 0)
+			_internalCreateSdfBox();
+		sdf_internal sdf;
+		sdf.boundsMin = boundsMin;
+		sdf.boundsMax = boundsMax;
+		sdf.color = color;
+		sdf.resolution = resolution;
+		_internalComputeModelMatrix(sdf.modelMatrix, { 0, 0, 0 }, { 1, 1, 1 });
+		glGenTextures(1, &sdf.volumeTexture);
+		glBindTexture(GL_TEXTURE_3D, sdf.volumeTexture);
+		glTexImage3D(GL_TEXTURE_3D, 0, GL_R32F, resolution, resolution, resolution, 0, GL_RED, GL_FLOAT, &distances.front());
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_3D, GL_TEXTURE_WRAP_R, GL_CLAMP_TO_EDGE);
+		glBindTexture(GL_TEXTURE_3D, 0);
+		for (int i = 0; i < int(internalSdfObjects.size()); i++)
+		{
+			if (internalSdfObjects[i].isDeleted)
+			{
+				internalSdfObjects[i] = sdf;
+				return i;
+			}
+		}
+		internalSdfObjects.push_back(sdf);
+		return int(internalSdfObjects.size()) - 1;
+	}
+
+	/*!
+	\brief Replace the CSG graph of a signed distance field object. Only the compiled program is uploaded again.
+	\param id object id
+	\param nodes node graph, whose root is the last node
+	*/
+	void updateSdfObject(int id, const std::vector<csgnode>& nodes)
+	{
+		assert(id < int(internalSdfObjects.size()));
+		if (internalSdfObjects[id].volumeTexture != 0)
+		{
+			fprintf(stderr, "Signed distance field %d is sampled, and has no CSG graph\n", id);
+			return;
+		}
+		internalScene.sceneVersion++;
+		_internalUploadCsg(internalSdfObjects[id], nodes);
+	}
+
+	/*!
+	\brief Update the transform of a signed distance field object.
+	\param id object id
+	\param position, scale new transform
+	*/
+	void updateSdfObject(int id, const v3f& position, const v3f& scale)
+	{
+		assert(id < int(internalSdfObjects.size()));
+		internalScene.sceneVersion++;
+		_internalComputeModelMatrix(internalSdfObjects[id].modelMatrix, position, scale);
+	}
+
+	/*!
+	\brief Removes a signed distance field object given its id.
+	\param id object id
+	\returns true if removal is successful, false otherwise.
+	*/
+	bool removeSdfObject(int id)
+	{
+		assert(id < int(internalSdfObjects.size()));
+		sdf_internal& sdf = internalSdfObjects[id];
+		if (sdf.isDeleted)
+			return false;
+		internalScene.sceneVersion++;
+		glDeleteBuffers(1, &sdf.programBuffer);
+		glDeleteTextures(1, &sdf.programTexture);
+		glDeleteTextures(1, &sdf.volumeTexture);
+		sdf = sdf_internal();
+		sdf.isDeleted = true;
+		return true;
+	}
+
+	/*!
+	\brief Add an empty voxel volume. The volume is split in chunks of 32^3 voxels, each greedy meshed into a minimal
+	set of quads on worker threads and drawn as its own object. Editing voxels only remeshes and uploads the affected
+	chunks, during the next update.
+	\param sizeX, sizeY, sizeZ number of voxels along each axis
+	\param voxelSize edge length of a voxel
+	\param position position of the corner of the volume
+	\returns the volume id.
+	*/
+	int addVoxelVolume(int sizeX, int sizeY, int sizeZ, float voxelSize, const v3f& position)
+	{
+		voxel_volume_internal volume;
+		volume.size[0] = std::max(1, sizeX);
+		volume.size[1] = std::max(1, sizeY);
+		volume.size[2] = std::max(1, sizeZ);
+		volume.voxelSize = voxelSize;
+		volume.voxels.assign(size_t(volume.size[0]) * volume.size[1] * volume.size[2], 0);
+		for (int m = 0; m < 256; m++)
+			volume.palette[m] = { 0.5f, 0.5f, 0.5f };
+		for (int k = 0; k < 3; k++)
+			volume.chunkCount[k] = (volume.size[k] + internalVoxelChunkSize - 1) / internalVoxelChunkSize;
+		const size_t chunkCount = size_t(volume.chunkCount[0]) * volume.chunkCount[1] * volume.chunkCount[2];
+		volume.chunkObjects.assign(chunkCount, -1);
+		volume.isDirty.assign(chunkCount, 0);
+		volume.position = position;
+		volume.groupId = addGroup(position);
+
+		int index = int(internalVoxelVolumes.size());
+		for (int i = 0; i < int(internalVoxelVolumes.size()) && index == int(internalVoxelVolumes.size()); i++)
+		{
+			if (internalVoxelVolumes[i].isDeleted)
+				index = i;
+		}
+		if (index == int(internalVoxelVolumes.size()))
+			internalVoxelVolumes.push_back(volume);
+		else
+			internalVoxelVolumes[index] = volume;
+		internalObjects[volume.groupId].voxelVolume = index;
+		return index;
+	}
+
+	/*!
+	\brief Set the material of a voxel.
+	\param id volume id
+	\param x, y, z voxel coordinates
+	\param material material index, 0 for an empty voxel
+	*/
+	void setVoxel(int id, int x, int y, int z, unsigned char material)
+	{
+		fillVoxels(id, x, y, z, x + 1, y + 1, z + 1, material);
+	}
+
+	/*!
+	\brief Set the material of a box of voxels.
+	\param id volume id
+	\param x0, y0, z0 first voxel of the box
+	\param x1, y1, z1 end of the box, excluded
+	\param material material index, 0 for empty voxels
+	*/
+	void fillVoxels(int id, int x0, int y0, int z0, int x1, int y1, int z1, unsigned char material)
+	{
+		assert(id < int(internalVoxelVolumes.size()));
+		voxel_volume_internal& volume = internalVoxelVolumes[id];
+		x0 = std::max(x0, 0); y0 = std::max(y0, 0); z0 = std::max(z0, 0);
+		x1 = std::min(x1, volume.size[0]); y1 = std::min(y1, volume.size[1]); z1 = std::min(z1, volume.size[2]);
+		for (int z = z0; z < z1; z++)
+		{
+			for (int y = y0; y < y1; y++)
+			{
+				for (int x = x0; x < x1; x++)
+				{
+					unsigned char& voxel = volume.voxels[(size_t(z) * volume.size[1] + y) * volume.size[0] + x];
+					if (voxel != material)
+					{
+						voxel = material;
+						_internalMarkVoxelDirty(volume, x, y, z);
+					}
+				}
+			}
+		}
+	}
+
+	/*!
+	\brief Returns the material of a voxel, 0 for empty voxels and voxels outside of the volume.
+	\param id volume id
+	\param x, y, z voxel coordinates
+	*/
+	unsigned char getVoxel(int id, int x, int y, int z)
+	{
+		assert(id < int(internalVoxelVolumes.size()));
+		const voxel_volume_internal& volume = internalVoxelVolumes[id];
+		if (x < 0 || y < 0 || z < 0 || x >= volume.size[0] || y >= volume.size[1] || z >= volume.size[2])
+			return 0;
+		return volume.voxels[(size_t(z) * volume.size[1] + y) * volume.size[0] + x];
+	}
+
+	/*!
+	\brief Set the color of a voxel material. All chunks are remeshed.
+	\param id volume id
+	\param material material index
+	\param color material color
+	*/
+	void setVoxelColor(int id, unsigned char material, const v3f& color)
+	{
+		assert(id < int(internalVoxelVolumes.size()));
+		voxel_volume_internal& volume = internalVoxelVolumes[id];
+		volume.palette[material] = color;
+		for (size_t c = 0; c < volume.chunkObjects.size(); c++)
+			volume.isDirty[c] = volume.chunkObjects[c] != -1;
+		volume.hasDirtyChunks = true;
+	}
+
+	/*!
+	\brief Removes a voxel volume and its chunk objects.
+	\param id volume id
+	\returns true if removal is successful, false otherwise.
+	*/
+	bool removeVoxelVolume(int id)
+	{
+		assert(id < int(internalVoxelVolumes.size()));
+		voxel_volume_internal& volume = internalVoxelVolumes[id];
+		if (volume.isDeleted)
+			return false;
+		for (int objectId : volume.chunkObjects)
+		{
+			if (_internalIsVoxelObject(objectId, id))
+				removeObject(objectId);
+		}
+		if (_internalIsVoxelObject(volume.groupId, id))
+			removeObject(volume.groupId);
+		volume = voxel_volume_internal();
+		volume.isDeleted = true;
+		return true;
+	}
+
+	/*!
+	\brief Flag an object as an occluder for software occlusion culling, using its own triangles, read back from
+	the GPU. Best suited to large objects with few triangles, such as walls or terrain; see the overload taking a
+	simplified hull otherwise.
+	\param id object id
+	\param enabled occluder flag
+	*/
+	void setOccluder(int id, bool enabled)
+	{
+		assert(id < int(internalObjects.size()));
+		object_internal& obj = internalObjects[id];
+		if (!enabled)
+		{
+			obj.occluder.reset();
+			return;
+		}
+		if (obj.vao == 0 || !obj.chunks.empty() || !obj.hasBounds)
+		{
+			fprintf(stderr, "Object %d cannot be used as an occluder without a simplified hull\n", id);
 			return;
 		}
-		glfwMakeContextCurrent(windowPtr);
-		glfwShowWindow(windowPtr);
-		glfwSwapInterval(1);
-		glfwSetInputMode(windowPtr, GLFW_CURSOR, GLFW_CURSOR_NORMAL);
-		glfwSetWindowSizeCallback(windowPtr, [](GLFWwindow* win, int w, int h)
-			{
-				glViewport(0, 0, w, h);
-				width_internal = w;
-				height_internal = h;
-			});
-		glfwSetScrollCallback(windowPtr, [](GLFWwindow* win, double x, double y)
-			{
-				_internalCameraMove(0.0f, 0.0f, float(y) * internalScene.mouseScrollingSpeed, 0.0f, 0.0f);
-			});
+		object hull;
+		hull.vertices.resize(obj.vertexCount);
+		glBindBuffer(GL_COPY_READ_BUFFER, obj.buffers);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(v3f) * hull.vertices.size(), &hull.vertices.front());
+		_internalReadTriangles(obj, hull.triangles);
+		setOccluder(id, hull);
+	}
 
-		// OpenGL
-		glewInit();
-		glEnable(GL_DEPTH_TEST);
-		GLenum err = glGetError();
-		if (err != GL_NO_ERROR)
+	/*!
+	\brief Flag an object as an occluder for software occlusion culling, with a simplified hull that must lie inside
+	the object, in its local space. Each frame, the occluders with the largest projected size are rasterized in a
+	low resolution depth buffer, against which the bounds of all other objects are tested.
+	\param id object id
+	\param hull occluder geometry: vertices and triangles only
+	*/
+	void setOccluder(int id, const object& hull)
+	{
+		assert(id < int(internalObjects.size()));
+		assert(!hull.vertices.empty());
+		internalScene.sceneVersion++;
+		std::shared_ptr<occluder_internal> occluder = std::make_shared<occluder_internal>();
+		occluder->vertices = hull.vertices;
+		occluder->triangles = hull.triangles;
+		_internalComputeBounds(hull.vertices, occluder->boundsMin, occluder->boundsMax);
+		internalObjects[id].occluder = occluder;
+	}
+
+	/*!
+	\brief Draw an object with hardware tessellation. Each triangle becomes a curved PN triangle defined by its
+	vertex normals, and its edges are subdivided on the GPU according to their length on screen, so that triangle
+	density follows the view without any work on the CPU. Wireframe, scalars, morph targets and point lights are not
+	applied to tessellated objects. Without GL 4.0, the object is drawn as regular triangles. The patches only meet
+	where neighboring triangles share their vertex normals: vertices duplicated with split normals, such as the
+	creases of computeCreaseNormals, open cracks in the surface, so tessellated objects should use smooth normals.
+	\param id object id
+	\param pixelsPerEdge target length of the tessellated edges in pixels, a value of 0 disables tessellation
+	\returns false if tessellation is not available for this object.
+	*/
+	bool setTessellation(int id, float pixelsPerEdge)
+	{
+		assert(id < int(internalObjects.size()));
+		object_internal& obj = internalObjects[id];
+		if (pixelsPerEdge <= 0.0f)
 		{
-			fprintf(stderr, "Error initializing opengl - terminating");
-			glfwTerminate();
-			return;
+			internalScene.sceneVersion++;
+			if (obj.tessellation)
+				glDeleteTextures(1, &obj.tessellation->displacementTexture);
+			obj.tessellation.reset();
+			return true;
+		}
+		if (!internalScene.hasTessellation)
+		{
+			fprintf(stderr, "Tessellation shaders are not supported, object %d is drawn as regular triangles\n", id);
+			return false;
 		}
+		if (!_internalCheckHasGeometry(id) || !_internalCheckNotSplit(id))
+			return false;
+		internalScene.sceneVersion++;
+		if (!obj.tessellation)
+			obj.tessellation = std::make_shared<tessellation_internal>();
+		obj.tessellation->pixelsPerEdge = pixelsPerEdge;
+		return true;
+	}
 
-		// Shaders
-		const GLchar* vertexShaderSource =
-			"#version 330\n"
-			"layout (location = 0) in vec3 vertex;\n"
-			"layout (location = 1) in vec3 normal;\n"
-			"layout (location = 2) in vec3 color;\n"
-			"uniform mat4 uProjection;\n"
-			"uniform mat4 uView;\n"
-			"uniform mat4 uModel;\n"
-			"out vec3 geomPos;\n"
-			"out vec3 geomNormal;\n"
-			"out vec3 geomColor;\n"
-			"void main()\n"
-			"{\n"
-			"	 geomPos = vertex;\n"
-			"    gl_Position = uProjection * uView * uModel * vec4(vertex, 1.0f);\n"
-			"	 geomNormal = normalize(normal);\n"
-			"    geomColor = color;\n"
-			"}\n";
-		const GLchar* geometryShaderSource =
-			"#version 330\n"
-			"layout(triangles) in;\n"
-			"layout(triangle_strip, max_vertices = 3) out;\n"
-			"in vec3 geomPos[];\n"
-			"in vec3 geomNormal[];\n"
-			"in vec3 geomColor[];\n"
-			"uniform vec2 uWireframeThickness;\n"
-			"out vec3 fragPos;\n"
-			"out vec3 fragNormal;\n"
-			"out vec3 fragColor;\n"
-			"out vec3 dist;\n"
-			"void main()\n"
-			"{\n"
-			"	vec2 p0 = uWireframeThickness * gl_in[0].gl_Position.xy / gl_in[0].gl_Position.w;\n"
-			"	vec2 p1 = uWireframeThickness * gl_in[1].gl_Position.xy / gl_in[1].gl_Position.w;\n"
-			"	vec2 p2 = uWireframeThickness * gl_in[2].gl_Position.xy / gl_in[2].gl_Position.w;\n"
-			"	vec2 v0 = p2 - p1;\n"
-			"	vec2 v1 = p2 - p0;;\n"
-			"	vec2 v2 = p1 - p0;;\n"
-			"	float area = abs(v1.x*v2.y - v1.y * v2.x);\n"
-			"	dist = vec3(area / length(v0), 0, 0);\n"
-			"	gl_Position = gl_in[0].gl_Position;\n"
-			"	fragPos = geomPos[0]; fragColor = geomColor[0];  fragNormal = geomNormal[0];\n"
-			"	EmitVertex();\n"
-			"	dist = vec3(0, area / length(v1), 0);\n"
-			"	gl_Position = gl_in[1].gl_Position;\n"
-			"	fragPos = geomPos[1]; fragColor = geomColor[1];  fragNormal = geomNormal[1];\n"
-			"	EmitVertex();\n"
-			"	dist = vec3(0, 0, area / length(v2));\n"
-			"	gl_Position = gl_in[2].gl_Position;\n"
-			"	fragPos = geomPos[2]; fragColor = geomColor[2];  fragNormal = geomNormal[2];\n"
-			"	EmitVertex();\n"
-			"	EndPrimitive();\n"
-			"}\n";
-		const GLchar* fragmentShaderSource =
-			"#version 330\n"
-			"in vec3 fragPos;\n"
-			"in vec3 fragNormal;\n"
-			"in vec3 fragColor;\n"
-			"in vec3 dist;\n"
-			"uniform vec3 uLightDir;\n"
-			"uniform int uDoLighting;\n"
-			"uniform int uDrawWireframe;\n"
-			"uniform int uShowNormals;\n"
-			"out vec4 outFragmentColor;\n"
-			"void main()\n"
-			"{\n"
-			"	 float d = uDoLighting == 1 ? 0.5 * (1.0 + dot(fragNormal, uLightDir)) : 1.0f;\n"
-			"	 vec3 col = fragColor;\n"
-			"	 if (uShowNormals == 1) {\n"
-			"		col = vec3(0.2*(vec3(3.0,3.0,3.0)+2.0*fragNormal));\n"
-			"		d = 1.f\n;"
-			"	 }\n"
-			"	 float w = min(dist[0], min(dist[1], dist[2]));\n"
-			"	 float I = exp2(-1 * w * w);\n"
-			"	 if (uDrawWireframe == 1)\n"
-			"		col = I * vec3(0.1) + (1.0 - I) * col;\n"
-			"	 outFragmentColor = vec4(col * d, 1.0); \n"
-			"}\n";
-		GLuint g_ShaderHandle = 0, g_VertHandle = 0, g_FragHandle = 0, g_GeomHandle = 0;
-		g_VertHandle = glCreateShader(GL_VERTEX_SHADER);
-		glShaderSource(g_VertHandle, 1, &vertexShaderSource, NULL);
-		glCompileShader(g_VertHandle);
-		if (!_internalCheckShader(g_VertHandle, "vertex shader"))
+	/*!
+	\brief Set the height map displacing the surface of a tessellated object along its normal. The map is projected
+	along the three axes in object space and blended with the normal, so no texture coordinates are needed.
+	\param id object id, which must be tessellated
+	\param heights height values, of size resolution^2, in [0, 1]
+	\param resolution number of samples per axis
+	\param amplitude displacement for a height of 1, in object space
+	\param tiling number of repetitions of the map per object space unit
+	\returns false if the object is not tessellated or the map is invalid.
+	*/
+	bool setDisplacementMap(int id, const std::vector<float>& heights, int resolution, float amplitude, float tiling)
+	{
+		assert(id < int(internalObjects.size()));
+		object_internal& obj = internalObjects[id];
+		if (!obj.tessellation)
 		{
-			fprintf(stderr, "Error initializing vertex shader - terminating");
-			return;
+			fprintf(stderr, "Object %d is not tessellated, call setTessellation first\n", id);
+			return false;
+		}
+		if (resolution < 1 || heights.size() != size_t(resolution) * resolution)
+		{
+			fprintf(stderr, "Displacement map must have resolution^2 samples\n");
+			return false;
 		}
+		internalScene.sceneVersion++;
+		tessellation_internal& tessellation = *obj.tessellation;
+		if (tessellation.displacementTexture == 0)
+			glGenTextures(1, &tessellation.displacementTexture);
+		glBindTexture(GL_TEXTURE_2D, tessellation.displacementTexture);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_R32F, resolution, resolution, 0, GL_RED, GL_FLOAT, &heights.front());
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+		glBindTexture(GL_TEXTURE_2D, 0);
+		tessellation.amplitude = amplitude;
+		tessellation.tiling = tiling;
+		return true;
+	}
 
-		g_GeomHandle = glCreateShader(GL_GEOMETRY_SHADER);
-		glShaderSource(g_GeomHandle, 1, &geometryShaderSource, NULL);
-		glCompileShader(g_GeomHandle);
-		if (!_internalCheckShader(g_GeomHandle, "geometry shader"))
+	/*!
+	\brief Partition an object into meshlets of spatially close triangles, each with bounds and a normal cone. Meshlets
+	are then culled every frame against the view frustum and, optionally, when facing away from the camera; the
+	remaining index ranges are drawn with a single multi-draw. Triangles are reordered in the element buffer.
+	Meshlets are discarded when the geometry of the object changes. Out-of-core objects, which are reloaded in their
+	source order after eviction, are rejected.
+	\param id object id
+	\param maxTriangles number of triangles per meshlet
+	\param coneCulling cull back-facing meshlets. Back faces are otherwise drawn, so this should only be enabled
+	for closed meshes.
+	*/
+	void buildMeshlets(int id, int maxTriangles, bool coneCulling)
+	{
+		assert(id < int(internalObjects.size()));
+		object_internal& obj = internalObjects[id];
+		if (!_internalCheckHasGeometry(id) || !_internalCheckNotSplit(id))
+			return;
+		bool isTimeSeries = false;
+		for (const auto& series : internalTimeSeries)
+			isTimeSeries = isTimeSeries || series->objectId == id;
+		if (obj.vao == 0 || obj.streamId != -1 || obj.morphCount > 0 || isTimeSeries)
 		{
-			fprintf(stderr, "Error initializing geometry shader - terminating");
+			fprintf(stderr, "Meshlets can only be built for static objects, not out-of-core or animated ones (object %d)\n", id);
 			return;
 		}
+		internalScene.sceneVersion++;
 
-		g_FragHandle = glCreateShader(GL_FRAGMENT_SHADER);
-		glShaderSource(g_FragHandle, 1, &fragmentShaderSource, NULL);
-		glCompileShader(g_FragHandle);
-		if (!_internalCheckShader(g_FragHandle, "fragment shader"))
+		// Read back positions and triangles
+		std::vector<v3f> vertices(obj.vertexCount);
+		std::vector<int> triangles;
+		glBindBuffer(GL_COPY_READ_BUFFER, obj.buffers);
+		glGetBufferSubData(GL_COPY_READ_BUFFER, 0, sizeof(v3f) * vertices.size(), &vertices.front());
+		_internalReadTriangles(obj, triangles);
+		const int triangleCount = int(triangles.size() / 3);
+
+		// Sort triangles along a Morton curve of their centroids, so that consecutive triangles are close
+		v3f lo = vertices.front(), hi = lo;
+		for (const v3f& p : vertices)
 		{
-			fprintf(stderr, "Error initializing fragment shader - terminating");
-			return;
+			lo = { std::min(lo.x, p.x), std::min(lo.y, p.y), std::min(lo.z, p.z) };
+			hi = { std::max(hi.x, p.x), std::max(hi.y, p.y), std::max(hi.z, p.z) };
+		}
+		const v3f extent = hi - lo;
+		std::vector<std::pair<unsigned int, int>> keys(triangleCount);
+		_internalParallelFor(triangleCount, [&](int begin, int end)
+		{
+			for (int t = begin; t < end; t++)
+			{
+				const v3f c = (vertices[triangles[3 * t]] + vertices[triangles[3 * t + 1]] + vertices[triangles[3 * t + 2]]) / 3.0f;
+				unsigned int code = 0;
+				for (int k = 0; k < 3; k++)
+				{
+					unsigned int q = (unsigned int)(std::min(1023.0f, std::max(0.0f, 1023.0f * (c.v[k] - lo.v[k]) / std::max(extent.v[k], 1e-12f))));
+					for (int b = 0; b < 10; b++)
+						code |= ((q >> b) & 1u) << (3 * b + k);
+				}
+				keys[t] = { code, t };
+			}
+		});
+		std::sort(keys.begin(), keys.end());
+		std::vector<int> sorted(triangles.size());
+		for (int t = 0; t < triangleCount; t++)
+		{
+			for (int j = 0; j < 3; j++)
+				sorted[3 * t + j] = triangles[3 * keys[t].second + j];
 		}
 
-		g_ShaderHandle = glCreateProgram();
-		glAttachShader(g_ShaderHandle, g_VertHandle);
-		glAttachShader(g_ShaderHandle, g_GeomHandle);
-		glAttachShader(g_ShaderHandle, g_FragHandle);
-		glLinkProgram(g_ShaderHandle);
-		internalShaders.push_back(g_ShaderHandle);
+		// Bounds and normal cone of each meshlet
+		maxTriangles = std::max(1, maxTriangles);
+		const int meshletCount = (triangleCount + maxTriangles - 1) / maxTriangles;
+		obj.meshlets.assign(meshletCount, meshlet_internal());
+		_internalParallelFor(meshletCount, [&](int begin, int end)
+		{
+			for (int m = begin; m < end; m++)
+			{
+				meshlet_internal& meshlet = obj.meshlets[m];
+				const int first = m * maxTriangles, last = std::min(triangleCount, first + maxTriangles);
+				meshlet.indexOffset = 3 * first;
+				meshlet.indexCount = 3 * (last - first);
+				meshlet.boundsMin = meshlet.boundsMax = vertices[sorted[3 * first]];
+				v3f axis = { 0, 0, 0 };
+				for (int t = first; t < last; t++)
+				{
+					const v3f& a = vertices[sorted[3 * t]], &b = vertices[sorted[3 * t + 1]], &c = vertices[sorted[3 * t + 2]];
+					for (const v3f* p : { &a, &b, &c })
+					{
+						meshlet.boundsMin = { std::min(meshlet.boundsMin.x, p->x), std::min(meshlet.boundsMin.y, p->y), std::min(meshlet.boundsMin.z, p->z) };
+						meshlet.boundsMax = { std::max(meshlet.boundsMax.x, p->x), std::max(meshlet.boundsMax.y, p->y), std::max(meshlet.boundsMax.z, p->z) };
+					}
+					const v3f n = internalCross(b - a, c - a);
+					const float length = internalLength(n);
+					if (length > 0.0f)
+						axis += n / length;
+				}
+				meshlet.center = (meshlet.boundsMin + meshlet.boundsMax) * 0.5f;
+				meshlet.radius = internalLength(meshlet.boundsMax - meshlet.center);
 
-		// Imgui
-		IMGUI_CHECKVERSION();
-		ImGui::CreateContext();
-		ImGui_ImplGlfw_InitForOpenGL(windowPtr, true);
-		ImGui_ImplOpenGL3_Init("#version 330");
+				// The cone cannot be used when normals spread over more than a hemisphere
+				float minDot = 1.0f;
+				const float axisLength = internalLength(axis);
+				meshlet.coneAxis = axisLength > 0.0f ? axis / axisLength : v3f({ 0, 0, 1 });
+				for (int t = first; t < last && axisLength > 0.0f; t++)
+				{
+					const v3f& a = vertices[sorted[3 * t]];
+					const v3f n = internalCross(vertices[sorted[3 * t + 1]] - a, vertices[sorted[3 * t + 2]] - a);
+					const float length = internalLength(n);
+					if (length > 0.0f)
+						minDot = std::min(minDot, internalDot(n, meshlet.coneAxis) / length);
+				}
+				meshlet.coneCutoff = (axisLength == 0.0f || minDot <= 0.1f) ? 1.0f : std::sqrt(1.0f - minDot * minDot);
+			}
+		}, 256);
+		obj.meshletConeCulling = coneCulling;
+
+		// Upload the reordered triangles; the normal adjacency refers to triangle indices and must be rebuilt
+		glBindVertexArray(obj.vao);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj.triangleBuffer);
+		glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(int) * sorted.size(), &sorted.front());
+		if (obj.adjacencyBuffer != 0)
+			glDeleteBuffers(1, &obj.adjacencyBuffer);
+		obj.adjacencyBuffer = 0;
+		obj.cpuAdjacency.clear();
+		obj.cpuTriangles.clear();
 	}
 
 	/*!
-	\brief Returns true of the user closed the window or pressed escape, and false otherwise.
+	\brief Show or hide an object, and its descendants in the scene graph. Hidden objects keep their data on the GPU,
+	so that toggling is free.
+	\param id object id
+	\param visible visibility flag
 	*/
-	bool shouldQuit()
+	void setVisible(int id, bool visible)
 	{
-		return glfwWindowShouldClose(windowPtr) || glfwGetKey(windowPtr, GLFW_KEY_ESCAPE);
+		assert(id < int(internalObjects.size()));
+		if (internalObjects[id].isVisible == visible)
+			return;
+		internalScene.sceneVersion++;
+		internalObjects[id].isVisible = visible;
+		internalDrawListDirty = true;
 	}
 
-	/*
-	\brief Check if a given key has been pressed in the last frame.
-	\param key the key
+	/*!
+	\brief Set the layers an object belongs to, as a bitmask. Objects are in layer 1 by default.
+	\param id object id
+	\param layers layer bitmask
 	*/
-	bool getKey(int key)
+	void setLayers(int id, unsigned int layers)
 	{
-		return bool(glfwGetKey(windowPtr, key));
+		assert(id < int(internalObjects.size()));
+		if (internalObjects[id].layers == layers)
+			return;
+		internalScene.sceneVersion++;
+		internalObjects[id].layers = layers;
+		internalDrawListDirty = true;
 	}
 
 	/*!
-	\brief Returns the current delta time between two frames.
+	\brief Set the mask of visible layers: an object is drawn only if one of its layers is in the mask.
+	\param mask layer bitmask, all layers by default
 	*/
-	float deltaTime()
+	void setVisibleLayers(unsigned int mask)
 	{
-		return internalScene.deltaTime;
+		if (internalScene.visibleLayers == mask)
+			return;
+		internalScene.sceneVersion++;
+		internalScene.visibleLayers = mask;
+		internalDrawListDirty = true;
 	}
 
 	/*!
-	\brief Returns the elapsed time since window initialiazation.
+	\brief Returns the parent of an object in the scene graph, -1 for roots.
+	\param id object id
 	*/
-	float globalTime()
+	int getParent(int id)
 	{
-		return float(glfwGetTime());
+		assert(id < int(internalObjects.size()));
+		return internalObjects[id].parent;
 	}
 
-	/*
-	\brief Update function. Applies camera movements.
+	/*!
+	\brief Removes an object from the internal hierarchy, given its id.
+	\param id identifier
+	\returns true of removal is successfull false otherwise.
 	*/
-	void update()
+	bool removeObject(int id)
 	{
-		float currentFrame = float(glfwGetTime());
-		internalScene.deltaTime = currentFrame - internalScene.lastFrame;
-		internalScene.lastFrame = currentFrame;
+		internalScene.sceneVersion++;
+		assert(id < internalObjects.size());
+		return _internalDeleteObject(id);
+	}
 
-		// Keyboard
-		float x = 0.0f, y = 0.0f, z = 0.0f, xPlane = 0.0f, yPlane = 0.0f;
-		if (glfwGetKey(windowPtr, GLFW_KEY_LEFT))
-			x -= 0.1f;
-		if (glfwGetKey(windowPtr, GLFW_KEY_RIGHT))
-			x += 0.1f;
-		if (glfwGetKey(windowPtr, GLFW_KEY_UP))
-			y += 0.1f;
-		if (glfwGetKey(windowPtr, GLFW_KEY_DOWN))
-			y -= 0.1f;
-		if (glfwGetKey(windowPtr, GLFW_KEY_PAGE_UP))
-			z += 0.1f;
-		if (glfwGetKey(windowPtr, GLFW_KEY_PAGE_DOWN))
-			z -= 0.1f;
+	/*!
+	\brief Update an object with new data, given its id. Note that the internal object (with id as an identifier) should
+	already be initialized.	The update must also only be be with data of same size; it will fail if you change the
+	internal array sizes.
+	\param id identifier
+	\param obj new object data
+	\returns true of update is successfull, false otherwise.
+	*/
+	void updateObject(int id, const object& obj)
+	{
+		internalScene.sceneVersion++;
+		assert(id < internalObjects.size());
+		if (!_internalCheckHasGeometry(id))
+			return;
+		internalObjects[id].meshlets.clear();
+		if (internalObjects[id].subdivision)
+		{
+			// Subdivision surface: obj is the control cage, with the same topology
+			assert(obj.vertices.size() == size_t(internalObjects[id].subdivision->cageVertexCount));
+			object refined;
+			_internalRefineObject(*internalObjects[id].subdivision, obj, refined);
+			_internalUpdateObject(id, refined);
+		}
+		else
+			_internalUpdateObject(id, obj);
+	}
 
-		// Mouse
-		double xpos, ypos;
-		glfwGetCursorPos(windowPtr, &xpos, &ypos);
-		int state = glfwGetMouseButton(windowPtr, GLFW_MOUSE_BUTTON_LEFT);
-		if (state == GLFW_PRESS && !internalScene.isMouseOverGui)
+	/*!
+	\brief Update the vertex positions of an object given its id. Only positions are uploaded: normals are recomputed
+	on the GPU when compute shaders are available (OpenGL 4.3), and on the CPU otherwise.
+	\param id object id
+	\param vertices new vertex positions. Must be of the same size as the vertex array of the existing object.
+	*/
+	void updateVertices(int id, const std::vector<v3f>& vertices)
+	{
+		internalScene.sceneVersion++;
+		assert(id < int(internalObjects.size()));
+		if (!_internalCheckHasGeometry(id))
+			return;
+		object_internal& obj = internalObjects[id];
+		obj.meshlets.clear();
+
+		// Subdivision surfaces: vertices are the control vertices, refined once
+		std::vector<v3f> refined;
+		if (obj.subdivision)
+		{
+			assert(vertices.size() == size_t(obj.subdivision->cageVertexCount));
+			refined = _internalRefine(*obj.subdivision, vertices);
+		}
+		const std::vector<v3f>& positions = obj.subdivision ? refined : vertices;
+		assert(positions.size() == size_t(obj.vertexCount));
+		_internalUpdateVertices(id, positions);
+		if (obj.hasBounds)
+			_internalComputeBounds(positions, obj.boundsMin, obj.boundsMax);
+	}
+
+	/*!
+	\brief Store morph targets (or keyframes) of an object on the GPU. Once stored, animating the object only requires
+	setting a few weights per frame with setMorphWeights or setMorphKeyframe, and blending happens in the vertex shader.
+	\param id object id
+	\param targets target vertex positions. Each must be of the same size as the vertex array of the existing object.
+	\param targetNormals optional target normals, either empty or with one array per target.
+	Targets are rejected if the texture buffer of the object (or of its largest chunk) would exceed
+	GL_MAX_TEXTURE_BUFFER_SIZE texels, one per vertex and per target, twice as many with normals. Out-of-core objects,
+	whose buffers may be evicted, cannot have morph targets.
+	*/
+	void setMorphTargets(int id, const std::vector<std::vector<v3f>>& targets, const std::vector<std::vector<v3f>>& targetNormals)
+	{
+		internalScene.sceneVersion++;
+		assert(id < int(internalObjects.size()));
+		assert(!targets.empty());
+		assert(targetNormals.empty() || targetNormals.size() == targets.size());
+		if (!_internalCheckHasGeometry(id))
+			return;
+		object_internal& obj = internalObjects[id];
+		if (obj.streamId != -1)
 		{
-			float xoffset = float(xpos) - internalScene.mouseLastX;
+			fprintf(stderr, "Object %d is out-of-core, its buffers may be evicted and cannot hold morph targets\n", id);
+			return;
+		}
 
-			// Reversed since y-coordinates go from bottom to top
-			float yoffset = internalScene.mouseLastY - float(ypos);
-			x += (xoffset * internalScene.mouseSensitivity);
-			y += (yoffset * internalScene.mouseSensitivity);
+		// Texel count of the largest texture buffer
+		int vertexCount = obj.vertexCount;
+		if (!obj.chunks.empty())
+		{
+			vertexCount = 0;
+			for (const object_internal& chunk : obj.chunks)
+				vertexCount = std::max(vertexCount, chunk.vertexCount);
 		}
-		state = glfwGetMouseButton(windowPtr, GLFW_MOUSE_BUTTON_MIDDLE);
-		if (state == GLFW_PRESS && !internalScene.isMouseOverGui)
+		GLint maxTexels = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &maxTexels);
+		const long long texelCount = (long long)vertexCount * (long long)targets.size() * (targetNormals.empty() ? 1 : 2);
+		if (texelCount > (long long)maxTexels)
 		{
-			float xoffset = float(xpos) - internalScene.mouseLastX;
-			float yoffset = float(ypos) - internalScene.mouseLastY;
-			xPlane += (xoffset * internalScene.mouseSensitivity);
-			yPlane += (yoffset * internalScene.mouseSensitivity);
+			fprintf(stderr, "Morph targets of object %d need %lld texels, more than the maximum texture buffer size (%d)\n", id, texelCount, maxTexels);
+			return;
+		}
+		obj.meshlets.clear();
+		obj.morphDropWarned = false;
+		if (obj.chunks.empty())
+			_internalSetMorphTargets(obj, targets, targetNormals);
+		else
+		{
+			// Split objects: each chunk stores the targets of its own vertices, and shares the weights of the object
+			std::vector<std::vector<v3f>> chunkTargets(targets.size()), chunkNormals(targetNormals.size());
+			for (object_internal& chunk : obj.chunks)
+			{
+				for (size_t k = 0; k < targets.size(); k++)
+					_internalGatherChunk(chunk, targets[k], chunkTargets[k]);
+				for (size_t k = 0; k < targetNormals.size(); k++)
+					_internalGatherChunk(chunk, targetNormals[k], chunkNormals[k]);
+				_internalSetMorphTargets(chunk, chunkTargets, chunkNormals);
+			}
+			obj.morphCount = int(targets.size());
+			obj.morphNormals = !targetNormals.empty();
+			obj.morphActiveCount = 0;
 		}
+		obj.hasBounds = false;
+	}
 
-		// Scale speed based on distance to the look at point
-		float scale = internalLength(internalScene.at - internalScene.eye);
-		scale = scale > 100.0f ? 100.0f : scale;
-		x *= scale * internalScene.camSpeed * 0.55f;
-		y *= scale * internalScene.camSpeed * 0.55f;
-		z *= scale * internalScene.camSpeed * 0.025f;
-		xPlane *= scale * internalScene.camSpeed;
-		yPlane *= scale * internalScene.camSpeed;
+	/*!
+	\brief Set the blend weights of the morph targets of an object. The displayed vertices are the
+	original ones plus the weighted offsets to each target. At most 8 targets are blended: when more weights are
+	non-zero, only the 8 largest in magnitude are used, and a warning is printed once per object.
+	\param id object id
+	\param weights one weight per morph target.
+	*/
+	void setMorphWeights(int id, const std::vector<float>& weights)
+	{
+		internalScene.sceneVersion++;
+		assert(id < int(internalObjects.size()));
+		object_internal& obj = internalObjects[id];
+		assert(weights.size() <= size_t(obj.morphCount));
 
-		// Apply everything
-		_internalCameraMove(x, y, z, xPlane, yPlane);
+		std::vector<int> order;
+		for (int k = 0; k < int(weights.size()); k++)
+		{
+			if (weights[k] != 0.0f)
+				order.push_back(k);
+		}
+		std::sort(order.begin(), order.end(), [&weights](int a, int b) { return std::abs(weights[a]) > std::abs(weights[b]); });
 
-		// Store last mouse pos
-		internalScene.mouseLastX = float(xpos);
-		internalScene.mouseLastY = float(ypos);
+		if (int(order.size()) > internalMaxActiveMorphTargets && !obj.morphDropWarned)
+		{
+			fprintf(stderr, "Object %d has %d non-zero morph weights, only the %d largest are blended\n", id, int(order.size()), internalMaxActiveMorphTargets);
+			obj.morphDropWarned = true;
+		}
+		obj.morphActiveCount = std::min(int(order.size()), internalMaxActiveMorphTargets);
+		for (int i = 0; i < obj.morphActiveCount; i++)
+		{
+			obj.morphIndices[i] = order[i];
+			obj.morphWeights[i] = weights[order[i]];
+		}
 	}
 
 	/*!
-	\brief Performs rendering and swap window buffers.
+	\brief Display an object at a given time in its keyframe sequence, where morph targets are treated as keyframes.
+	The two enclosing keyframes are linearly interpolated.
+	\param id object id
+	\param t keyframe time in [0, targetCount - 1]. Values outside this range are clamped.
 	*/
-	void render()
+	void setMorphKeyframe(int id, float t)
 	{
-		// Clear
-		glClearColor(0.2f, 0.3f, 0.3f, 1.0f);
-		glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-		// Camera matrices
-		float viewMatrix[4][4] = { 0 }, projectionMatrix[4][4] = { 0 };
-		_internalCameraLookAt(viewMatrix);
-		_internalCameraPerspective(projectionMatrix);
-
-		// Precomputed uniform values
-		const float wireframeThicknessX = float(width_internal) / internalScene.wireframeThickness;
-		const float wireframeThicknessY = float(height_internal) / internalScene.wireframeThickness;
+		internalScene.sceneVersion++;
+		assert(id < int(internalObjects.size()));
+		object_internal& obj = internalObjects[id];
+		assert(obj.morphCount > 0);
 
-		// Render all objects
-		v3f normalizedLight = internalNormalize(internalScene.lightDir);
-		for (int i = 0; i < internalObjects.size(); i++)
+		t = std::max(0.0f, std::min(t, float(obj.morphCount - 1)));
+		const int k = std::min(int(t), obj.morphCount - 1);
+		const float a = t - float(k);
+		obj.morphActiveCount = 1;
+		obj.morphIndices[0] = k;
+		obj.morphWeights[0] = 1.0f - a;
+		if (a > 0.0f)
 		{
-			object_internal& it = internalObjects[i];
-			if (it.isDeleted)
-				continue;
-
-			// Always use the shader 0 for now.
-			GLuint shaderID = internalShaders[0];
+			obj.morphActiveCount = 2;
+			obj.morphIndices[1] = k + 1;
+			obj.morphWeights[1] = a;
+		}
+	}
 
-			glUseProgram(shaderID);
-			glUniformMatrix4fv(glGetUniformLocation(shaderID, "uProjection"), 1, GL_FALSE, &projectionMatrix[0][0]);
-			glUniformMatrix4fv(glGetUniformLocation(shaderID, "uView"), 1, GL_FALSE, &viewMatrix[0][0]);
-			glUniformMatrix4fv(glGetUniformLocation(shaderID, "uModel"), 1, GL_FALSE, &it.modelMatrix[0][0]);
-			glUniform3f(glGetUniformLocation(shaderID, "uLightDir"), normalizedLight[0], normalizedLight[1], normalizedLight[2]);
-			glUniform1i(glGetUniformLocation(shaderID, "uDoLighting"), int(internalScene.doLighting));
-			glUniform1i(glGetUniformLocation(shaderID, "uDrawWireframe"), int(internalScene.drawWireframe));
-			glUniform2f(glGetUniformLocation(shaderID, "uWireframeThickness"), wireframeThicknessX, wireframeThicknessY);
-			glUniform1i(glGetUniformLocation(shaderID, "uShowNormals"), int(internalScene.showNormals));
+	/*!
+	\brief Add an object whose vertices are streamed from a time series container file, see exportTimeSeriesFile.
+	Frames are read ahead of the playback position by a prefetch thread, and uploaded into two alternating GPU buffers.
+	Normals are recomputed for each frame, on the GPU when compute shaders are available. The object starts paused on
+	the first frame.
+	\param filename container file
+	\returns the id of the object in the hierarchy, or -1 if the file could not be read.
+	*/
+	int addTimeSeries(const char* filename)
+	{
+		std::ifstream in(filename, std::ios::binary);
+		char magic[4] = { 0 };
+		int header[4] = { 0 };
+		in.read(magic, 4);
+		in.read((char*)header, sizeof(header));
+		if (!in || magic[0] != 'T' || magic[1] != 'R' || magic[2] != 'T' || magic[3] != 'S' || header[0] != 1 ||
+			header[1] <= 0 || header[2] <= 0 || header[2] % 3 != 0 || header[3] <= 0)
+		{
+			fprintf(stderr, "Could not read time series file %s\n", filename);
+			return -1;
+		}
 
-			glBindVertexArray(it.vao);
-			glDrawElements(GL_TRIANGLES, it.triangleCount, GL_UNSIGNED_INT, 0);
+		// The file must hold the topology and every frame
+		in.seekg(0, std::ios::end);
+		const unsigned long long fileSize = (unsigned long long)in.tellg();
+		in.seekg(4 + sizeof(header));
+		const unsigned long long expectedSize = 4 + sizeof(header) + sizeof(int) * (unsigned long long)header[2] +
+			sizeof(v3f) * (unsigned long long)header[1] * (unsigned long long)header[3];
+		if (!in || fileSize < expectedSize)
+		{
+			fprintf(stderr, "Time series file %s is truncated\n", filename);
+			return -1;
+		}
+		if (header[2] / 3 > internalMaxChunkTriangles)
+		{
+			fprintf(stderr, "Time series %s has more than %d triangles, and cannot be streamed into a single buffer\n", filename, internalMaxChunkTriangles);
+			return -1;
 		}
 
-		// Prepare imgui frame for later
-		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplGlfw_NewFrame();
-		ImGui::NewFrame();
+		std::unique_ptr<timeseries_internal> seriesPtr(new timeseries_internal());
+		timeseries_internal& series = *seriesPtr;
+		series.vertexCount = header[1];
+		series.frameCount = header[3];
 
-		// Internal imgui
+		// Topology and first frame
+		object obj;
+		obj.triangles.resize(header[2]);
+		obj.vertices.resize(series.vertexCount);
+		in.read((char*)&obj.triangles.front(), sizeof(int) * obj.triangles.size());
+		series.dataOffset = in.tellg();
+		in.read((char*)&obj.vertices.front(), sizeof(v3f) * obj.vertices.size());
+		if (!in)
 		{
-			ImGui::Begin("Rendering");
-			internalScene.isMouseOverGui = ImGui::IsWindowHovered() || ImGui::IsAnyItemHovered();
-			if (ImGui::Checkbox("Lighting", &internalScene.doLighting))
-				setDoLighting(internalScene.doLighting);
-			if (ImGui::Checkbox("Wireframe", &internalScene.drawWireframe))
-				setDrawWireframe(internalScene.drawWireframe);
-			if (ImGui::SliderFloat("Wireframe thickness", &internalScene.wireframeThickness, 1.0f, 2.0f))
-				setWireframeThickness(internalScene.wireframeThickness);
-			if (ImGui::Checkbox("Show Normals", &internalScene.showNormals))
-				setShowNormals(internalScene.showNormals);
-			ImGui::Text("Light direction");
-			ImGui::DragFloat("x", &internalScene.lightDir.x, 0.1f, -1.0f, 1.0f);
-			ImGui::DragFloat("y", &internalScene.lightDir.y, 0.1f, -1.0f, 1.0f);
-			ImGui::DragFloat("z", &internalScene.lightDir.z, 0.1f, -1.0f, 1.0f);
+			fprintf(stderr, "Could not read time series file %s\n", filename);
+			return -1;
+		}
+		for (int v : obj.triangles)
+		{
+			if (v < 0 || v >= series.vertexCount)
+			{
+				fprintf(stderr, "Time series file %s has a triangle index out of range\n", filename);
+				return -1;
+			}
+		}
+		_internalBuildVertexFaceAdjacency(obj.triangles, series.vertexCount, series.adjacency);
+		_internalComputeNormals(obj.vertices, obj.triangles, series.adjacency, obj.normals);
+		series.objectId = addObject(obj);
+		internalObjects[series.objectId].hasBounds = false;
 
-			ImGui::Separator();
-			ImGui::Text("%.3f ms/frame (%.1f FPS)", 1000.0f / float(ImGui::GetIO().Framerate), float(ImGui::GetIO().Framerate));
+		series.cpuNormals = !internalScene.hasComputeShaders;
+		if (series.cpuNormals)
+			series.triangles.swap(obj.triangles);
+		else
+			series.adjacency.clear();
 
-			ImGui::End();
+		// Stream buffers, the first one holding the first frame
+		const size_t size = sizeof(v3f) * series.vertexCount;
+		glGenBuffers(2, series.streamBuffers);
+		for (int i = 0; i < 2; i++)
+		{
+			glBindBuffer(GL_ARRAY_BUFFER, series.streamBuffers[i]);
+			glBufferData(GL_ARRAY_BUFFER, 2 * size, nullptr, GL_STREAM_DRAW);
 		}
-	}
+		glBindBuffer(GL_ARRAY_BUFFER, series.streamBuffers[0]);
+		glBufferSubData(GL_ARRAY_BUFFER, 0, size, &obj.vertices.front());
+		glBufferSubData(GL_ARRAY_BUFFER, size, size, &obj.normals.front());
+		glBindVertexArray(internalObjects[series.objectId].vao);
+		glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, (const void*)0);
+		glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 0, (const void*)size);
 
-	/*!
-	\brief End the current frame. Must be called after update, render, and
-	custom dear imgui calls.
-	*/
-	void swap()
-	{
-		ImGui::EndFrame();
-		ImGui::Render();
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-
-		glfwSwapBuffers(windowPtr);
-		glfwPollEvents();
+		// Prefetch thread
+		series.slots.resize(8);
+		series.thread = std::thread(_internalTimeSeriesPrefetch, &series, std::string(filename));
+		internalTimeSeries.push_back(std::move(seriesPtr));
+		return series.objectId;
 	}
 
 	/*!
-	\brief Free allocated data and terminate window context.
+	\brief Set the playback speed of a time series object.
+	\param id object id, as returned by addTimeSeries
+	\param framesPerSecond playback speed. Negative values play backwards, and 0 pauses.
+	\param loop should playback wrap around at the ends of the sequence, or stop.
 	*/
-	void terminate()
+	void setTimeSeriesPlayback(int id, float framesPerSecond, bool loop)
 	{
-		for (int i = 0; i < internalObjects.size(); i++)
-			_internalDeleteObject(i);
-		internalObjects.clear();
-		glfwTerminate();
+		for (auto& series : internalTimeSeries)
+		{
+			if (series->objectId == id)
+			{
+				std::lock_guard<std::mutex> lock(series->mutex);
+				series->speed = framesPerSecond;
+				series->loop = loop;
+			}
+		}
 	}
 
-
 	/*!
-	\brief Add an object to the internal hierarchy. The object must be initialized in a specific way.
-	Vertex and normal arrays should be of the same size, and the triangle array refers to both vertex and normal indices.
-	Colors are optionals and will be set to grey by default.
-	\param object new object with properly initialized vectors.
-	\returns the id of the object in the hierarchy.
+	\brief Move the playback position of a time series object (scrubbing).
+	\param id object id, as returned by addTimeSeries
+	\param frame new playback position, in frames.
 	*/
-	int addObject(const object& obj)
+	void setTimeSeriesFrame(int id, float frame)
 	{
-		object_internal internalObject = _internalCreateObject(obj);
-		int index = _internalGetNextFreeIndex();
-		if (index == internalObjects.size())
-			internalObjects.push_back(internalObject);
-		else
-			internalObjects[index] = internalObject;
-		return index;
+		for (auto& series : internalTimeSeries)
+		{
+			if (series->objectId == id)
+				series->time = std::max(0.0f, std::min(frame, float(series->frameCount - 1)));
+		}
 	}
 
 	/*!
-	\brief Removes an object from the internal hierarchy, given its id.
-	\param id identifier
-	\returns true of removal is successfull false otherwise.
+	\brief Returns the number of frames of a time series object.
+	\param id object id, as returned by addTimeSeries
 	*/
-	bool removeObject(int id)
+	int getTimeSeriesFrameCount(int id)
 	{
-		assert(id < internalObjects.size());
-		return _internalDeleteObject(id);
+		for (const auto& series : internalTimeSeries)
+		{
+			if (series->objectId == id)
+				return series->frameCount;
+		}
+		return 0;
 	}
 
 	/*!
-	\brief Update an object with new data, given its id. Note that the internal object (with id as an identifier) should
-	already be initialized.	The update must also only be be with data of same size; it will fail if you change the
-	internal array sizes.
-	\param id identifier
-	\param obj new object data
-	\returns true of update is successfull, false otherwise.
+	\brief Returns the number of frames that were not ready in time during playback of a time series object.
+	\param id object id, as returned by addTimeSeries
 	*/
-	void updateObject(int id, const object& obj)
+	int getTimeSeriesDroppedFrames(int id)
 	{
-		assert(id < internalObjects.size());
-		_internalUpdateObject(id, obj);
+		for (const auto& series : internalTimeSeries)
+		{
+			if (series->objectId == id)
+				return series->droppedFrames;
+		}
+		return 0;
 	}
 
 	/*!
 	\brief Update an object with a new position and scale, given its id. The internal object whould already be initialized.
+	The transform is relative to the parent of the object; children follow on the next render.
 	\param id identifier
 	\param pos new position
 	\param scale new scale
 	*/
 	void updateObject(int id, const v3f& position, const v3f& scale)
 	{
+		internalScene.sceneVersion++;
 		assert(id < internalObjects.size());
-		object_internal& obj = internalObjects[id];
-		_internalComputeModelMatrix(obj.modelMatrix, position, scale);
+		_internalSetLocalTransform(id, position, scale);
 	}
 
 	/*!
@@ -789,11 +7015,61 @@ namespace tinyrender
 	*/
 	void updateObject(int id, const std::vector<v3f>& newColors)
 	{
+		internalScene.sceneVersion++;
 		assert(id < internalObjects.size());
 		assert(!newColors.empty());
+		if (!_internalCheckHasGeometry(id))
+			return;
 		_internalUpdateObject(id, newColors);
 	}
 
+	/*!
+	\brief Update the per-vertex scalar field of an object given its id. Scalars are mapped to colors in the shader
+	through the colormap, so only 4 bytes per vertex are uploaded. The scalar range is recomputed from the new values.
+	If the object had no scalar field, one is created and overrides the object colors.
+	\param id object id
+	\param values new per-vertex scalar array. Must be of the same size as the vertex array of the existing object.
+	*/
+	void updateScalars(int id, const std::vector<float>& values)
+	{
+		internalScene.sceneVersion++;
+		assert(id < int(internalObjects.size()));
+		assert(values.size() == size_t(internalObjects[id].vertexCount));
+		if (!_internalCheckHasGeometry(id))
+			return;
+		object_internal& obj = internalObjects[id];
+		if (obj.chunks.empty())
+		{
+			glBindVertexArray(obj.vao);
+			_internalUploadScalars(obj, values);
+			return;
+		}
+		std::vector<float> chunkValues;
+		for (object_internal& chunk : obj.chunks)
+		{
+			_internalGatherChunk(chunk, values, chunkValues);
+			glBindVertexArray(chunk.vao);
+			_internalUploadScalars(chunk, chunkValues);
+		}
+		_internalScalarRange(values, obj.scalarRange);
+	}
+
+	/*!
+	\brief Override the scalar range mapped to the colormap for a given object. The range is
+	recomputed automatically on the next scalar update.
+	\param id object id
+	\param minValue scalar mapped to the first color of the colormap
+	\param maxValue scalar mapped to the last color of the colormap
+	*/
+	void setScalarRange(int id, float minValue, float maxValue)
+	{
+		internalScene.sceneVersion++;
+		assert(id < int(internalObjects.size()));
+		object_internal& obj = internalObjects[id];
+		obj.scalarRange[0] = minValue;
+		obj.scalarRange[1] = std::max(maxValue, minValue + 1e-6f);
+	}
+
 
 	/*!
 	\brief Set the lighting flag (ie. should diffuse light be computed or not)
@@ -832,6 +7108,86 @@ namespace tinyrender
 		internalScene.showNormals = showNormals;
 	}
 
+	/*!
+	\brief Enable the frame budget controller. While the camera moves, the scene is rendered offscreen at a
+	resolution that adapts to hold the frame budget, and upscaled with bilinear filtering. Full resolution is restored
+	once the camera has been idle for a given number of frames.
+	\param enabled
+	\param frameBudget target GPU time of the scene, in milliseconds
+	\param idleFrames number of idle frames before full quality is restored
+	\param simplifyWhileMoving also disable lighting and wireframe while the camera moves
+	*/
+	void setDynamicResolution(bool enabled, float frameBudget, int idleFrames, bool simplifyWhileMoving)
+	{
+		internalScene.dynamicResolution = enabled;
+		internalScene.frameBudget = frameBudget;
+		internalScene.idleFramesBeforeFullQuality = idleFrames;
+		internalScene.simplifyWhileMoving = simplifyWhileMoving;
+		internalScene.resolutionScale = 1.0f;
+	}
+
+	/*!
+	\brief Enable progressive anti-aliasing. When the camera and the scene do not change, each new frame is rendered
+	with a sub-pixel jittered projection and averaged with the previous ones, converging to a supersampled image.
+	Any change restarts accumulation, so interactive frames cost a single sample.
+	\param enabled
+	\param maxSamples number of accumulated samples, after which the converged image is displayed as is.
+	*/
+	void setProgressiveAccumulation(bool enabled, int maxSamples)
+	{
+		internalAccumulation.isEnabled = enabled;
+		internalAccumulation.maxSamples = std::max(1, maxSamples);
+		internalAccumulation.sampleCount = 0;
+	}
+
+	/*!
+	\brief Enable software occlusion culling: objects hidden behind occluders, see setOccluder, are not drawn.
+	\param enabled occlusion culling flag
+	\param maxOccluders number of occluders rasterized per frame, selected by projected size
+	*/
+	void setOcclusionCulling(bool enabled, int maxOccluders)
+	{
+		internalScene.sceneVersion++;
+		internalOcclusion.isEnabled = enabled;
+		internalOcclusion.maxOccluders = std::max(1, maxOccluders);
+	}
+
+	/*!
+	\brief Set the anti-aliasing mode of the final image. Post-process filters (FXAA, SMAA) cost a fullscreen pass,
+	while multisampling (MSAA) multiplies the cost of the scene pass.
+	\param mode anti-aliasing mode
+	*/
+	void setAntiAliasing(antialiasing mode)
+	{
+		internalScene.antialiasingMode = mode;
+
+		// The multisampled target is only needed by MSAA modes
+		if (mode != antialiasing::msaa2 && mode != antialiasing::msaa4 && mode != antialiasing::msaa8)
+			_internalDeleteFramebuffer(internalMultisampleTarget);
+	}
+
+	/*!
+	\brief Measure the GPU cost of each anti-aliasing mode when rendering the current scene at 1920x1080 and
+	3840x2160, averaged over a number of frames. The measurement is queued and runs in small batches from update(),
+	so that the application stays responsive. Results are displayed in the Rendering panel, where multisampled modes
+	beyond GL_MAX_SAMPLES are reported as skipped.
+	\param frames number of frames rendered per mode and resolution
+	*/
+	void benchmarkAntiAliasing(int frames)
+	{
+		if (internalBenchmark.isRunning)
+			return;
+		internalBenchmark.isRunning = true;
+		internalBenchmark.frames = std::max(1, frames);
+		internalBenchmark.step = 0;
+		internalBenchmark.framesLeft = -1;
+		internalBenchmark.elapsedMs = 0.0;
+		internalBenchmark.isQueryPending = false;
+		glGetIntegerv(GL_MAX_SAMPLES, &internalBenchmark.maxSamples);
+		if (internalBenchmark.query == 0)
+			glGenQueries(1, &internalBenchmark.query);
+	}
+
 	/*!
 	\brief Set the camera eye position.
 	\param x
@@ -843,6 +7199,7 @@ namespace tinyrender
 		internalScene.eye.x = x;
 		internalScene.eye.y = y;
 		internalScene.eye.z = z;
+		internalScene.cameraMoved = true;
 	}
 
 	/*!
@@ -854,6 +7211,7 @@ namespace tinyrender
 		internalScene.at.x = x;
 		internalScene.at.y = y;
 		internalScene.at.z = z;
+		internalScene.cameraMoved = true;
 	}
 
 	/*
@@ -878,6 +7236,76 @@ namespace tinyrender
 		internalScene.lightDir.z = z;
 	}
 
+	/*!
+	\brief Add a point light to the scene. Point lights are combined with the directional light when lighting is
+	enabled, using clustered forward shading so that only the lights close to a fragment are evaluated.
+	\param position light position in world space
+	\param color light color, which can exceed 1 for bright lights
+	\param radius distance at which the light contribution fades to zero
+	\returns the id of the light.
+	*/
+	int addPointLight(const v3f& position, const v3f& color, float radius)
+	{
+		internalScene.sceneVersion++;
+		light_internal light;
+		light.position = position;
+		light.color = color;
+		light.radius = radius;
+		for (int i = 0; i < int(internalLights.size()); i++)
+		{
+			if (internalLights[i].isDeleted)
+			{
+				internalLights[i] = light;
+				return i;
+			}
+		}
+		internalLights.push_back(light);
+		return int(internalLights.size()) - 1;
+	}
+
+	/*!
+	\brief Update a point light given its id.
+	\param id light id
+	\param position light position in world space
+	\param color light color
+	\param radius distance at which the light contribution fades to zero
+	*/
+	void updatePointLight(int id, const v3f& position, const v3f& color, float radius)
+	{
+		internalScene.sceneVersion++;
+		assert(id < int(internalLights.size()));
+		light_internal& light = internalLights[id];
+		light.position = position;
+		light.color = color;
+		light.radius = radius;
+	}
+
+	/*!
+	\brief Removes a point light given its id.
+	\param id light id
+	\returns true of removal is successfull false otherwise.
+	*/
+	bool removePointLight(int id)
+	{
+		internalScene.sceneVersion++;
+		assert(id < int(internalLights.size()));
+		if (internalLights[id].isDeleted)
+			return false;
+		internalLights[id].isDeleted = true;
+		return true;
+	}
+
+	/*!
+	\brief Set the colormap used to display scalar fields.
+	\param colors control colors, evenly spaced from the minimum to the maximum of the scalar range.
+	*/
+	void setColormap(const std::vector<v3f>& colors)
+	{
+		internalScene.sceneVersion++;
+		assert(!colors.empty());
+		_internalUploadColormap(colors);
+	}
+
 
 	/*!
 	\brief Add a new sphere object of a given radius centered at the origin.
@@ -887,115 +7315,121 @@ namespace tinyrender
 	*/
 	int addSphere(float r, int n)
 	{
-		object newObj;
-
+		n = std::max(n, 2);
 		const int p = 2 * n;
-		const int s = (2 * n) * (n - 1) + 2;
-		newObj.vertices.resize(s);
-		newObj.normals.resize(s);
+		const int s = p * (n - 1) + 2;
+		meshbuilder builder(s, 4 * n * (n - 1));
+		v3f* vertices = builder.vertices();
+		v3f* normals = builder.normals();
+		v3f* colors = builder.colors();
+		int* triangles = builder.triangles();
 
-		// Create set of vertices
+		// Create set of vertices, one ring of latitude per row
 		const float Pi = 3.14159265358979323846;
 		const float HalfPi = Pi / 2.0f;
 		const float dt = Pi / n;
 		const float df = Pi / n;
-		int k = 0;
-
-		float f = -HalfPi;
-		for (int j = 1; j < n; j++)
+		const int grain = std::max(1, 4096 / p);
+		builder.parallelFor(n - 1, [&](int j)
 		{
-			f += df;
-
-			// Theta
-			float t = 0.0;
-			for (int i = 0; i < 2 * n; i++)
+			const float f = -HalfPi + df * float(j + 1);
+			for (int i = 0; i < p; i++)
 			{
+				// Theta
+				const float t = dt * float(i);
+				const int k = j * p + i;
 				v3f u = { cos(t) * cos(f), sin(f), sin(t) * cos(f) };
-				newObj.normals[k] = u;
-				newObj.vertices[k] = u * r;
-				k++;
-				t += dt;
+				normals[k] = u;
+				vertices[k] = u * r;
+				colors[k] = { 0.5f, 0.5f, 0.5f };
 			}
-		}
+		}, grain);
+
 		// North pole
-		newObj.normals[s - 2] = { 0, 1, 0 };
-		newObj.vertices[s - 2] = { 0, r, 0 };
+		normals[s - 2] = { 0, 1, 0 };
+		vertices[s - 2] = { 0, r, 0 };
+		colors[s - 2] = { 0.5f, 0.5f, 0.5f };
 
 		// South
-		newObj.normals[s - 1] = { 0, -1, 0 };
-		newObj.vertices[s - 1] = { 0, -r, 0 };
+		normals[s - 1] = { 0, -1, 0 };
+		vertices[s - 1] = { 0, -r, 0 };
+		colors[s - 1] = { 0.5f, 0.5f, 0.5f };
 
-		// Reserve space for the smooth triangle array
-		newObj.triangles.reserve(4 * n * (n - 1) * 3);
-
-		// South cap
-		for (int i = 0; i < 2 * n; i++)
+		// South and north caps
+		for (int i = 0; i < p; i++)
 		{
-			newObj.triangles.push_back(s - 1);
-			newObj.triangles.push_back((i + 1) % p);
-			newObj.triangles.push_back(i);
-		}
+			int* south = triangles + 3 * i;
+			south[0] = s - 1;
+			south[1] = (i + 1) % p;
+			south[2] = i;
 
-		// North cap
-		for (int i = 0; i < 2 * n; i++)
-		{
-			newObj.triangles.push_back(s - 2);
-			newObj.triangles.push_back(2 * n * (n - 2) + i);
-			newObj.triangles.push_back(2 * n * (n - 2) + (i + 1) % p);
+			int* north = triangles + 3 * (p + i);
+			north[0] = s - 2;
+			north[1] = p * (n - 2) + i;
+			north[2] = p * (n - 2) + (i + 1) % p;
 		}
 
-		// Sphere
-		for (int j = 1; j < n - 1; j++)
+		// Sphere, one band between two rings per row
+		builder.parallelFor(n - 2, [&](int band)
 		{
-			for (int i = 0; i < 2 * n; i++)
+			const int j = band + 1;
+			int* tri = triangles + 6 * p + 6 * p * band;
+			for (int i = 0; i < p; i++)
 			{
 				const int v0 = (j - 1) * p + i;
 				const int v1 = (j - 1) * p + (i + 1) % p;
 				const int v2 = j * p + (i + 1) % p;
 				const int v3 = j * p + i;
 
-				newObj.triangles.push_back(v0);
-				newObj.triangles.push_back(v1);
-				newObj.triangles.push_back(v2);
-
-				newObj.triangles.push_back(v0);
-				newObj.triangles.push_back(v2);
-				newObj.triangles.push_back(v3);
+				tri[0] = v0; tri[1] = v1; tri[2] = v2;
+				tri[3] = v0; tri[4] = v2; tri[5] = v3;
+				tri += 6;
 			}
-		}
+		}, grain);
 
-		return addObject(newObj);
+		return builder.finish({ -r, -r, -r }, { r, r, r });
 	}
 
 	/*!
 	\brief Creates a subdivided plane object of a given size centered at the origin.
 	\param size total extents of the plane
-	\param n subdivision, ie. number of cells.
-	\return the id of the new plane object
+	\param n subdivision, ie. number of cells, at least 1
+	\return the id of the new plane object, or -1 if n is invalid
 	*/
 	int addPlane(float size, int n)
 	{
+		if (n < 1)
+		{
+			fprintf(stderr, "Plane must have at least one cell\n");
+			return -1;
+		}
 		n = n + 1;
 		v3f a({ -size, 0.0f, -size });
 		v3f b({ size, 0.0f, size });
 		v3f step = (b - a) / float(n - 1);
-		object planeObject;
+		meshbuilder builder(n * n, 2 * (n - 1) * (n - 1));
+		v3f* vertices = builder.vertices();
+		v3f* normals = builder.normals();
+		v3f* colors = builder.colors();
+		int* triangles = builder.triangles();
+		const int grain = std::max(1, 4096 / n);
 
-		// Vertices
-		for (int i = 0; i < n; i++)
+		// Vertices, one row at a time
+		builder.parallelFor(n, [&](int i)
 		{
 			for (int j = 0; j < n; j++)
 			{
-				v3f v = a + v3f({ step.x * i, 0.f, step.z * j });
-				planeObject.vertices.push_back(v);
-				planeObject.normals.push_back({ 0.f, 1.f, 0.f });
-				planeObject.colors.push_back({ 0.7f, 0.7f, 0.7f });
+				const int k = i * n + j;
+				vertices[k] = a + v3f({ step.x * i, 0.f, step.z * j });
+				normals[k] = { 0.f, 1.f, 0.f };
+				colors[k] = { 0.7f, 0.7f, 0.7f };
 			}
-		}
+		}, grain);
 
 		// Triangles
-		for (int i = 0; i < n - 1; i++)
+		builder.parallelFor(n - 1, [&](int i)
 		{
+			int* tri = triangles + 6 * (n - 1) * i;
 			for (int j = 0; j < n - 1; j++)
 			{
 				int v0 = (j * n) + i;
@@ -1004,18 +7438,15 @@ namespace tinyrender
 				int v3 = ((j + 1) * n) + i + 1;
 
 				// tri 0
-				planeObject.triangles.push_back(v0);
-				planeObject.triangles.push_back(v1);
-				planeObject.triangles.push_back(v2);
+				tri[0] = v0; tri[1] = v1; tri[2] = v2;
 
 				// tri 1
-				planeObject.triangles.push_back(v2);
-				planeObject.triangles.push_back(v1);
-				planeObject.triangles.push_back(v3);
+				tri[3] = v2; tri[4] = v1; tri[5] = v3;
+				tri += 6;
 			}
-		}
+		}, grain);
 
-		return addObject(planeObject);
+		return builder.finish(a, b);
 	}
 
 	/*!
@@ -1110,4 +7541,975 @@ namespace tinyrender
 		out.close();
 		return true;
 	}
+
+	/*!
+	\brief Exports a sequence of vertex arrays sharing the same topology as a time series container file, which
+	can then be played back with addTimeSeries. The file stores the 4 characters "TRTS", then the version (1), vertex
+	count, triangle index count and frame count as 32 bit integers, followed by the triangle indices and the vertex
+	positions of each frame.
+	\param filename filename to export
+	\param object object providing the triangles
+	\param frames vertex positions of each frame, each of the same size.
+	*/
+	bool exportTimeSeriesFile(const char* filename, const object& object, const std::vector<std::vector<v3f>>& frames)
+	{
+		std::ofstream out(filename, std::ios::binary);
+		if (out.is_open() == false || frames.empty())
+		{
+			fprintf(stderr, "Could not open file for saving time series - terminating");
+			return false;
+		}
+		const int header[4] = { 1, int(frames[0].size()), int(object.triangles.size()), int(frames.size()) };
+		out.write("TRTS", 4);
+		out.write((const char*)header, sizeof(header));
+		out.write((const char*)&object.triangles.front(), sizeof(int) * object.triangles.size());
+		for (const auto& frame : frames)
+			out.write((const char*)&frame.front(), sizeof(v3f) * frame.size());
+		out.close();
+		return true;
+	}
+
+	/*!
+	\brief Constructor. Allocates the buffers of the object and maps them, so that vertices and triangles are written
+	directly in GPU-visible memory instead of going through an intermediate object. If mapping fails, data is staged
+	on the CPU and uploaded by finish(). Empty meshes are rejected: the builder then owns no buffers, its pointers are
+	null and finish() returns -1.
+	\param vertexCount exact number of vertices, at least 1
+	\param triangleCount exact number of triangles, at least 1
+	*/
+	meshbuilder::meshbuilder(int vertexCount, int triangleCount) : vertexCount(vertexCount), triangleCount(triangleCount)
+	{
+		if (vertexCount < 1 || triangleCount < 1)
+		{
+			fprintf(stderr, "Mesh builder needs at least one vertex and one triangle, got %d and %d\n", vertexCount, triangleCount);
+			this->vertexCount = this->triangleCount = 0;
+			return;
+		}
+		const size_t vertexBytes = sizeof(v3f) * 3 * size_t(this->vertexCount);
+		const size_t triangleBytes = sizeof(int) * 3 * size_t(this->triangleCount);
+		glGenVertexArrays(1, &vao);
+		glBindVertexArray(vao);
+		glGenBuffers(1, &buffers);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers);
+		glBufferData(GL_ARRAY_BUFFER, vertexBytes, nullptr, GL_STATIC_DRAW);
+		for (int k = 0; k < 3; k++)
+		{
+			glVertexAttribPointer(k, 3, GL_FLOAT, GL_FALSE, 0, (const void*)(sizeof(v3f) * size_t(k) * this->vertexCount));
+			glEnableVertexAttribArray(k);
+		}
+		glGenBuffers(1, &triangleBuffer);
+		glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, triangleBuffer);
+		glBufferData(GL_ELEMENT_ARRAY_BUFFER, triangleBytes, nullptr, GL_STATIC_DRAW);
+
+		data = (v3f*)glMapBufferRange(GL_ARRAY_BUFFER, 0, vertexBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		indices = (int*)glMapBufferRange(GL_ELEMENT_ARRAY_BUFFER, 0, triangleBytes, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+		isMapped = data != nullptr && indices != nullptr;
+		if (!isMapped)
+		{
+			if (data != nullptr)
+				glUnmapBuffer(GL_ARRAY_BUFFER);
+			if (indices != nullptr)
+				glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+			stagingVertices.resize(3 * size_t(this->vertexCount));
+			stagingTriangles.resize(3 * size_t(this->triangleCount));
+			data = &stagingVertices.front();
+			indices = &stagingTriangles.front();
+		}
+		glBindVertexArray(0);
+	}
+
+	/*!
+	\brief Destructor. Buffers of a builder that was never finished are released.
+	*/
+	meshbuilder::~meshbuilder()
+	{
+		if (vao == 0)
+			return;
+		if (isMapped)
+		{
+			glBindVertexArray(vao);
+			glBindBuffer(GL_ARRAY_BUFFER, buffers);
+			glUnmapBuffer(GL_ARRAY_BUFFER);
+			glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER);
+			glBindVertexArray(0);
+		}
+		glDeleteBuffers(1, &buffers);
+		glDeleteBuffers(1, &triangleBuffer);
+		glDeleteVertexArrays(1, &vao);
+	}
+
+	/*!
+	\brief Run a generator on rows, or patches, in parallel. Each row must write a disjoint range of the builder.
+	\param count number of rows
+	\param func function called with the index of a row
+	\param grain minimum number of rows per thread
+	*/
+	void meshbuilder::parallelFor(int count, const std::function<void(int)>& func, int grain) const
+	{
+		_internalParallelFor(count, [&](int begin, int end)
+		{
+			for (int i = begin; i < end; i++)
+				func(i);
+		}, grain);
+	}
+
+	/*!
+	\brief Unmap the buffers and add the object to the scene. The builder cannot be used afterwards.
+	\param boundsMin, boundsMax bounding box of the vertices, known by the generator, as mapped memory is not read back
+	\param position, scale transform of the object
+	\returns the id of the new object, or -1 if the contents of the buffers were lost.
+	*/
+	int meshbuilder::finish(const v3f& boundsMin, const v3f& boundsMax, const v3f& position, const v3f& scale)
+	{
+		if (vao == 0)
+		{
+			fprintf(stderr, "Mesh builder is empty or was already finished\n");
+			return -1;
+		}
+		glBindVertexArray(vao);
+		glBindBuffer(GL_ARRAY_BUFFER, buffers);
+		bool isValid = true;
+		if (isMapped)
+		{
+			// Both buffers must be unmapped, even if the first one was corrupted
+			const bool isVertexValid = glUnmapBuffer(GL_ARRAY_BUFFER) == GL_TRUE;
+			const bool isTriangleValid = glUnmapBuffer(GL_ELEMENT_ARRAY_BUFFER) == GL_TRUE;
+			isValid = isVertexValid && isTriangleValid;
+		}
+		else
+		{
+			glBufferSubData(GL_ARRAY_BUFFER, 0, sizeof(v3f) * stagingVertices.size(), &stagingVertices.front());
+			glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, 0, sizeof(int) * stagingTriangles.size(), &stagingTriangles.front());
+			stagingVertices = std::vector<v3f>();
+			stagingTriangles = std::vector<int>();
+		}
+		glBindVertexArray(0);
+		isMapped = false;
+		data = nullptr;
+		indices = nullptr;
+		if (!isValid)
+		{
+			fprintf(stderr, "Mesh builder buffers were lost while mapped\n");
+			return -1;
+		}
+
+		internalScene.sceneVersion++;
+		object_internal ret;
+		_internalComputeModelMatrix(ret.localMatrix, position, scale);
+		_internalComputeModelMatrix(ret.modelMatrix, position, scale);
+		ret.vao = vao;
+		ret.buffers = buffers;
+		ret.triangleBuffer = triangleBuffer;
+		ret.vertexCount = vertexCount;
+		ret.triangleCount = 3 * triangleCount;
+		ret.boundsMin = boundsMin;
+		ret.boundsMax = boundsMax;
+		ret.hasBounds = true;
+		vao = buffers = triangleBuffer = 0;
+		return _internalInsertObject(ret);
+	}
+
+	/*!
+	\brief Constructor. Connectivity is built lazily, on the first query.
+	\param obj triangle mesh, which must outlive the topology
+	*/
+	topology::topology(const object& obj) : mesh(&obj)
+	{
+	}
+
+	/*!
+	\brief Build the half-edge connectivity. Half-edges are paired by sorting their undirected edge keys in parallel,
+	which avoids hash maps. Edges shared by more than two triangles are left unpaired, as boundaries.
+	*/
+	void topology::build() const
+	{
+		isBuilt = true;
+		const int halfedgeCount = int(mesh->triangles.size() / 3 * 3);
+		const int vertexCount = int(mesh->vertices.size());
+
+		// Key of each half-edge: smallest vertex, largest vertex, then the half-edge index
+		struct key_internal
+		{
+			unsigned long long edge;
+			int h;
+			bool operator<(const key_internal& other) const { return edge < other.edge || (edge == other.edge && h < other.h); }
+		};
+		std::vector<key_internal> keys(halfedgeCount);
+		_internalParallelFor(halfedgeCount, [&](int begin, int end)
+		{
+			for (int h = begin; h < end; h++)
+			{
+				const unsigned int a = (unsigned int)from(h), b = (unsigned int)to(h);
+				keys[h].edge = (((unsigned long long)std::min(a, b)) << 32) | (unsigned long long)std::max(a, b);
+				keys[h].h = h;
+			}
+		});
+		_internalParallelSort(keys);
+
+		// Runs of equal keys are the half-edges of one edge
+		opposites.assign(halfedgeCount, -1);
+		edges.clear();
+		for (int i = 0; i < halfedgeCount;)
+		{
+			int j = i + 1;
+			while (j < halfedgeCount && keys[j].edge == keys[i].edge)
+				j++;
+			edges.push_back(keys[i].h);
+			if (j - i == 2 && from(keys[i].h) != from(keys[i + 1].h))
+			{
+				opposites[keys[i].h] = keys[i + 1].h;
+				opposites[keys[i + 1].h] = keys[i].h;
+			}
+			i = j;
+		}
+
+		// One outgoing half-edge per vertex, on the boundary when there is one, so that one-rings are complete
+		outgoing.assign(vertexCount, -1);
+		for (int h = 0; h < halfedgeCount; h++)
+		{
+			const int v = from(h);
+			if (outgoing[v] == -1 || opposites[h] == -1)
+				outgoing[v] = h;
+		}
+	}
+
+	/*!
+	\brief Returns the opposite half-edge, or -1 on boundaries.
+	\param h half-edge
+	*/
+	int topology::opposite(int h) const
+	{
+		if (!isBuilt)
+			build();
+		return opposites[h];
+	}
+
+	/*!
+	\brief Returns an outgoing half-edge of a vertex, on the boundary if the vertex is on a boundary, or -1 for
+	isolated vertices.
+	\param v vertex
+	*/
+	int topology::halfedge(int v) const
+	{
+		if (!isBuilt)
+			build();
+		return outgoing[v];
+	}
+
+	/*!
+	\brief Returns the number of undirected edges.
+	*/
+	int topology::edgeCount() const
+	{
+		if (!isBuilt)
+			build();
+		return int(edges.size());
+	}
+
+	/*!
+	\brief Returns one of the half-edges of an undirected edge.
+	\param e edge index
+	*/
+	int topology::edge(int e) const
+	{
+		if (!isBuilt)
+			build();
+		return edges[e];
+	}
+
+	/*!
+	\brief Returns true if a vertex is on a boundary.
+	\param v vertex
+	*/
+	bool topology::isBoundaryVertex(int v) const
+	{
+		const int h = halfedge(v);
+		return h != -1 && opposites[h] == -1;
+	}
+
+	/*!
+	\brief Returns true if a half-edge has no opposite.
+	\param h half-edge
+	*/
+	bool topology::isBoundaryEdge(int h) const
+	{
+		return opposite(h) == -1;
+	}
+
+	/*!
+	\brief Collect the neighbors of a vertex, turning around it from its outgoing half-edge.
+	\param v vertex
+	\param neighbors returned neighbors
+	*/
+	void topology::oneRing(int v, std::vector<int>& neighbors) const
+	{
+		neighbors.clear();
+		const int start = halfedge(v);
+		if (start == -1)
+			return;
+		int h = start;
+		do
+		{
+			neighbors.push_back(to(h));
+			const int p = prev(h);
+			if (opposites[p] == -1)
+			{
+				neighbors.push_back(from(p));
+				break;
+			}
+			h = opposites[p];
+		} while (h != start);
+	}
+
+	/*!
+	\brief Subdivide a triangle mesh. Positions, colors and scalars are refined, and normals are recomputed.
+	\param obj mesh to subdivide, modified in place
+	\param levels number of subdivision levels
+	\param scheme Loop or Catmull-Clark subdivision. Catmull-Clark output quads are split in two triangles.
+	*/
+	void subdivide(object& obj, int levels, subdivision scheme)
+	{
+		subdivision_internal s;
+		_internalBuildSubdivision(obj.triangles, int(obj.vertices.size()), std::max(0, levels), scheme, s);
+		object refined;
+		_internalRefineObject(s, obj, refined);
+		obj = std::move(refined);
+	}
+
+	/*!
+	\brief Compute vertex normals that keep sharp features. Around each vertex, faces are grouped when they share an
+	edge whose dihedral angle is below the crease angle, and the vertex is duplicated once per group: smooth regions keep
+	shared vertices, and only vertices on creases are split. Vertices are processed in parallel with the vertex-face
+	adjacency. Colors and scalars are copied to the duplicated vertices.
+	\param obj triangle mesh, modified in place
+	\param creaseAngle angle in degrees above which an edge is sharp
+	*/
+	void computeCreaseNormals(object& obj, float creaseAngle)
+	{
+		const int vertexCount = int(obj.vertices.size());
+		const int triangleCount = int(obj.triangles.size() / 3);
+		const float cosCrease = std::cos(toRadian(creaseAngle));
+
+		// Area-weighted face normals, and their unit direction for the crease test
+		std::vector<v3f> faceNormals(triangleCount), faceDirections(triangleCount);
+		_internalParallelFor(triangleCount, [&](int begin, int end)
+			{
+				for (int t = begin; t < end; t++)
+				{
+					const v3f& a = obj.vertices[obj.triangles[3 * t + 0]];
+					const v3f& b = obj.vertices[obj.triangles[3 * t + 1]];
+					const v3f& c = obj.vertices[obj.triangles[3 * t + 2]];
+					faceNormals[t] = internalCross(b - a, c - a);
+					faceDirections[t] = internalLength2(faceNormals[t]) > 0.0f ? internalNormalize(faceNormals[t]) : v3f({ 0, 0, 0 });
+				}
+			});
+		std::vector<int> adjacency;
+		_internalBuildVertexFaceAdjacency(obj.triangles, vertexCount, adjacency);
+		const int offsetCount = vertexCount + 1;
+
+		// Group the faces around each vertex: faces sharing a smooth edge belong to the same group
+		std::vector<int> groups(adjacency.size() - offsetCount);
+		std::vector<int> groupCounts(vertexCount, 0);
+		_internalParallelFor(vertexCount, [&](int begin, int end)
+			{
+				for (int v = begin; v < end; v++)
+				{
+					const int first = adjacency[v], count = adjacency[v + 1] - first;
+					int* group = &groups[first];
+					for (int i = 0; i < count; i++)
+						group[i] = i;
+					auto find = [group](int i)
+					{
+						while (group[i] != i)
+							i = group[i] = group[group[i]];
+						return i;
+					};
+					for (int i = 0; i < count; i++)
+					{
+						const int f = adjacency[offsetCount + first + i];
+						for (int j = i + 1; j < count; j++)
+						{
+							const int g = adjacency[offsetCount + first + j];
+							if (internalDot(faceDirections[f], faceDirections[g]) < cosCrease)
+								continue;
+							bool isShared = false;
+							for (int a = 0; a < 3 && !isShared; a++)
+							{
+								const int w = obj.triangles[3 * f + a];
+								isShared = w != v && (obj.triangles[3 * g + 0] == w || obj.triangles[3 * g + 1] == w || obj.triangles[3 * g + 2] == w);
+							}
+							if (isShared)
+								group[find(i)] = find(j);
+						}
+					}
+
+					// Number the groups from zero, in order of first appearance
+					std::vector<int> roots(count), numbers;
+					for (int i = 0; i < count; i++)
+						roots[i] = find(i);
+					for (int i = 0; i < count; i++)
+					{
+						int k = int(std::find(numbers.begin(), numbers.end(), roots[i]) - numbers.begin());
+						if (k == int(numbers.size()))
+							numbers.push_back(roots[i]);
+						group[i] = k;
+					}
+					groupCounts[v] = std::max(1, int(numbers.size()));
+				}
+			});
+
+		// The first group of a vertex keeps its index, the others are appended
+		std::vector<int> firstDuplicate(vertexCount);
+		int newVertexCount = vertexCount;
+		for (int v = 0; v < vertexCount; v++)
+		{
+			firstDuplicate[v] = newVertexCount - 1;
+			newVertexCount += groupCounts[v] - 1;
+		}
+		obj.vertices.resize(newVertexCount);
+		obj.normals.assign(newVertexCount, v3f({ 0, 0, 0 }));
+		if (!obj.colors.empty())
+			obj.colors.resize(newVertexCount);
+		if (!obj.scalars.empty())
+			obj.scalars.resize(newVertexCount);
+
+		// Each vertex writes its own duplicates and the triangle corners that reference it
+		std::vector<int> triangles(obj.triangles.size());
+		_internalParallelFor(vertexCount, [&](int begin, int end)
+			{
+				for (int v = begin; v < end; v++)
+				{
+					for (int k = adjacency[v]; k < adjacency[v + 1]; k++)
+					{
+						const int f = adjacency[offsetCount + k];
+						const int group = groups[k];
+						const int index = group == 0 ? v : firstDuplicate[v] + group;
+						for (int a = 0; a < 3; a++)
+						{
+							if (obj.triangles[3 * f + a] == v)
+								triangles[3 * f + a] = index;
+						}
+						obj.normals[index] += faceNormals[f];
+					}
+					for (int index = firstDuplicate[v] + 1; index < firstDuplicate[v] + groupCounts[v]; index++)
+					{
+						obj.vertices[index] = obj.vertices[v];
+						if (!obj.colors.empty())
+							obj.colors[index] = obj.colors[v];
+						if (!obj.scalars.empty())
+							obj.scalars[index] = obj.scalars[v];
+					}
+				}
+			});
+		obj.triangles.swap(triangles);
+		for (v3f& n : obj.normals)
+			n = internalLength2(n) > 0.0f ? internalNormalize(n) : v3f({ 0, 1, 0 });
+	}
+
+	/*!
+	\brief Simplify a triangle mesh with quadric error metrics, by collapsing vertices onto their neighbors in order
+	of increasing error. Vertices never move, so that normals, colors and scalars are preserved, and boundary vertices
+	only collapse along the boundary. The mesh is split in a grid of cells simplified in parallel, vertices on cell
+	borders being locked; several passes with shifted grids unlock them. The result can be passed to addObject.
+	\param obj mesh to simplify, modified in place
+	\param targetTriangles number of triangles to reach
+	\param maxError maximum error of a collapse, as a distance, or a negative value for no limit
+	\returns the number of triangles of the simplified mesh.
+	*/
+	int simplify(object& obj, int targetTriangles, float maxError)
+	{
+		const int vertexCount = int(obj.vertices.size());
+		const int triangleCount = int(obj.triangles.size() / 3);
+		if (triangleCount <= targetTriangles || vertexCount == 0)
+			return triangleCount;
+
+		simplify_internal s;
+		s.vertices = obj.vertices;
+		s.triangles = obj.triangles;
+		s.maxError2 = maxError < 0.0f ? std::numeric_limits<float>::max() : maxError * maxError;
+		s.adjacency.resize(vertexCount);
+		for (int t = 0; t < triangleCount; t++)
+		{
+			for (int j = 0; j < 3; j++)
+				s.adjacency[s.triangles[3 * t + j]].push_back(t);
+		}
+
+		// Plane quadrics, and boundary edges found as edges with a single triangle around their first vertex
+		s.quadrics.resize(vertexCount);
+		s.isBoundary.assign(vertexCount, 0);
+		_internalParallelFor(vertexCount, [&s](int begin, int end)
+		{
+			std::vector<int> opposite;
+			for (int u = begin; u < end; u++)
+			{
+				opposite.clear();
+				for (int t : s.adjacency[u])
+				{
+					const int* tri = &s.triangles[3 * t];
+					const v3f n = internalCross(s.vertices[tri[1]] - s.vertices[tri[0]], s.vertices[tri[2]] - s.vertices[tri[0]]);
+					const float length = internalLength(n);
+					if (length > 0.0f)
+						_internalAddPlaneQuadric(s.quadrics[u], n / length, -internalDot(n / length, s.vertices[tri[0]]), 1.0);
+					for (int j = 0; j < 3; j++)
+					{
+						if (tri[j] != u)
+							opposite.push_back(tri[j]);
+					}
+				}
+				std::sort(opposite.begin(), opposite.end());
+				for (size_t i = 0; i < opposite.size(); i++)
+				{
+					const bool isSingle = (i == 0 || opposite[i - 1] != opposite[i]) && (i + 1 == opposite.size() || opposite[i + 1] != opposite[i]);
+					if (!isSingle)
+						continue;
+
+					// Boundary edge: penalize moving away from the plane orthogonal to the adjacent triangle
+					s.isBoundary[u] = 1;
+					const int w = opposite[i];
+					for (int t : s.adjacency[u])
+					{
+						const int* tri = &s.triangles[3 * t];
+						if (tri[0] != w && tri[1] != w && tri[2] != w)
+							continue;
+						const v3f e = s.vertices[w] - s.vertices[u];
+						const v3f n = internalCross(e, internalCross(s.vertices[tri[1]] - s.vertices[tri[0]], s.vertices[tri[2]] - s.vertices[tri[0]]));
+						const float length = internalLength(n);
+						if (length > 0.0f)
+							_internalAddPlaneQuadric(s.quadrics[u], n / length, -internalDot(n / length, s.vertices[u]), 100.0);
+					}
+				}
+			}
+		});
+
+		// Spatial partition in cubic cells, about four per thread
+		v3f boundsMin, boundsMax;
+		_internalComputeBounds(s.vertices, boundsMin, boundsMax);
+		const v3f extent = boundsMax - boundsMin;
+		const int threadCount = std::max(1, int(std::thread::hardware_concurrency()));
+		const float cellSize = std::max(std::max(extent.x, extent.y), std::max(extent.z, 1e-6f)) / std::ceil(std::cbrt(4.0f * float(threadCount)));
+		int gridCells[3];
+		for (int k = 0; k < 3; k++)
+			gridCells[k] = std::max(1, int(std::ceil(extent.v[k] / cellSize)));
+		s.isRemoved.assign(vertexCount, 0);
+		s.stamps.assign(vertexCount, 0);
+		s.vertexCell.resize(vertexCount);
+
+		// Collapses rejected by the topology tests may become valid later, so passes are repeated while progressing.
+		// Once the grid stalls, because most triangles span several cells, a last serial pass finishes the work.
+		int remaining = triangleCount;
+		const int maxPassCount = 16;
+		bool isSerial = gridCells[0] * gridCells[1] * gridCells[2] == 1;
+		for (int pass = 0; pass < maxPassCount && remaining > targetTriangles; pass++)
+		{
+			// Shifted grid at each pass, so that locked borders move
+			const float shift = float(pass % 3) / 3.0f;
+			const int cellCount = isSerial ? 1 : gridCells[0] * gridCells[1] * gridCells[2];
+			for (int v = 0; v < vertexCount; v++)
+			{
+				int cell = 0;
+				for (int k = 2; k >= 0 && !isSerial; k--)
+				{
+					const int c = int((s.vertices[v].v[k] - boundsMin.v[k]) / cellSize + shift) % gridCells[k];
+					cell = cell * gridCells[k] + c;
+				}
+				s.vertexCell[v] = cell;
+			}
+			s.isLocked.assign(vertexCount, 0);
+			std::vector<std::vector<int>> cellTriangles(cellCount);
+			for (int t = 0; t < triangleCount; t++)
+			{
+				const int* tri = &s.triangles[3 * t];
+				if (tri[0] == -1)
+					continue;
+				const int cell = s.vertexCell[tri[0]];
+				if (s.vertexCell[tri[1]] == cell && s.vertexCell[tri[2]] == cell)
+					cellTriangles[cell].push_back(t);
+				else
+					s.isLocked[tri[0]] = s.isLocked[tri[1]] = s.isLocked[tri[2]] = 1;
+			}
+
+			// Each cell removes its share of the triangles
+			const int toRemove = remaining - targetTriangles;
+			std::vector<int> cellRemoved(cellCount, 0);
+			_internalParallelFor(cellCount, [&](int begin, int end)
+			{
+				for (int c = begin; c < end; c++)
+				{
+					const int share = int(std::ceil(double(toRemove) * double(cellTriangles[c].size()) / double(remaining)));
+					if (share > 0)
+						cellRemoved[c] = _internalSimplifyCell(s, cellTriangles[c], share);
+				}
+			}, 1);
+			int removed = 0;
+			for (int c = 0; c < cellCount; c++)
+				removed += cellRemoved[c];
+			remaining -= removed;
+			if (removed < toRemove / 8)
+			{
+				if (isSerial && removed == 0)
+					break;
+				isSerial = true;
+			}
+		}
+
+		// Compact vertices and triangles, keeping the attributes of the remaining vertices
+		std::vector<int> remap(vertexCount, -1);
+		object result;
+		result.position = obj.position;
+		result.scale = obj.scale;
+		for (int t = 0; t < triangleCount; t++)
+		{
+			if (s.triangles[3 * t] == -1)
+				continue;
+			for (int j = 0; j < 3; j++)
+			{
+				const int v = s.triangles[3 * t + j];
+				if (remap[v] == -1)
+				{
+					remap[v] = int(result.vertices.size());
+					result.vertices.push_back(obj.vertices[v]);
+					if (!obj.normals.empty())
+						result.normals.push_back(obj.normals[v]);
+					if (!obj.colors.empty())
+						result.colors.push_back(obj.colors[v]);
+					if (!obj.scalars.empty())
+						result.scalars.push_back(obj.scalars[v]);
+				}
+				result.triangles.push_back(remap[v]);
+			}
+		}
+		obj = std::move(result);
+		return int(obj.triangles.size() / 3);
+	}
+
+	/*!
+	\brief Check a mapped scene snapshot before anything is loaded: counts are checked against the file size, and
+	every object record against the object count, with buffer sizes matching its vertex and triangle counts and
+	triangle indices in range. Chunk records must follow their object, and index vertices of that object.
+	\param mapped mapped snapshot file, at least as large as the header
+	\param header snapshot header
+	\param slotCount number of object slots needed to restore the ids, one past the largest id
+	\returns false if the snapshot is invalid or truncated.
+	*/
+	static bool _internalValidateSnapshot(const mapped_file_internal& mapped, const snapshot_header_internal& header, int& slotCount)
+	{
+		if (header.objectCount < 0 || header.lightCount < 0 || size_t(header.lightCount) > (mapped.size - sizeof(header)) / sizeof(light_internal))
+			return false;
+		size_t offset = sizeof(header) + sizeof(light_internal) * size_t(header.lightCount);
+		std::vector<int> ids, parents;
+		snapshot_object_internal owner = {};
+		int chunksLeft = 0;
+		while (offset < mapped.size)
+		{
+			snapshot_object_internal record;
+			if (mapped.size - offset < sizeof(record))
+				return false;
+			memcpy(&record, mapped.data + offset, sizeof(record));
+			offset += sizeof(record);
+			if (record.id < 0 || record.id >= header.objectCount || record.parent < -1 || record.parent >= header.objectCount ||
+				record.vertexCount < 0 || record.triangleCount < 0 || record.chunkCount < 0)
+				return false;
+			if (record.vertexBytes != 0 && (record.vertexBytes != 3 * sizeof(v3f) * (unsigned long long)record.vertexCount ||
+				record.triangleBytes != sizeof(int) * (unsigned long long)record.triangleCount ||
+				(record.scalarBytes != 0 && record.scalarBytes != sizeof(float) * (unsigned long long)record.vertexCount)))
+				return false;
+			if (record.vertexBytes == 0 && (record.triangleBytes != 0 || record.scalarBytes != 0))
+				return false;
+
+			// Chunks have geometry and a vertex remap, split objects only have chunks
+			const bool isChunk = chunksLeft > 0;
+			if (isChunk && (record.id != owner.id || record.chunkCount != 0 || record.vertexBytes == 0 ||
+				record.remapBytes != sizeof(int) * (unsigned long long)record.vertexCount))
+				return false;
+			if (!isChunk && (record.remapBytes != 0 || (record.chunkCount > 0 && record.vertexBytes != 0)))
+				return false;
+			const unsigned long long blobSize = _internalSnapshotPadding(size_t(record.vertexBytes)) + _internalSnapshotPadding(size_t(record.triangleBytes)) +
+				_internalSnapshotPadding(size_t(record.scalarBytes)) + _internalSnapshotPadding(size_t(record.remapBytes));
+			if (blobSize > mapped.size - offset)
+				return false;
+
+			// Triangle indices refer to vertices of the record
+			const char* triangles = mapped.data + offset + _internalSnapshotPadding(size_t(record.vertexBytes));
+			for (int i = 0; i < int(record.triangleBytes / sizeof(int)); i++)
+			{
+				int v;
+				memcpy(&v, triangles + sizeof(int) * i, sizeof(int));
+				if (v < 0 || v >= record.vertexCount)
+					return false;
+			}
+			if (isChunk)
+			{
+				const char* remap = mapped.data + offset + size_t(blobSize) - _internalSnapshotPadding(size_t(record.remapBytes));
+				for (int i = 0; i < record.vertexCount; i++)
+				{
+					int v;
+					memcpy(&v, remap + sizeof(int) * i, sizeof(int));
+					if (v < 0 || v >= owner.vertexCount)
+						return false;
+				}
+				chunksLeft--;
+			}
+			else
+			{
+				owner = record;
+				chunksLeft = record.chunkCount;
+				ids.push_back(record.id);
+				if (record.parent != -1)
+					parents.push_back(record.parent);
+			}
+			offset += size_t(blobSize);
+		}
+		if (chunksLeft != 0)
+			return false;
+
+		// Ids are unique, and parents are saved objects
+		std::sort(ids.begin(), ids.end());
+		if (std::adjacent_find(ids.begin(), ids.end()) != ids.end())
+			return false;
+		for (int parent : parents)
+		{
+			if (!std::binary_search(ids.begin(), ids.end(), parent))
+				return false;
+		}
+		slotCount = ids.empty() ? 0 : ids.back() + 1;
+		return true;
+	}
+
+	/*!
+	\brief Save all live objects, with their GPU buffers and transforms, the point lights, the camera and the render
+	flags in a single binary snapshot file, that loadScene restores without any processing. Morph targets and time
+	series are saved as static meshes with their base vertices, and voxel volumes as their chunk meshes. Terrains and
+	signed distance fields are not saved. Scenes with out-of-core objects cannot be saved, as their sources are not
+	serializable.
+	\param filename snapshot file
+	\returns false if the scene has out-of-core objects, or if the file could not be written.
+	*/
+	bool saveScene(const char* filename)
+	{
+		for (int i = 0; i < int(internalObjects.size()); i++)
+		{
+			if (!internalObjects[i].isDeleted && internalObjects[i].streamId != -1)
+			{
+				fprintf(stderr, "Object %d is out-of-core, the scene cannot be saved\n", i);
+				return false;
+			}
+		}
+
+		std::ofstream out(filename, std::ios::binary);
+		if (out.is_open() == false)
+		{
+			fprintf(stderr, "Could not open file %s for saving scene\n", filename);
+			return false;
+		}
+
+		snapshot_header_internal header = {};
+		header.magic[0] = 'T'; header.magic[1] = 'R'; header.magic[2] = 'S'; header.magic[3] = 'C';
+		header.version = 3;
+		header.objectCount = int(internalObjects.size());
+		header.lightCount = int(internalLights.size());
+		header.eye = internalScene.eye;
+		header.at = internalScene.at;
+		header.up = internalScene.up;
+		header.zNear = internalScene.zNear;
+		header.zFar = internalScene.zFar;
+		header.lightDir = internalScene.lightDir;
+		header.doLighting = int(internalScene.doLighting);
+		header.showNormals = int(internalScene.showNormals);
+		header.drawWireframe = int(internalScene.drawWireframe);
+		header.wireframeThickness = internalScene.wireframeThickness;
+		out.write((const char*)&header, sizeof(header));
+		if (!internalLights.empty())
+			out.write((const char*)&internalLights.front(), sizeof(light_internal) * internalLights.size());
+
+		// Buffers are read back one at a time, through a single staging array
+		_internalUpdateTransforms();
+		std::vector<char> staging;
+		const char zeros[16] = { 0 };
+		auto writeBuffer = [&](GLenum target, GLuint buffer, unsigned long long size)
+		{
+			if (size == 0)
+				return;
+			staging.resize(size_t(size));
+			glBindBuffer(target, buffer);
+			glGetBufferSubData(target, 0, GLsizeiptr(size), &staging.front());
+			out.write(&staging.front(), std::streamsize(size));
+			out.write(zeros, std::streamsize(_internalSnapshotPadding(size_t(size)) - size_t(size)));
+		};
+		auto writeObject = [&](int id, const object_internal& obj)
+		{
+			snapshot_object_internal record = {};
+			record.id = id;
+			record.parent = obj.parent;
+			record.vertexCount = obj.vertexCount;
+			record.triangleCount = obj.triangleCount;
+			record.chunkCount = int(obj.chunks.size());
+			record.hasBounds = int(obj.hasBounds);
+			record.layers = obj.layers;
+			record.isVisible = int(obj.isVisible);
+			if (obj.vao != 0)
+			{
+				GLint64 size = 0;
+				glBindBuffer(GL_ARRAY_BUFFER, obj.buffers);
+				glGetBufferParameteri64v(GL_ARRAY_BUFFER, GL_BUFFER_SIZE, &size);
+				record.vertexBytes = (unsigned long long)size;
+				record.triangleBytes = sizeof(int) * (unsigned long long)obj.triangleCount;
+				record.scalarBytes = obj.scalarBuffer != 0 ? sizeof(float) * (unsigned long long)obj.vertexCount : 0;
+			}
+			record.remapBytes = sizeof(int) * (unsigned long long)obj.chunkVertices.size();
+			record.scalarRange[0] = obj.scalarRange[0];
+			record.scalarRange[1] = obj.scalarRange[1];
+			std::copy(&obj.localMatrix[0][0], &obj.localMatrix[0][0] + 16, &record.localMatrix[0][0]);
+			std::copy(&obj.modelMatrix[0][0], &obj.modelMatrix[0][0] + 16, &record.modelMatrix[0][0]);
+			record.boundsMin = obj.boundsMin;
+			record.boundsMax = obj.boundsMax;
+			out.write((const char*)&record, sizeof(record));
+
+			glBindVertexArray(obj.vao);
+			writeBuffer(GL_ARRAY_BUFFER, obj.buffers, record.vertexBytes);
+			writeBuffer(GL_ELEMENT_ARRAY_BUFFER, obj.triangleBuffer, record.triangleBytes);
+			writeBuffer(GL_ARRAY_BUFFER, obj.scalarBuffer, record.scalarBytes);
+			if (record.remapBytes != 0)
+			{
+				out.write((const char*)&obj.chunkVertices.front(), std::streamsize(record.remapBytes));
+				out.write(zeros, std::streamsize(_internalSnapshotPadding(size_t(record.remapBytes)) - size_t(record.remapBytes)));
+			}
+		};
+		for (int i = 0; i < int(internalObjects.size()); i++)
+		{
+			const object_internal& obj = internalObjects[i];
+			if (obj.isDeleted)
+				continue;
+			writeObject(i, obj);
+			for (const object_internal& chunk : obj.chunks)
+				writeObject(i, chunk);
+		}
+		glBindVertexArray(0);
+		out.close();
+		return bool(out);
+	}
+
+	/*!
+	\brief Replace the current scene by a snapshot written by saveScene. The file is mapped in memory, and each
+	buffer is uploaded with a single call straight from the mapping. Object ids are the same as when saved. The whole
+	file is validated before the current scene is cleared; the whole scene is then replaced, including terrains,
+	voxel volumes and signed distance fields, which snapshots do not hold.
+	\param filename snapshot file
+	\returns false if the file could not be read, in which case the current scene is unchanged.
+	*/
+	bool loadScene(const char* filename)
+	{
+		mapped_file_internal mapped;
+		if (!_internalMapFile(filename, mapped) || mapped.size < sizeof(snapshot_header_internal))
+		{
+			fprintf(stderr, "Could not open scene file %s\n", filename);
+			_internalUnmapFile(mapped);
+			return false;
+		}
+		snapshot_header_internal header;
+		memcpy(&header, mapped.data, sizeof(header));
+		int slotCount = 0;
+		if (header.magic[0] != 'T' || header.magic[1] != 'R' || header.magic[2] != 'S' || header.magic[3] != 'C' || header.version != 3 ||
+			!_internalValidateSnapshot(mapped, header, slotCount))
+		{
+			fprintf(stderr, "Invalid or truncated scene file %s\n", filename);
+			_internalUnmapFile(mapped);
+			return false;
+		}
+		size_t offset = sizeof(header) + sizeof(light_internal) * size_t(header.lightCount);
+
+		// Clear the current scene
+		_internalClearScene();
+		internalObjects.assign(slotCount, object_internal());
+		for (auto& obj : internalObjects)
+			obj.isDeleted = true;
+
+		// Camera, render flags and lights
+		internalScene.eye = header.eye;
+		internalScene.at = header.at;
+		internalScene.up = header.up;
+		internalScene.zNear = header.zNear;
+		internalScene.zFar = header.zFar;
+		internalScene.lightDir = header.lightDir;
+		internalScene.doLighting = header.doLighting != 0;
+		internalScene.showNormals = header.showNormals != 0;
+		internalScene.drawWireframe = header.drawWireframe != 0;
+		internalScene.wireframeThickness = header.wireframeThickness;
+		internalLights.resize(header.lightCount);
+		if (header.lightCount > 0)
+			memcpy(&internalLights.front(), mapped.data + sizeof(header), sizeof(light_internal) * internalLights.size());
+
+		// Objects and chunks, uploaded straight from the mapping
+		int chunksLeft = 0;
+		while (offset < mapped.size)
+		{
+			snapshot_object_internal record;
+			memcpy(&record, mapped.data + offset, sizeof(record));
+			offset += sizeof(record);
+
+			object_internal* target = &internalObjects[record.id];
+			if (chunksLeft > 0)
+			{
+				target->chunks.push_back(object_internal());
+				target = &target->chunks.back();
+				chunksLeft--;
+			}
+			else
+				chunksLeft = record.chunkCount;
+			object_internal& obj = *target;
+			obj.isDeleted = false;
+			obj.parent = record.parent;
+			obj.vertexCount = record.vertexCount;
+			obj.triangleCount = record.triangleCount;
+			obj.scalarRange[0] = record.scalarRange[0];
+			obj.scalarRange[1] = record.scalarRange[1];
+			std::copy(&record.localMatrix[0][0], &record.localMatrix[0][0] + 16, &obj.localMatrix[0][0]);
+			std::copy(&record.modelMatrix[0][0], &record.modelMatrix[0][0] + 16, &obj.modelMatrix[0][0]);
+			obj.boundsMin = record.boundsMin;
+			obj.boundsMax = record.boundsMax;
+			obj.hasBounds = record.hasBounds != 0;
+			obj.layers = record.layers;
+			obj.isVisible = record.isVisible != 0;
+			if (record.vertexBytes == 0)
+				continue;
+
+			// Positions, normals and colors are stored one after the other in the vertex buffer
+			glGenVertexArrays(1, &obj.vao);
+			glBindVertexArray(obj.vao);
+			glGenBuffers(1, &obj.buffers);
+			glBindBuffer(GL_ARRAY_BUFFER, obj.buffers);
+			glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(record.vertexBytes), mapped.data + offset, GL_STATIC_DRAW);
+			const size_t arraySize = size_t(record.vertexBytes) / 3;
+			for (int a = 0; a < 3; a++)
+			{
+				glVertexAttribPointer(a, 3, GL_FLOAT, GL_FALSE, 0, (const void*)(arraySize * a));
+				glEnableVertexAttribArray(a);
+			}
+			offset += _internalSnapshotPadding(size_t(record.vertexBytes));
+
+			glGenBuffers(1, &obj.triangleBuffer);
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, obj.triangleBuffer);
+			glBufferData(GL_ELEMENT_ARRAY_BUFFER, GLsizeiptr(record.triangleBytes), mapped.data + offset, GL_STATIC_DRAW);
+			offset += _internalSnapshotPadding(size_t(record.triangleBytes));
+
+			if (record.scalarBytes != 0)
+			{
+				glGenBuffers(1, &obj.scalarBuffer);
+				glBindBuffer(GL_ARRAY_BUFFER, obj.scalarBuffer);
+				glBufferData(GL_ARRAY_BUFFER, GLsizeiptr(record.scalarBytes), mapped.data + offset, GL_DYNAMIC_DRAW);
+				glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, 0, (const void*)0);
+				glEnableVertexAttribArray(3);
+				offset += _internalSnapshotPadding(size_t(record.scalarBytes));
+			}
+
+			if (record.remapBytes != 0)
+			{
+				obj.chunkVertices.resize(record.vertexCount);
+				memcpy(&obj.chunkVertices.front(), mapped.data + offset, size_t(record.remapBytes));
+				offset += _internalSnapshotPadding(size_t(record.remapBytes));
+			}
+		}
+		glBindVertexArray(0);
+		_internalUnmapFile(mapped);
+		return true;
+	}
 }
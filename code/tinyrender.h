@@ -7,6 +7,7 @@
 
 #include <cmath>
 #include <vector>
+#include <functional>
 
 namespace tinyrender
 {
@@ -81,6 +82,21 @@ namespace tinyrender
 	}
 
 	// Public interface
+	enum class antialiasing
+	{
+		none, fxaa, smaa, msaa2, msaa4, msaa8
+	};
+
+	enum class subdivision
+	{
+		loop, catmullClark
+	};
+
+	enum class csg
+	{
+		sphere, box, torus, cylinder, smoothUnion, smoothSubtraction, smoothIntersection
+	};
+
 	struct object
 	{
 	public:
@@ -91,6 +107,87 @@ namespace tinyrender
 		std::vector<v3f> normals;
 		std::vector<v3f> colors;
 		std::vector<int> triangles;
+		std::vector<float> scalars;
+	};
+
+	class topology
+	{
+	public:
+		// Half-edge h belongs to triangle h / 3 and goes from triangles[h] to triangles[next(h)].
+		// Connectivity is built on the first query: the object must not change afterwards.
+		topology(const object& obj);
+
+		inline int next(int h) const { return h % 3 == 2 ? h - 2 : h + 1; }
+		inline int prev(int h) const { return h % 3 == 0 ? h + 2 : h - 1; }
+		inline int from(int h) const { return mesh->triangles[h]; }
+		inline int to(int h) const { return mesh->triangles[next(h)]; }
+		int opposite(int h) const;
+		int halfedge(int v) const;
+		int edgeCount() const;
+		int edge(int e) const;
+		bool isBoundaryVertex(int v) const;
+		bool isBoundaryEdge(int h) const;
+		void oneRing(int v, std::vector<int>& neighbors) const;
+
+	private:
+		void build() const;
+
+		const object* mesh;
+		mutable bool isBuilt = false;
+		mutable std::vector<int> opposites;
+		mutable std::vector<int> outgoing;
+		mutable std::vector<int> edges;
+	};
+
+	class meshbuilder
+	{
+	public:
+		// Storage for exactly vertexCount vertices and triangleCount triangles is mapped in GPU memory on construction.
+		// Generators write positions, normals, colors and triangles in place, from several threads on disjoint ranges
+		// if needed, then finish() creates the object. All vertex attributes must be written. Counts below 1 are
+		// rejected, leaving null pointers, and finish() then returns -1.
+		meshbuilder(int vertexCount, int triangleCount);
+		~meshbuilder();
+		meshbuilder(const meshbuilder&) = delete;
+		meshbuilder& operator=(const meshbuilder&) = delete;
+
+		inline v3f* vertices() const { return data; }
+		inline v3f* normals() const { return data + vertexCount; }
+		inline v3f* colors() const { return data + 2 * size_t(vertexCount); }
+		inline int* triangles() const { return indices; }
+		void parallelFor(int count, const std::function<void(int)>& func, int grain = 1) const;
+		int finish(const v3f& boundsMin, const v3f& boundsMax, const v3f& position = { 0, 0, 0 }, const v3f& scale = { 1, 1, 1 });
+
+	private:
+		int vertexCount = 0;
+		int triangleCount = 0;
+		GLuint vao = 0;
+		GLuint buffers = 0;
+		GLuint triangleBuffer = 0;
+		bool isMapped = false;
+		v3f* data = nullptr;
+		int* indices = nullptr;
+
+		// Used instead of mapped memory if mapping fails
+		std::vector<v3f> stagingVertices;
+		std::vector<int> stagingTriangles;
+	};
+
+	struct csgnode
+	{
+	public:
+		csg operation = csg::sphere;
+
+		// Primitives: sphere radius in size.x, box half extents, torus major and minor radii in size.x and size.y,
+		// cylinder radius and half height in size.x and size.y
+		v3f center = { 0, 0, 0 };
+		v3f size = { 1, 1, 1 };
+		v3f color = { 0.5f, 0.5f, 0.5f };
+
+		// Operators: indices of the two operand nodes, and the blending radius
+		int left = -1;
+		int right = -1;
+		float blend = 0.0f;
 	};
 
 	// Window
@@ -110,22 +207,107 @@ namespace tinyrender
 	void updateObject(int id, const object& obj);
 	void updateObject(int id, const v3f& position, const v3f& scale);
 	void updateObject(int id, const std::vector<v3f>& newColors);
+	void updateVertices(int id, const std::vector<v3f>& vertices);
+	void updateScalars(int id, const std::vector<float>& values);
+	void setScalarRange(int id, float minValue, float maxValue);
+	void setMorphTargets(int id, const std::vector<std::vector<v3f>>& targets, const std::vector<std::vector<v3f>>& targetNormals = {});
+	void setMorphWeights(int id, const std::vector<float>& weights);
+	void setMorphKeyframe(int id, float t);
+
+	// Scene graph
+	int addGroup(const v3f& position = { 0, 0, 0 }, const v3f& scale = { 1, 1, 1 });
+	bool setParent(int id, int parentId);
+	int getParent(int id);
+
+	// Out-of-core objects
+	int addStreamedObject(const std::function<object()>& source, const v3f& boundsMin, const v3f& boundsMax, const v3f& position = { 0, 0, 0 }, const v3f& scale = { 1, 1, 1 });
+	void setResidencyBudget(size_t bytes, size_t uploadBytesPerFrame = size_t(64) << 20);
+	bool isResident(int id);
+
+	// Terrain
+	int addTerrain(const std::vector<float>& heights, int resolution, float size, float heightScale = 1.0f, const v3f& position = { 0, 0, 0 });
+	void updateTerrainTile(int id, int x, int y, int width, int height, const std::vector<float>& heights);
+	void setTerrainLodDistance(int id, float distance);
+	bool removeTerrain(int id);
+
+	// Signed distance fields
+	int addSdfObject(const std::vector<csgnode>& nodes, const v3f& position = { 0, 0, 0 }, const v3f& scale = { 1, 1, 1 });
+	int addSdfObject(const std::vector<float>& distances, int resolution, const v3f& boundsMin, const v3f& boundsMax, const v3f& color = { 0.5f, 0.5f, 0.5f });
+	void updateSdfObject(int id, const std::vector<csgnode>& nodes);
+	void updateSdfObject(int id, const v3f& position, const v3f& scale);
+	bool removeSdfObject(int id);
+
+	// Voxel volumes
+	int addVoxelVolume(int sizeX, int sizeY, int sizeZ, float voxelSize = 1.0f, const v3f& position = { 0, 0, 0 });
+	void setVoxel(int id, int x, int y, int z, unsigned char material);
+	void fillVoxels(int id, int x0, int y0, int z0, int x1, int y1, int z1, unsigned char material);
+	unsigned char getVoxel(int id, int x, int y, int z);
+	void setVoxelColor(int id, unsigned char material, const v3f& color);
+	bool removeVoxelVolume(int id);
+
+	// Occlusion culling
+	void setOccluder(int id, bool enabled);
+	void setOccluder(int id, const object& hull);
+
+	// Subdivision surfaces
+	int addSubdivisionSurface(const object& cage, int levels, subdivision scheme = subdivision::loop);
+
+	// Hardware tessellation
+	bool setTessellation(int id, float pixelsPerEdge = 8.0f);
+	bool setDisplacementMap(int id, const std::vector<float>& heights, int resolution, float amplitude, float tiling = 1.0f);
+
+	// Ambient occlusion
+	void bakeAmbientOcclusion(int id, int rays = 256, float radius = -1.0f);
+
+	// Meshlets
+	void buildMeshlets(int id, int maxTriangles = 124, bool coneCulling = false);
+
+	// Visibility
+	void setVisible(int id, bool visible);
+	void setLayers(int id, unsigned int layers);
+	void setVisibleLayers(unsigned int mask);
+
+	// Time series streamed from disk
+	int addTimeSeries(const char* filename);
+	void setTimeSeriesPlayback(int id, float framesPerSecond, bool loop);
+	void setTimeSeriesFrame(int id, float frame);
+	int getTimeSeriesFrameCount(int id);
+	int getTimeSeriesDroppedFrames(int id);
+
+	// Scene snapshots
+	bool saveScene(const char* filename);
+	bool loadScene(const char* filename);
 
 	// Scene parameters
 	void setDoLighting(bool doLighting);
 	void setDrawWireframe(bool drawWireframe);
 	void setWireframeThickness(float thickness);
 	void setShowNormals(bool showNormals);
+	void setDynamicResolution(bool enabled, float frameBudget = 16.0f, int idleFrames = 10, bool simplifyWhileMoving = false);
+	void setProgressiveAccumulation(bool enabled, int maxSamples = 16);
+	void setOcclusionCulling(bool enabled, int maxOccluders = 8);
+	void setAntiAliasing(antialiasing mode);
+	void benchmarkAntiAliasing(int frames = 60);
 	void setCameraEye(float x, float y, float z);
 	void setCameraAt(float x, float y, float z);
 	void setCameraPlanes(float near, float far);
 	void setLightDir(float x, float y, float z);
+	void setColormap(const std::vector<v3f>& colors);
+
+	// Point lights
+	int addPointLight(const v3f& position, const v3f& color, float radius);
+	void updatePointLight(int id, const v3f& position, const v3f& color, float radius);
+	bool removePointLight(int id);
 
 	// Simple mesh API
 	int addSphere(float r, int n);
 	int addPlane(float size, int n);
 	int addBox(float size);
 	bool exportObjFile(const char* filename, const object& object);
+	bool exportTimeSeriesFile(const char* filename, const object& object, const std::vector<std::vector<v3f>>& frames);
+	int simplify(object& object, int targetTriangles, float maxError = -1.0f);
+	void subdivide(object& object, int levels, subdivision scheme = subdivision::loop);
+	void computeCreaseNormals(object& object, float creaseAngle = 30.0f);
 }
 
 #endif